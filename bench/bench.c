@@ -0,0 +1,1064 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "codegen.h"
+#include "lexer.h"
+#include "parser.h"
+#include "pipeline.h"
+#include "semantic.h"
+#include "state.h"
+#include "utils.h"
+#include "value.h"
+#include "vm.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Run benchmark `fn`.
+ */
+
+#define benchmark(fn)                                                               \
+  printf("    \e[92m» \e[90m%s\e[0m\n", #fn);                                       \
+  benchmark_##fn();
+
+/*
+ * Benchmark suite title.
+ */
+
+#define suite(title) printf("\n  \e[36m%s\e[0m\n", title)
+
+/*
+ * Report a `label` measurement taking `secs` over `bytes` bytes.
+ */
+
+#define report(label, secs, bytes)                                                  \
+  printf("      \e[90m%-32s %9.3f ms %10.1f MB/s\e[0m\n", label, (secs)*1e3,      \
+         (bytes) / (secs) / (1 << 20))
+
+/*
+ * Return the monotonic time in seconds.
+ */
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Write `mb` megabytes of source to `fd` and exit.
+ */
+
+static void write_source(int fd, size_t mb) {
+  char chunk[1 << 16];
+  const char *line = "dim x as integer\n";
+  size_t n = strlen(line);
+
+  for (size_t i = 0; i < sizeof(chunk); ++i) {
+    chunk[i] = line[i % n];
+  }
+
+  for (size_t i = 0; i < mb * 16; ++i) {
+    for (size_t off = 0; off < sizeof(chunk);) {
+      ssize_t w = write(fd, chunk + off, sizeof(chunk) - off);
+      if (w < 0) {
+        _exit(1);
+      }
+      off += w;
+    }
+  }
+
+  close(fd);
+  _exit(0);
+}
+
+/*
+ * Pipe `mb` megabytes through read_until_eof().
+ */
+
+static void bench_read_until_eof(size_t mb) {
+  int fds[2];
+  char label[32];
+  size_t len;
+
+  assert(pipe(fds) == 0);
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (!pid) {
+    close(fds[0]);
+    write_source(fds[1], mb);
+  }
+
+  close(fds[1]);
+  FILE *stream = fdopen(fds[0], "r");
+  double start = now();
+  char *buf = read_until_eof(stream, &len);
+  double secs = now() - start;
+  fclose(stream);
+  waitpid(pid, NULL, 0);
+
+  assert(buf);
+  assert(len == mb << 20);
+  assert(buf[len] == 0);
+  free(buf);
+
+  snprintf(label, sizeof(label), "%zu MB", mb);
+  report(label, secs, (double)len);
+}
+
+static void benchmark_read_until_eof() {
+  bench_read_until_eof(10);
+  bench_read_until_eof(100);
+  bench_read_until_eof(500);
+}
+
+/*
+ * Return `mb` megabytes of source generated by cycling
+ * through the `n` printf-style `lines`, nul-terminated.
+ */
+
+static char *generate_source(const char **lines, size_t n, size_t mb) {
+  size_t size = mb << 20, len = 0;
+  char *buf = malloc(size + 256);
+  assert(buf);
+
+  for (size_t i = 0; len < size; ++i) {
+    len += sprintf(buf + len, lines[i % n], i, i);
+  }
+
+  buf[len] = 0;
+  return buf;
+}
+
+/*
+ * Scan `mb` megabytes of source generated from `lines`
+ * with each fast path level the CPU supports.
+ */
+
+static void bench_lexer(const char **lines, size_t n, size_t mb) {
+  ifj17_lexer_t lex;
+  char label[32];
+  char *source = generate_source(lines, n, mb);
+  size_t len = strlen(source);
+
+  for (int level = IFJ17_SIMD_SCALAR; level <= IFJ17_SIMD_AVX2; ++level) {
+    const ifj17_simd_t *simd = ifj17_simd(level);
+    if (!simd) {
+      continue;
+    }
+
+    // best of three
+    size_t ntokens;
+    double secs = 0;
+    for (int run = 0; run < 3; ++run) {
+      ifj17_lexer_init(&lex, source, "bench");
+      lex.simd = simd;
+
+      ntokens = 0;
+      double start = now();
+      while (ifj17_scan(&lex)) {
+        ++ntokens;
+      }
+      double elapsed = now() - start;
+      assert(lex.tok.type == IFJ17_TOKEN_EOS);
+
+      if (!run || elapsed < secs) {
+        secs = elapsed;
+      }
+    }
+
+    snprintf(label, sizeof(label), "%zu MB %s, %zu tokens", mb, simd->name, ntokens);
+    report(label, secs, (double)len);
+  }
+
+  free(source);
+}
+
+static void benchmark_lexer() {
+  const char *lines[] = {
+      "dim counter_%zu as integer = %zu\n",
+      "Print !\"iteration %zu\\n\"; counter_%zu * 2;\n",
+      "If value_%zu >= 0x%zx Then\n",
+      "  total = total + value_%zu / 3.5e2 ' line %zu\n",
+      "/' block comment spanning a good part of a line '/    \n",
+      "Else\nEnd If\n",
+  };
+
+  bench_lexer(lines, 6, 10);
+  bench_lexer(lines, 6, 100);
+}
+
+static void benchmark_identifiers() {
+  const char *lines[] = {
+      "Dim Counter_%zu, total%zu As Integer\n",
+      "If Not done And value Or fallback Then Return result End If\n",
+      "Do While index_%zu < LIMIT Loop Scope Print Input Else ElseIf\n",
+      "Declare Function compute_%zu As Double Type doubled%zu\n",
+  };
+
+  bench_lexer(lines, 4, 10);
+  bench_lexer(lines, 4, 100);
+}
+
+static void benchmark_comments() {
+  const char *lines[] = {
+      "' %zu: a line comment documenting the statement below it in prose\n",
+      "                dim indented_%zu as integer                        \n",
+      "/' a block comment %zu that goes on for a while, as they tend to '/\n",
+  };
+
+  bench_lexer(lines, 3, 10);
+  bench_lexer(lines, 3, 100);
+}
+
+/*
+ * Scan `mb` megabytes token by token, in blocks, and all at once.
+ */
+
+static void bench_batch(size_t mb) {
+  const char *lines[] = {
+      "dim counter_%zu as integer = %zu\n",
+      "If value_%zu >= 0x%zx Then\n",
+      "  total = total + value_%zu / 3.5e2 ' line %zu\n",
+      "Else\nEnd If\n",
+  };
+  ifj17_lexer_t lex;
+  ifj17_token_t block[IFJ17_TOKEN_BLOCK];
+  char label[32];
+  char *source = generate_source(lines, 4, mb);
+  size_t len = strlen(source), ntokens = 0;
+
+  ifj17_lexer_init(&lex, source, "bench");
+  double start = now();
+  while (ifj17_scan(&lex)) {
+    ++ntokens;
+  }
+  double secs = now() - start;
+  snprintf(label, sizeof(label), "%zu MB ifj17_scan", mb);
+  report(label, secs, (double)len);
+
+  ifj17_lexer_init(&lex, source, "bench");
+  start = now();
+  while (ifj17_lex(&lex, block, IFJ17_TOKEN_BLOCK) == IFJ17_TOKEN_BLOCK)
+    ;
+  secs = now() - start;
+  snprintf(label, sizeof(label), "%zu MB ifj17_lex", mb);
+  report(label, secs, (double)len);
+
+  ifj17_lexer_init(&lex, source, "bench");
+  start = now();
+  ifj17_token_t *toks = ifj17_lex_all(&lex, &ntokens);
+  secs = now() - start;
+  assert(toks);
+  free(toks);
+  snprintf(label, sizeof(label), "%zu MB ifj17_lex_all", mb);
+  report(label, secs, (double)len);
+
+  free(source);
+}
+
+static void benchmark_batch() {
+  bench_batch(100);
+}
+
+/*
+ * Parse a generated program of `mb` megabytes, lexing
+ * on a separate thread when `pipelined`.
+ */
+
+static void bench_parser(size_t mb, int pipelined) {
+  const char *lines[] = {
+      "dim v%zu as integer\n",
+      "v%zu = v%zu * 2 + (total - 1) / 3\n",
+      "if v%zu > 10 then\n  print v%zu;\nelse\n  total = total + 1\nend if\n",
+  };
+  ifj17_state_t state;
+  ifj17_lexer_t lex;
+  ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+  ifj17_pipeline_t *pipe = malloc(sizeof(ifj17_pipeline_t));
+  char label[32];
+  char *body = generate_source(lines, 3, mb);
+  size_t len = strlen(body);
+  char *source = malloc(len + 32);
+  assert(parser && pipe && source);
+  sprintf(source, "scope\n%send scope\n", body);
+  free(body);
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lex, source, "bench");
+  ifj17_parser_init(parser, &lex, &state);
+
+  double start = now();
+  if (pipelined) {
+    assert(ifj17_pipeline_start(pipe, &lex));
+    parser->pipeline = pipe;
+  }
+  assert(ifj17_parse(parser));
+  if (pipelined) {
+    ifj17_pipeline_stop(pipe);
+  }
+  double secs = now() - start;
+
+  snprintf(label, sizeof(label), "%zu MB%s", mb, pipelined ? " pipelined" : "");
+  report(label, secs, (double)len);
+  if (pipelined) {
+    printf("      \e[90m  lexer  %9.3f ms busy %9.3f ms waiting\e[0m\n",
+           pipe->lex_busy * 1e3, pipe->lex_wait * 1e3);
+    printf("      \e[90m  parser %9.3f ms busy %9.3f ms waiting\e[0m\n",
+           pipe->parse_busy * 1e3, pipe->parse_wait * 1e3);
+  }
+
+  ifj17_state_free(&state);
+  free(parser);
+  free(pipe);
+  free(source);
+}
+
+static void benchmark_parser() {
+  bench_parser(10, 0);
+  bench_parser(50, 0);
+}
+
+/*
+ * Parse `mb` megabytes of expression-heavy code.
+ */
+
+static void bench_expressions(size_t mb) {
+  const char *lines[] = {
+      "x%zu = a * (b + %zu) - c / 2 + d %% 3 << 1\n",
+      "y = -a + b * c < d and e > f || g == %zu && h <> i ^ %zu or j\n",
+  };
+  ifj17_state_t state;
+  ifj17_lexer_t lex;
+  ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+  char label[32];
+  char *body = generate_source(lines, 2, mb);
+  size_t len = strlen(body);
+  char *source = malloc(len + 32);
+  assert(parser && source);
+  sprintf(source, "scope\n%send scope\n", body);
+  free(body);
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lex, source, "bench");
+  ifj17_parser_init(parser, &lex, &state);
+
+  double start = now();
+  assert(ifj17_parse(parser));
+  double secs = now() - start;
+
+  snprintf(label, sizeof(label), "%zu MB", mb);
+  report(label, secs, (double)len);
+
+  ifj17_state_free(&state);
+  free(parser);
+  free(source);
+}
+
+static void benchmark_expressions() {
+  bench_expressions(10);
+  bench_expressions(50);
+}
+
+/*
+ * Parse `mb` megabytes with a broken statement every few
+ * lines, stopping at the first error unless `recover`.
+ */
+
+static void bench_recovery(size_t mb, int recover) {
+  const char *lines[] = {
+      "dim v%zu as integer\n",
+      "v%zu = v%zu * 2 + (total - 1) / 3\n",
+      "v%zu = v%zu * / 2\n",
+      "if v%zu > 10 then\n  print v%zu;\nelse\n  total = total +\nend if\n",
+  };
+  ifj17_state_t state;
+  ifj17_lexer_t lex;
+  ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+  char label[32];
+  char *body = generate_source(lines, 4, mb);
+  size_t len = strlen(body);
+  char *source = malloc(len + 32);
+  assert(parser && source);
+  sprintf(source, "scope\n%send scope\n", body);
+  free(body);
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lex, source, "bench");
+  ifj17_parser_init(parser, &lex, &state);
+  parser->recover = recover;
+
+  double start = now();
+  assert(!ifj17_parse(parser));
+  double secs = now() - start;
+
+  snprintf(label, sizeof(label), "%zu MB %s", mb, recover ? "recovering" : "first error");
+  report(label, secs, (double)len);
+  printf("      \e[90m  %d errors per compile\e[0m\n",
+         recover ? parser->ndiagnostics : 1);
+
+  ifj17_state_free(&state);
+  free(parser);
+  free(source);
+}
+
+static void benchmark_recovery() {
+  bench_recovery(10, 0);
+  bench_recovery(10, 1);
+}
+
+/*
+ * Generate code for a parsed program of `mb` megabytes,
+ * with the output going to /dev/null.
+ */
+
+static void bench_codegen(size_t mb) {
+  const char *lines[] = {
+      "dim v%zu as integer\n",
+      "n = n + %zu\n",
+      "d = %zu.5\n",
+      "if n = %zu then\n  print n;\nelse\n  total = 2\nend if\n",
+      "do while n = %zu\n  n = n * 2\nloop\n",
+  };
+  ifj17_state_t state;
+  ifj17_lexer_t lex;
+  ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+  ifj17_block_node_t *root;
+  char label[32];
+  char *body = generate_source(lines, 5, mb);
+  size_t len = strlen(body);
+  char *source = malloc(len + 64);
+  ifj17_semantic_t sem;
+  assert(parser && source);
+  sprintf(source, "scope\ndim n, total as integer\ndim d as double\n%send scope\n",
+          body);
+  free(body);
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lex, source, "bench");
+  ifj17_parser_init(parser, &lex, &state);
+  assert(root = ifj17_parse(parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+
+  // silence stdout
+  fflush(stdout);
+  int fd = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+  assert(fd >= 0 && null >= 0);
+  dup2(null, STDOUT_FILENO);
+
+  ifj17_codegen_ctx_t context;
+  ifj17_codegen_ctx_init(&context);
+  context.jobs = 1;
+  double start = now();
+  assert(ifj17_gen(&context, (ifj17_node_t *)root));
+  fflush(stdout);
+  double secs = now() - start;
+  ifj17_codegen_ctx_free(&context);
+
+  dup2(fd, STDOUT_FILENO);
+  close(null);
+  close(fd);
+
+  snprintf(label, sizeof(label), "%zu MB", mb);
+  report(label, secs, (double)len);
+
+  ifj17_state_free(&state);
+  free(parser);
+  free(source);
+}
+
+static void benchmark_codegen() {
+  bench_codegen(1);
+  bench_codegen(10);
+}
+
+/*
+ * Generate code for `n` functions on `jobs` threads,
+ * with the output going to /dev/null.
+ */
+
+static void bench_functions(int n, int jobs) {
+  ifj17_state_t state;
+  ifj17_lexer_t lex;
+  ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+  char label[32];
+  char *source = malloc(n * 256 + 64), *p = source;
+  assert(parser && source);
+
+  for (int i = 0; i < n; ++i) {
+    p += sprintf(p,
+                 "function f%d (n as integer) as integer\n"
+                 "dim a as integer\na = n * %d\n"
+                 "if a = 1 then\n  a = a + 2\nelse\n  a = a - 1\nend if\n"
+                 "do while a = 3\n  a = a + 1\nloop\nreturn a\nend function\n",
+                 i, i);
+  }
+  strcpy(p, "scope\ndim b as integer\nb = f0(1)\nend scope\n");
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lex, source, "bench");
+  ifj17_parser_init(parser, &lex, &state);
+  assert(root = ifj17_parse(parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+
+  // silence stdout
+  fflush(stdout);
+  int fd = dup(STDOUT_FILENO), null = open("/dev/null", O_WRONLY);
+  assert(fd >= 0 && null >= 0);
+  dup2(null, STDOUT_FILENO);
+
+  ifj17_codegen_ctx_t context;
+  ifj17_codegen_ctx_init(&context);
+  context.jobs = jobs;
+  double start = now();
+  assert(ifj17_gen(&context, (ifj17_node_t *)root));
+  double secs = now() - start;
+  ifj17_codegen_ctx_free(&context);
+
+  dup2(fd, STDOUT_FILENO);
+  close(null);
+  close(fd);
+
+  snprintf(label, sizeof(label), "%d functions, %d jobs", n, jobs);
+  report(label, secs, (double)strlen(source));
+
+  ifj17_state_free(&state);
+  free(parser);
+  free(source);
+}
+
+static void benchmark_functions() {
+  bench_functions(10000, 1);
+  bench_functions(10000, 2);
+  bench_functions(10000, 4);
+}
+
+/*
+ * Acceptance programs the peephole pass is measured on.
+ */
+
+static const char *acceptance[] = {
+    "test/acceptance/assignment_vars/assignment",
+    "test/acceptance/binary_operators/arithmetic",
+    "test/acceptance/binary_operators/boolean",
+    "test/acceptance/binary_operators/division",
+    "test/acceptance/binary_operators/relations",
+    "test/acceptance/conditions/if-elseif-else2x",
+    "test/acceptance/conditions/if-elseif2x",
+    "test/acceptance/conditions/if-single2x",
+    "test/acceptance/functions/factorial",
+    "test/acceptance/functions/function-local-vars",
+    "test/acceptance/types_control/add_sub_mul",
+    "test/acceptance/types_control/jump_if",
+    "test/acceptance/types_control/relation_op",
+    "test/acceptance/unary_operators/minus",
+};
+
+/*
+ * Generate code for the acceptance programs `times` over,
+ * with the peephole pass or without, reporting the
+ * instructions emitted, labels and declarations aside.
+ */
+
+static void bench_peephole(int peephole, int times) {
+  size_t n = sizeof(acceptance) / sizeof(acceptance[0]), bytes = 0;
+  int instructions = 0, hits[IFJ17_PEEPHOLE_RULES] = {0};
+  double secs = 0;
+  char path[128];
+
+  for (size_t i = 0; i < n; ++i) {
+    ifj17_state_t state;
+    ifj17_lexer_t lex;
+    ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+    ifj17_block_node_t *root;
+    ifj17_semantic_t sem;
+    snprintf(path, sizeof(path), "%s.ifj17", acceptance[i]);
+    char *source = file_read(path);
+    assert(parser && source);
+
+    ifj17_state_init(&state);
+    ifj17_lexer_init(&lex, source, path);
+    ifj17_parser_init(parser, &lex, &state);
+    assert(root = ifj17_parse(parser));
+    ifj17_semantic_init(&sem, &state);
+    assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+    bytes += strlen(source) * times;
+
+    for (int t = 0; t < times; ++t) {
+      ifj17_codegen_ctx_t context;
+      ifj17_codegen_ctx_init(&context);
+      context.peephole = peephole;
+      double start = now();
+      assert(ifj17_codegen(&context, (ifj17_node_t *)root));
+      secs += now() - start;
+
+      if (!t) {
+        char *line = context.out.buf, *end = line + context.out.len;
+        while (line < end) {
+          char *eol = memchr(line, '\n', end - line);
+          eol = eol ? eol : end;
+          if (eol > line && '.' != *line && strncmp(line, "LABEL ", 6) &&
+              strncmp(line, "DEFVAR ", 7)) {
+            ++instructions;
+          }
+          line = eol + 1;
+        }
+        for (int r = 0; r < IFJ17_PEEPHOLE_RULES; ++r) {
+          hits[r] += context.hits[r];
+        }
+      }
+      ifj17_codegen_ctx_free(&context);
+    }
+
+    ifj17_state_free(&state);
+    free(parser);
+    free(source);
+  }
+
+  report(peephole ? "acceptance, peephole" : "acceptance, no peephole", secs,
+         (double)bytes);
+  printf("      \e[90m  %d instructions\e[0m\n", instructions);
+  if (peephole) {
+    printf("      \e[90m ");
+    for (int r = 0; r < IFJ17_PEEPHOLE_RULES; ++r) {
+      printf(" %s %d", ifj17_peephole_rule_names[r], hits[r]);
+    }
+    printf("\e[0m\n");
+  }
+}
+
+static void benchmark_peephole() {
+  bench_peephole(0, 1000);
+  bench_peephole(1, 1000);
+}
+
+/*
+ * Analyze a scope of `n` declarations, each assigned once,
+ * and `n` functions calling their predecessor.
+ */
+
+static void bench_semantic(int n) {
+  ifj17_state_t state;
+  ifj17_lexer_t lex;
+  ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+  char label[32];
+  char *source = malloc(n * 160 + 64), *p = source;
+  assert(parser && source);
+
+  for (int i = 0; i < n; ++i) {
+    p += sprintf(p,
+                 "function f%d (n as integer) as integer\n"
+                 "return f%d(n - 1)\nend function\n",
+                 i, i ? i - 1 : 0);
+  }
+  p += sprintf(p, "scope\n");
+  for (int i = 0; i < n; ++i) {
+    p += sprintf(p, "dim v%d as integer\nv%d = v%d + f%d(%d)\n", i, i, i ? i - 1 : 0,
+                 i, i);
+  }
+  strcpy(p, "end scope\n");
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lex, source, "bench");
+  ifj17_parser_init(parser, &lex, &state);
+  assert(root = ifj17_parse(parser));
+
+  ifj17_semantic_init(&sem, &state);
+  double start = now();
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+  double secs = now() - start;
+
+  snprintf(label, sizeof(label), "%d declarations", 2 * n);
+  report(label, secs, (double)strlen(source));
+  printf("      \e[90m  %.0f ns per declaration\e[0m\n", secs * 1e9 / (2 * n));
+
+  ifj17_state_free(&state);
+  free(parser);
+  free(source);
+}
+
+static void benchmark_semantic() {
+  bench_semantic(5000);
+  bench_semantic(50000);
+}
+
+static void benchmark_pipeline() {
+  bench_parser(100, 0);
+  bench_parser(100, 1);
+}
+
+/*
+ * Compile `source` into `context`.
+ */
+
+static void compile(ifj17_codegen_ctx_t *context, const char *source) {
+  ifj17_state_t state;
+  ifj17_lexer_t lex;
+  ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+  assert(parser);
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lex, source, "bench");
+  ifj17_parser_init(parser, &lex, &state);
+  assert(root = ifj17_parse(parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+  ifj17_codegen_ctx_init(context);
+  assert(ifj17_codegen(context, (ifj17_node_t *)root));
+
+  ifj17_state_free(&state);
+  free(parser);
+}
+
+/*
+ * Tight Do While loop of `n` iterations.
+ */
+
+static char *loop_source(int n) {
+  static char source[256];
+  snprintf(source, sizeof(source),
+           "scope\ndim i as integer\ndim s as integer\n"
+           "do while i < %d\ns = s + i\ni = i + 1\nloop\nprint s;\nend scope\n",
+           n);
+  return source;
+}
+
+/*
+ * Run a tight Do While loop of `n` iterations, its operands
+ * pre-resolved or looked up by name, reporting the time per
+ * instruction executed.
+ */
+
+static void bench_vm(int resolve, int n) {
+  ifj17_codegen_ctx_t context;
+  ifj17_vm_t vm;
+
+  compile(&context, loop_source(n));
+  ifj17_vm_init(&vm);
+  vm.resolve = resolve;
+  assert(vm.out = fopen("/dev/null", "w"));
+  assert(ifj17_vm_load(&vm, context.out.buf, context.out.len));
+  double start = now();
+  assert(ifj17_eval(&vm));
+  double secs = now() - start;
+
+  printf("      \e[90m%-32s %9.3f ms %10.1f ns/instr\e[0m\n",
+         resolve ? "loop, pre-resolved" : "loop, names hashed", secs * 1e3,
+         secs * 1e9 / vm.steps);
+
+  fclose(vm.out);
+  ifj17_vm_free(&vm);
+  ifj17_codegen_ctx_free(&context);
+}
+
+static void benchmark_vm() {
+  bench_vm(0, 1000000);
+  bench_vm(1, 1000000);
+}
+
+/*
+ * Run the program generated into `context`, its pairs fused
+ * when `fuse`, into `profile` unless NULL, adding its
+ * dispatches to `steps`, up to the runtime error stopping it
+ * if any. Return the seconds taken.
+ */
+
+static double run(ifj17_codegen_ctx_t *context, int fuse,
+                  ifj17_vm_profile_t *profile, long *steps) {
+  ifj17_vm_t vm;
+  ifj17_vm_init(&vm);
+  vm.fuse = fuse;
+  vm.profile = profile;
+  assert(vm.in = fopen("/dev/null", "r"));
+  assert(vm.out = fopen("/dev/null", "w"));
+  assert(ifj17_vm_load(&vm, context->out.buf, context->out.len));
+  double start = now();
+  ifj17_eval(&vm);
+  double secs = now() - start;
+  *steps += vm.steps;
+  fclose(vm.in);
+  fclose(vm.out);
+  ifj17_vm_free(&vm);
+  return secs;
+}
+
+/*
+ * Run `source` `times` over, reporting the time per
+ * instruction under the dispatch built and, by opcode, the
+ * dispatches the switch and threaded kinds would mispredict,
+ * profiled on runs of their own.
+ */
+
+static void bench_dispatch(const char *label, const char *source, int times) {
+  ifj17_codegen_ctx_t context;
+  ifj17_vm_profile_t profile = {{0}};
+  long steps = 0, profiled = 0, misses[2] = {0};
+  double secs = 0;
+
+  compile(&context, source);
+  for (int t = 0; t < times; ++t) {
+    secs += run(&context, 1, NULL, &steps);
+  }
+  for (int t = 0; t < times; ++t) {
+    run(&context, 1, &profile, &profiled);
+  }
+
+  printf("      \e[90m%-32s %9.3f ms %10.1f ns/instr\e[0m\n", label, secs * 1e3,
+         secs * 1e9 / steps);
+  printf("      \e[90m  %-14s %10s %10s %10s\e[0m\n", "opcode", "dispatched",
+         "switch", "threaded");
+  for (int op = 0; op < IFJ17_OPS; ++op) {
+    if (profile.count[op]) {
+      printf("      \e[90m  %-14s %10ld %10ld %10ld\e[0m\n", ifj17_op_strings[op],
+             profile.count[op], profile.misses[IFJ17_VM_SWITCH][op],
+             profile.misses[IFJ17_VM_THREADED][op]);
+      misses[IFJ17_VM_SWITCH] += profile.misses[IFJ17_VM_SWITCH][op];
+      misses[IFJ17_VM_THREADED] += profile.misses[IFJ17_VM_THREADED][op];
+    }
+  }
+  printf("      \e[90m  %-14s %10ld %10ld %10ld\e[0m\n", "total", steps,
+         misses[IFJ17_VM_SWITCH], misses[IFJ17_VM_THREADED]);
+  ifj17_codegen_ctx_free(&context);
+}
+
+static void benchmark_dispatch() {
+  char *factorial = file_read("test/acceptance/functions/factorial.ifj17");
+  assert(factorial);
+  printf("      \e[90m%s dispatch\e[0m\n",
+         IFJ17_VM_THREADED == ifj17_vm_dispatch_kind ? "threaded" : "switch");
+  bench_dispatch("loop", loop_source(1000000), 1);
+  bench_dispatch("factorial", factorial, 100000);
+  free(factorial);
+}
+
+/*
+ * Run `source` `times` over unfused and fused, reporting the
+ * dispatches and time each takes, adding the dispatches to
+ * `total` and the unfused profile to `profile` unless NULL.
+ */
+
+static void bench_super(const char *label, const char *source, int times,
+                        ifj17_vm_profile_t *profile, long *total) {
+  ifj17_codegen_ctx_t context;
+  long steps[2] = {0}, profiled = 0;
+  double secs[2] = {0};
+
+  compile(&context, source);
+  for (int fuse = 0; fuse < 2; ++fuse) {
+    for (int t = 0; t < times; ++t) {
+      secs[fuse] += run(&context, fuse, NULL, &steps[fuse]);
+    }
+    total[fuse] += steps[fuse];
+  }
+  if (profile) {
+    run(&context, 0, profile, &profiled);
+  }
+
+  printf("      \e[90m%-32s %9.3f ms %10ld -> %10ld dispatches, -%.1f%%\e[0m\n",
+         label, secs[1] * 1e3, steps[0], steps[1],
+         100.0 * (steps[0] - steps[1]) / steps[0]);
+  ifj17_codegen_ctx_free(&context);
+}
+
+/*
+ * Report the superinstructions' dispatch reduction over the
+ * acceptance programs, the loop and factorial, and the
+ * opcode pairs the acceptance programs dispatch most
+ * unfused, the candidates for fusing.
+ */
+
+static void benchmark_super() {
+  size_t n = sizeof(acceptance) / sizeof(acceptance[0]);
+  ifj17_vm_profile_t *profile = calloc(1, sizeof(ifj17_vm_profile_t));
+  long total[2] = {0}, ignored[2] = {0};
+  char path[256];
+  assert(profile);
+
+  for (size_t i = 0; i < n; ++i) {
+    snprintf(path, sizeof(path), "%s.ifj17", acceptance[i]);
+    char *source = file_read(path);
+    assert(source);
+    bench_super(strrchr(acceptance[i], '/') + 1, source, 1, profile, total);
+    free(source);
+  }
+  printf("      \e[90m%-32s %27ld -> %10ld dispatches, -%.1f%%\e[0m\n",
+         "acceptance", total[0], total[1], 100.0 * (total[0] - total[1]) / total[0]);
+
+  printf("      \e[90m  %-28s %10s\e[0m\n", "pair", "unfused");
+  for (int top = 0; top < 8; ++top) {
+    int a = 0, b = 0;
+    for (int i = 0; i < IFJ17_OPS; ++i) {
+      for (int j = 0; j < IFJ17_OPS; ++j) {
+        if (profile->pairs[i][j] > profile->pairs[a][b]) {
+          a = i, b = j;
+        }
+      }
+    }
+    if (!profile->pairs[a][b]) {
+      break;
+    }
+    snprintf(path, sizeof(path), "%s %s", ifj17_op_strings[a], ifj17_op_strings[b]);
+    printf("      \e[90m  %-28s %10ld\e[0m\n", path, profile->pairs[a][b]);
+    profile->pairs[a][b] = 0;
+  }
+  free(profile);
+
+  char *factorial = file_read("test/acceptance/functions/factorial.ifj17");
+  assert(factorial);
+  bench_super("loop", loop_source(1000000), 1, NULL, ignored);
+  bench_super("factorial", factorial, 10000, NULL, ignored);
+  free(factorial);
+}
+
+/*
+ * Report a `label` measurement of `n` operations taking
+ * `secs` and `allocs` heap allocations.
+ */
+
+#define report_ops(label, secs, n, allocs)                                          \
+  printf("      \e[90m%-32s %9.3f ms %8.1f ns/op %10zu allocs\e[0m\n",             \
+         label, (secs)*1e3, (secs)*1e9 / (n), (size_t)(allocs))
+
+/*
+ * Add `n` ints, multiply `n` doubles and concatenate `n`
+ * pairs of a few strings, as the interpreter did on heap
+ * objects and as it does on values, counting the mallocs
+ * of each: one per object and per copied string, or the
+ * arena chunks the interned strings take.
+ */
+
+static void bench_values(int n) {
+  const char *words[] = {"a", "bc", "def", "ghij", "klmno", "pq", "r", "stu"};
+  ifj17_string_t *interned[8];
+  ifj17_state_t strings;
+  volatile ifj17_value_t sink;
+  size_t allocs = 0;
+  double start;
+
+  // ints
+  ifj17_object_t *obj = ifj17_int_new(0), *next;
+  start = now();
+  for (int i = 0; i < n; ++i) {
+    next = ifj17_int_new(obj->value.as_int + i);
+    ifj17_object_free(obj);
+    obj = next;
+    ++allocs;
+  }
+  report_ops("int add, objects", now() - start, n, allocs);
+  ifj17_object_free(obj);
+
+  ifj17_value_t val = ifj17_value_int(0);
+  start = now();
+  for (int i = 0; i < n; ++i) {
+    val = ifj17_value_int(ifj17_value_as_int(val) + i);
+  }
+  sink = val;
+  report_ops("int add, values", now() - start, n, 0);
+
+  // doubles
+  allocs = 0;
+  obj = ifj17_double_new(1);
+  start = now();
+  for (int i = 0; i < n; ++i) {
+    next = ifj17_double_new(obj->value.as_double * 1.0000001);
+    ifj17_object_free(obj);
+    obj = next;
+    ++allocs;
+  }
+  report_ops("double mul, objects", now() - start, n, allocs);
+  ifj17_object_free(obj);
+
+  val = ifj17_value_double(1);
+  start = now();
+  for (int i = 0; i < n; ++i) {
+    val = ifj17_value_double(ifj17_value_as_double(val) * 1.0000001);
+  }
+  sink = val;
+  report_ops("double mul, values", now() - start, n, 0);
+
+  // strings
+  allocs = 0;
+  start = now();
+  for (int i = 0; i < n; ++i) {
+    const char *a = words[i & 7], *b = words[(i >> 3) & 7];
+    size_t len = strlen(a);
+    char *buf = malloc(len + strlen(b) + 1);
+    memcpy(buf, a, len);
+    strcpy(buf + len, b);
+    obj = ifj17_string_new(buf);
+    free(buf);
+    ifj17_object_free(obj);
+    allocs += 3;
+  }
+  report_ops("string concat, objects", now() - start, n, allocs);
+
+  ifj17_state_init(&strings);
+  for (int i = 0; i < 8; ++i) {
+    interned[i] = ifj17_string(&strings, words[i]);
+  }
+  char buf[16];
+  start = now();
+  for (int i = 0; i < n; ++i) {
+    ifj17_string_t *a = interned[i & 7], *b = interned[(i >> 3) & 7];
+    memcpy(buf, a->val, a->len);
+    memcpy(buf + a->len, b->val, b->len);
+    sink = ifj17_value_string(ifj17_string_intern(&strings, buf, a->len + b->len));
+  }
+  report_ops("string concat, values", now() - start, n, strings.arena.nchunks);
+  ifj17_state_free(&strings);
+  (void)sink;
+}
+
+static void benchmark_values() {
+  bench_values(10000000);
+}
+
+/*
+ * Run all benchmarks.
+ */
+
+int main(int argc, const char **argv) {
+  suite("utils");
+  benchmark(read_until_eof);
+
+  suite("lexer");
+  benchmark(lexer);
+  benchmark(identifiers);
+  benchmark(comments);
+  benchmark(batch);
+
+  suite("parser");
+  benchmark(parser);
+  benchmark(expressions);
+  benchmark(recovery);
+  benchmark(pipeline);
+
+  suite("semantic");
+  benchmark(semantic);
+
+  suite("codegen");
+  benchmark(codegen);
+  benchmark(functions);
+  benchmark(peephole);
+
+  suite("vm");
+  benchmark(vm);
+  benchmark(dispatch);
+  benchmark(super);
+  benchmark(values);
+  printf("\n");
+  return 0;
+}
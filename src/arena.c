@@ -0,0 +1,175 @@
+//
+// arena.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#include "arena.h"
+#include "internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Round `size` up to pointer alignment.
+ */
+
+#define ALIGN(size) (((size) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+/*
+ * Initialize an empty arena.
+ */
+
+void ifj17_arena_init(ifj17_arena_t *self) {
+  self->head = NULL;
+  self->last = NULL;
+  self->nallocs = 0;
+  self->nbytes = 0;
+  self->nchunks = 0;
+  self->capacity = 0;
+}
+
+/*
+ * Chain a new chunk able to hold at least `size` bytes.
+ */
+
+static ifj17_arena_chunk_t *chunk_new(ifj17_arena_t *self, size_t size) {
+  if (size < IFJ17_ARENA_CHUNK_SIZE) {
+    size = IFJ17_ARENA_CHUNK_SIZE;
+  }
+
+  ifj17_arena_chunk_t *chunk = malloc(sizeof(ifj17_arena_chunk_t) + size);
+  if (unlikely(!chunk)) {
+    return NULL;
+  }
+
+  chunk->prev = self->head;
+  chunk->size = size;
+  chunk->used = 0;
+
+  self->head = chunk;
+  self->nchunks++;
+  self->capacity += size;
+
+  return chunk;
+}
+
+/*
+ * Allocate `size` bytes, or NULL on failure.
+ */
+
+void *ifj17_arena_alloc(ifj17_arena_t *self, size_t size) {
+  ifj17_arena_chunk_t *chunk = self->head;
+  size = ALIGN(size);
+
+  if (unlikely(!chunk || chunk->size - chunk->used < size)) {
+    if (!(chunk = chunk_new(self, size))) {
+      return NULL;
+    }
+  }
+
+  void *ptr = chunk->data + chunk->used;
+  chunk->used += size;
+
+  self->last = ptr;
+  self->nallocs++;
+  self->nbytes += size;
+
+  return ptr;
+}
+
+/*
+ * Grow `ptr` of `size` bytes to `new_size` bytes. The most recent
+ * allocation is extended in place when the chunk has room left,
+ * otherwise the contents are copied into a fresh allocation.
+ */
+
+void *ifj17_arena_grow(ifj17_arena_t *self, void *ptr, size_t size,
+                       size_t new_size) {
+  ifj17_arena_chunk_t *chunk = self->head;
+  size = ALIGN(size);
+  new_size = ALIGN(new_size);
+
+  if (ptr && ptr == self->last && chunk->size - chunk->used >= new_size - size) {
+    chunk->used += new_size - size;
+    self->nbytes += new_size - size;
+    return ptr;
+  }
+
+  void *buf = ifj17_arena_alloc(self, new_size);
+  if (unlikely(!buf)) {
+    return NULL;
+  }
+
+  if (ptr) {
+    memcpy(buf, ptr, size);
+  }
+
+  return buf;
+}
+
+/*
+ * Give back `ptr` when it is the most recent allocation.
+ */
+
+void ifj17_arena_pop(ifj17_arena_t *self, void *ptr) {
+  ifj17_arena_chunk_t *chunk = self->head;
+  if (!ptr || ptr != self->last) {
+    return;
+  }
+
+  size_t size = chunk->data + chunk->used - (char *)ptr;
+  chunk->used -= size;
+  self->last = NULL;
+  self->nallocs--;
+  self->nbytes -= size;
+}
+
+/*
+ * Copy `len` bytes of `str` into the arena as a nul-terminated string.
+ */
+
+char *ifj17_arena_strndup(ifj17_arena_t *self, const char *str, size_t len) {
+  char *buf = ifj17_arena_alloc(self, len + 1);
+  if (unlikely(!buf)) {
+    return NULL;
+  }
+
+  memcpy(buf, str, len);
+  buf[len] = 0;
+
+  return buf;
+}
+
+/*
+ * Copy the nul-terminated `str` into the arena.
+ */
+
+char *ifj17_arena_strdup(ifj17_arena_t *self, const char *str) {
+  return ifj17_arena_strndup(self, str, strlen(str));
+}
+
+/*
+ * Output allocation statistics to stderr.
+ */
+
+void ifj17_arena_inspect(ifj17_arena_t *self) {
+  fprintf(stderr, "arena: %zu allocations, %zu bytes in %zu chunks (%zu reserved)\n",
+          self->nallocs, self->nbytes, self->nchunks, self->capacity);
+}
+
+/*
+ * Release every chunk, leaving the arena empty.
+ */
+
+void ifj17_arena_release(ifj17_arena_t *self) {
+  ifj17_arena_chunk_t *chunk = self->head;
+
+  while (chunk) {
+    ifj17_arena_chunk_t *prev = chunk->prev;
+    free(chunk);
+    chunk = prev;
+  }
+
+  ifj17_arena_init(self);
+}
@@ -0,0 +1,63 @@
+//
+// arena.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_ARENA_H
+#define IFJ17_ARENA_H
+
+#include <stddef.h>
+
+// Default chunk size
+#ifndef IFJ17_ARENA_CHUNK_SIZE
+#define IFJ17_ARENA_CHUNK_SIZE (64 * 1024)
+#endif
+
+/*
+ * Arena chunk, chained to the previously filled chunk.
+ */
+
+typedef struct ifj17_arena_chunk {
+  struct ifj17_arena_chunk *prev;
+  size_t size;
+  size_t used;
+  char data[];
+} ifj17_arena_chunk_t;
+
+/*
+ * IFJ17 arena.
+ *
+ * A bump allocator owning everything allocated
+ * for a single compilation, released at once.
+ */
+
+typedef struct {
+  ifj17_arena_chunk_t *head;
+  void *last;
+  size_t nallocs;
+  size_t nbytes;
+  size_t nchunks;
+  size_t capacity;
+} ifj17_arena_t;
+
+// prototypes
+
+void ifj17_arena_init(ifj17_arena_t *self);
+
+void *ifj17_arena_alloc(ifj17_arena_t *self, size_t size);
+
+void *ifj17_arena_grow(ifj17_arena_t *self, void *ptr, size_t size,
+                       size_t new_size);
+
+void ifj17_arena_pop(ifj17_arena_t *self, void *ptr);
+
+char *ifj17_arena_strndup(ifj17_arena_t *self, const char *str, size_t len);
+
+char *ifj17_arena_strdup(ifj17_arena_t *self, const char *str);
+
+void ifj17_arena_inspect(ifj17_arena_t *self);
+
+void ifj17_arena_release(ifj17_arena_t *self);
+
+#endif /* IFJ17_ARENA_H */
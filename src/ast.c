@@ -7,37 +7,59 @@
 #include "ast.h"
 #include "hash.h"
 #include "internal.h"
-#include "vec.h"
+#include "lexer.h"
 
 /*
- * Alloc a ifj17 value and assign the given `node`.
+ * Allocate a `type` in the compilation arena.
  */
 
-ifj17_object_t *ifj17_node(ifj17_node_t *node) {
-  ifj17_object_t *self = malloc(sizeof(ifj17_object_t));
+#define alloc(type) ifj17_arena_alloc(arena, sizeof(type))
+
+/*
+ * Alloc and initialize a new node vector.
+ */
+
+ifj17_node_vec_t *ifj17_node_vec_new(ifj17_arena_t *arena) {
+  ifj17_node_vec_t *self = alloc(ifj17_node_vec_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
-  self->type = IFJ17_TYPE_NODE;
-  self->value.as_pointer = node;
+  kv_init(*self);
 
   return self;
 }
 
+/*
+ * Push `node` into the vector, growing its storage within the arena.
+ */
+
+void ifj17_node_vec_push(ifj17_arena_t *arena, ifj17_node_vec_t *self,
+                         ifj17_node_t *node) {
+  if (self->n == self->m) {
+    size_t m = self->m ? self->m << 1 : 4;
+    self->a = ifj17_arena_grow(arena, self->a, self->m * sizeof(ifj17_node_t *),
+                               m * sizeof(ifj17_node_t *));
+    self->m = m;
+  }
+
+  self->a[self->n++] = node;
+}
+
 /*
  * Alloc and initialize a new block node.
  */
 
-ifj17_block_node_t *ifj17_block_node_new(int lineno) {
-  ifj17_block_node_t *self = malloc(sizeof(ifj17_block_node_t));
+ifj17_block_node_t *ifj17_block_node_new(ifj17_arena_t *arena, int lineno) {
+  ifj17_block_node_t *self = alloc(ifj17_block_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_BLOCK;
   self->base.lineno = lineno;
-  self->stmts = ifj17_vec_new();
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->stmts = ifj17_node_vec_new(arena);
 
   return self;
 }
@@ -46,16 +68,17 @@ ifj17_block_node_t *ifj17_block_node_new(int lineno) {
  * Alloc and initialize a new args node.
  */
 
-ifj17_args_node_t *ifj17_args_node_new(int lineno) {
-  ifj17_args_node_t *self = malloc(sizeof(ifj17_args_node_t));
+ifj17_args_node_t *ifj17_args_node_new(ifj17_arena_t *arena, int lineno) {
+  ifj17_args_node_t *self = alloc(ifj17_args_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_ARGS;
   self->base.lineno = lineno;
-  self->vec = ifj17_vec_new();
-  self->hash = ifj17_hash_new();
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->vec = ifj17_node_vec_new(arena);
+  self->hash = NULL;
 
   return self;
 }
@@ -64,14 +87,15 @@ ifj17_args_node_t *ifj17_args_node_new(int lineno) {
  * Alloc and initialize a new int node with the given `val`.
  */
 
-ifj17_int_node_t *ifj17_int_node_new(int val, int lineno) {
-  ifj17_int_node_t *self = malloc(sizeof(ifj17_int_node_t));
+ifj17_int_node_t *ifj17_int_node_new(ifj17_arena_t *arena, int val, int lineno) {
+  ifj17_int_node_t *self = alloc(ifj17_int_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_INT;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->val = val;
 
   return self;
@@ -81,32 +105,37 @@ ifj17_int_node_t *ifj17_int_node_new(int val, int lineno) {
  * Alloc and initialize a new double node with the given `val`.
  */
 
-ifj17_double_node_t *ifj17_double_node_new(double val, int lineno) {
-  ifj17_double_node_t *self = malloc(sizeof(ifj17_double_node_t));
+ifj17_double_node_t *ifj17_double_node_new(ifj17_arena_t *arena, double val,
+                                           int lineno) {
+  ifj17_double_node_t *self = alloc(ifj17_double_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_DOUBLE;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->val = val;
 
   return self;
 }
 
 /*
- * Alloc and initialize a new id node with the given `val`.
+ * Alloc and initialize a new id node with the given `name`.
  */
 
-ifj17_id_node_t *ifj17_id_node_new(const char *val, int lineno) {
-  ifj17_id_node_t *self = malloc(sizeof(ifj17_id_node_t));
+ifj17_id_node_t *ifj17_id_node_new(ifj17_arena_t *arena, ifj17_string_t *name,
+                                   int lineno) {
+  ifj17_id_node_t *self = alloc(ifj17_id_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_ID;
   self->base.lineno = lineno;
-  self->val = val;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->slot = -1;
+  self->name = name;
 
   return self;
 }
@@ -116,15 +145,16 @@ ifj17_id_node_t *ifj17_id_node_new(const char *val, int lineno) {
  * given `name`, `type`, and `val`.
  */
 
-ifj17_decl_node_t *ifj17_decl_node_new(ifj17_vec_t *vec, ifj17_node_t *type,
-                                       int lineno) {
-  ifj17_decl_node_t *self = malloc(sizeof(ifj17_decl_node_t));
+ifj17_decl_node_t *ifj17_decl_node_new(ifj17_arena_t *arena, ifj17_node_vec_t *vec,
+                                       ifj17_node_t *type, int lineno) {
+  ifj17_decl_node_t *self = alloc(ifj17_decl_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_DECL;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->vec = vec;
   self->type = type;
 
@@ -136,50 +166,80 @@ ifj17_decl_node_t *ifj17_decl_node_new(ifj17_vec_t *vec, ifj17_node_t *type,
  * given `decl` and `val`.
  */
 
-ifj17_dim_node_t *ifj17_dim_node_new(ifj17_vec_t *vec, int lineno) {
-  ifj17_dim_node_t *self = malloc(sizeof(ifj17_dim_node_t));
+ifj17_dim_node_t *ifj17_dim_node_new(ifj17_arena_t *arena, ifj17_node_vec_t *vec,
+                                     int lineno) {
+  ifj17_dim_node_t *self = alloc(ifj17_dim_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_DIM;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->vec = vec;
 
   return self;
 }
 
 /*
- * Alloc and initialize a new string node with the given `val`.
+ * Alloc and initialize a new string node with
+ * the interned, undecoded literal `str`.
  */
 
-ifj17_string_node_t *ifj17_string_node_new(const char *val, int lineno) {
-  ifj17_string_node_t *self = malloc(sizeof(ifj17_string_node_t));
+ifj17_string_node_t *ifj17_string_node_new(ifj17_arena_t *arena, ifj17_string_t *str,
+                                           int lineno) {
+  ifj17_string_node_t *self = alloc(ifj17_string_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_STRING;
   self->base.lineno = lineno;
-  self->val = val;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->str = str;
+  self->val = NULL;
+  self->arena = arena;
 
   return self;
 }
 
+/*
+ * Return the decoded string value, decoding
+ * it into the arena on first use.
+ */
+
+const char *ifj17_string_node_value(ifj17_string_node_t *self) {
+  if (self->val) {
+    return self->val;
+  }
+
+  int len = self->str->len;
+  char *buf = ifj17_arena_alloc(self->arena, IFJ17_STRING_DECODE_SIZE(len));
+  if (unlikely(!buf)) {
+    return NULL;
+  }
+
+  ifj17_string_decode(buf, self->str->val, len);
+  return self->val = buf;
+}
+
 /*
  * Alloc and initialize a new call node with the given `expr`.
  */
 
-ifj17_call_node_t *ifj17_call_node_new(ifj17_node_t *expr, int lineno) {
-  ifj17_call_node_t *self = malloc(sizeof(ifj17_call_node_t));
+ifj17_call_node_t *ifj17_call_node_new(ifj17_arena_t *arena, ifj17_node_t *expr,
+                                       int lineno) {
+  ifj17_call_node_t *self = alloc(ifj17_call_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_CALL;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->expr = expr;
-  self->args = ifj17_args_node_new(lineno);
+  self->callee = NULL;
+  self->args = ifj17_args_node_new(arena, lineno);
 
   if (unlikely(!self->args)) {
     return NULL;
@@ -192,15 +252,17 @@ ifj17_call_node_t *ifj17_call_node_new(ifj17_node_t *expr, int lineno) {
  * Alloc and initialize subscript node with `left` and `right`.
  */
 
-ifj17_subscript_node_t *ifj17_subscript_node_new(ifj17_node_t *left,
+ifj17_subscript_node_t *ifj17_subscript_node_new(ifj17_arena_t *arena,
+                                                 ifj17_node_t *left,
                                                  ifj17_node_t *right, int lineno) {
-  ifj17_subscript_node_t *self = malloc(sizeof(ifj17_subscript_node_t));
+  ifj17_subscript_node_t *self = alloc(ifj17_subscript_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_SUBSCRIPT;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->left = left;
   self->right = right;
 
@@ -211,15 +273,16 @@ ifj17_subscript_node_t *ifj17_subscript_node_new(ifj17_node_t *left,
  * Alloc and initialize slot access node with `left` and `right`.
  */
 
-ifj17_slot_node_t *ifj17_slot_node_new(ifj17_node_t *left, ifj17_node_t *right,
-                                       int lineno) {
-  ifj17_slot_node_t *self = malloc(sizeof(ifj17_slot_node_t));
+ifj17_slot_node_t *ifj17_slot_node_new(ifj17_arena_t *arena, ifj17_node_t *left,
+                                       ifj17_node_t *right, int lineno) {
+  ifj17_slot_node_t *self = alloc(ifj17_slot_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_SLOT;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->left = left;
   self->right = right;
 
@@ -230,15 +293,17 @@ ifj17_slot_node_t *ifj17_slot_node_new(ifj17_node_t *left, ifj17_node_t *right,
  * Alloc and initialize a unary `op` node with `expr` node.
  */
 
-ifj17_unary_op_node_t *ifj17_unary_op_node_new(ifj17_token op, ifj17_node_t *expr,
-                                               int postfix, int lineno) {
-  ifj17_unary_op_node_t *self = malloc(sizeof(ifj17_unary_op_node_t));
+ifj17_unary_op_node_t *ifj17_unary_op_node_new(ifj17_arena_t *arena, ifj17_token op,
+                                               ifj17_node_t *expr, int postfix,
+                                               int lineno) {
+  ifj17_unary_op_node_t *self = alloc(ifj17_unary_op_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_UNARY_OP;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->op = op;
   self->expr = expr;
   self->postfix = postfix;
@@ -250,15 +315,17 @@ ifj17_unary_op_node_t *ifj17_unary_op_node_new(ifj17_token op, ifj17_node_t *exp
  * Alloc and initialize a binary `op` node with `left` and `right` nodes.
  */
 
-ifj17_binary_op_node_t *ifj17_binary_op_node_new(ifj17_token op, ifj17_node_t *left,
+ifj17_binary_op_node_t *ifj17_binary_op_node_new(ifj17_arena_t *arena,
+                                                 ifj17_token op, ifj17_node_t *left,
                                                  ifj17_node_t *right, int lineno) {
-  ifj17_binary_op_node_t *self = malloc(sizeof(ifj17_binary_op_node_t));
+  ifj17_binary_op_node_t *self = alloc(ifj17_binary_op_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_BINARY_OP;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->op = op;
   self->left = left;
   self->right = right;
@@ -271,15 +338,16 @@ ifj17_binary_op_node_t *ifj17_binary_op_node_new(ifj17_token op, ifj17_node_t *l
  * Alloc and initialize a new array node.
  */
 
-ifj17_array_node_t *ifj17_array_node_new(int lineno) {
-  ifj17_array_node_t *self = malloc(sizeof(ifj17_array_node_t));
+ifj17_array_node_t *ifj17_array_node_new(ifj17_arena_t *arena, int lineno) {
+  ifj17_array_node_t *self = alloc(ifj17_array_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_ARRAY;
   self->base.lineno = lineno;
-  self->vals = ifj17_vec_new();
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->vals = ifj17_node_vec_new(arena);
 
   return self;
 }
@@ -288,14 +356,15 @@ ifj17_array_node_t *ifj17_array_node_new(int lineno) {
  * Alloc and initialize a new hash node.
  */
 
-ifj17_hash_pair_node_t *ifj17_hash_pair_node_new(int lineno) {
-  ifj17_hash_pair_node_t *self = malloc(sizeof(ifj17_hash_pair_node_t));
+ifj17_hash_pair_node_t *ifj17_hash_pair_node_new(ifj17_arena_t *arena, int lineno) {
+  ifj17_hash_pair_node_t *self = alloc(ifj17_hash_pair_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_HASH_PAIR;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->key = NULL;
   self->val = NULL;
 
@@ -306,15 +375,16 @@ ifj17_hash_pair_node_t *ifj17_hash_pair_node_new(int lineno) {
  * Alloc and initialize a new hash node.
  */
 
-ifj17_hash_node_t *ifj17_hash_node_new(int lineno) {
-  ifj17_hash_node_t *self = malloc(sizeof(ifj17_hash_node_t));
+ifj17_hash_node_t *ifj17_hash_node_new(ifj17_arena_t *arena, int lineno) {
+  ifj17_hash_node_t *self = alloc(ifj17_hash_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_HASH;
   self->base.lineno = lineno;
-  self->pairs = ifj17_vec_new();
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->pairs = ifj17_node_vec_new(arena);
 
   return self;
 }
@@ -324,14 +394,17 @@ ifj17_hash_node_t *ifj17_hash_node_new(int lineno) {
  * Alloc and initialize a new scope
  */
 
-ifj17_scope_node_t *ifj17_scope_node_new(ifj17_block_node_t *block, int lineno) {
-  ifj17_scope_node_t *self = malloc(sizeof(ifj17_scope_node_t));
+ifj17_scope_node_t *ifj17_scope_node_new(ifj17_arena_t *arena,
+                                         ifj17_block_node_t *block, int lineno) {
+  ifj17_scope_node_t *self = alloc(ifj17_scope_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_SCOPE;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->nslots = 0;
   self->block = block;
 
   if (unlikely(!self->block)) {
@@ -346,15 +419,18 @@ ifj17_scope_node_t *ifj17_scope_node_new(ifj17_block_node_t *block, int lineno)
  * `type` and `params`.
  */
 
-ifj17_declare_node_t *ifj17_declare_node_new(const char *name, ifj17_node_t *type,
-                                             ifj17_vec_t *params, int lineno) {
-  ifj17_declare_node_t *self = malloc(sizeof(ifj17_declare_node_t));
+ifj17_declare_node_t *ifj17_declare_node_new(ifj17_arena_t *arena,
+                                             ifj17_string_t *name,
+                                             ifj17_node_t *type,
+                                             ifj17_node_vec_t *params, int lineno) {
+  ifj17_declare_node_t *self = alloc(ifj17_declare_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_DECLARE;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->params = params;
   self->type = type;
   self->name = name;
@@ -367,16 +443,21 @@ ifj17_declare_node_t *ifj17_declare_node_new(const char *name, ifj17_node_t *typ
  * `type`, `block` of statements and `params`.
  */
 
-ifj17_function_node_t *ifj17_function_node_new(const char *name, ifj17_node_t *type,
+ifj17_function_node_t *ifj17_function_node_new(ifj17_arena_t *arena,
+                                               ifj17_string_t *name,
+                                               ifj17_node_t *type,
                                                ifj17_block_node_t *block,
-                                               ifj17_vec_t *params, int lineno) {
-  ifj17_function_node_t *self = malloc(sizeof(ifj17_function_node_t));
+                                               ifj17_node_vec_t *params,
+                                               int lineno) {
+  ifj17_function_node_t *self = alloc(ifj17_function_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_FUNCTION;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->nslots = 0;
   self->params = params;
   self->block = block;
   self->type = type;
@@ -390,26 +471,29 @@ ifj17_function_node_t *ifj17_function_node_new(const char *name, ifj17_node_t *t
  * with an implicit return.
  */
 
-ifj17_function_node_t *ifj17_function_node_new_from_expr(ifj17_node_t *expr,
-                                                         ifj17_vec_t *params,
+ifj17_function_node_t *ifj17_function_node_new_from_expr(ifj17_arena_t *arena,
+                                                         ifj17_node_t *expr,
+                                                         ifj17_node_vec_t *params,
                                                          int lineno) {
-  ifj17_function_node_t *self = malloc(sizeof(ifj17_function_node_t));
+  ifj17_function_node_t *self = alloc(ifj17_function_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
   self->base.type = IFJ17_NODE_FUNCTION;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->nslots = 0;
   self->params = params;
 
   // block
-  self->block = ifj17_block_node_new(lineno);
+  self->block = ifj17_block_node_new(arena, lineno);
   if (unlikely(!self->block)) {
     return NULL;
   }
 
   // return
-  ifj17_return_node_t *ret = ifj17_return_node_new(expr, lineno);
-  ifj17_vec_push(self->block->stmts, ifj17_node((ifj17_node_t *)ret));
+  ifj17_return_node_t *ret = ifj17_return_node_new(arena, expr, lineno);
+  ifj17_node_vec_push(arena, self->block->stmts, (ifj17_node_t *)ret);
 
   return self;
 }
@@ -418,16 +502,18 @@ ifj17_function_node_t *ifj17_function_node_new_from_expr(ifj17_node_t *expr,
  * Alloc and initialize a new type noe with the given `name`.
  */
 
-ifj17_type_node_t *ifj17_type_node_new(const char *name, int lineno) {
-  ifj17_type_node_t *self = malloc(sizeof(ifj17_type_node_t));
+ifj17_type_node_t *ifj17_type_node_new(ifj17_arena_t *arena, ifj17_string_t *name,
+                                       int lineno) {
+  ifj17_type_node_t *self = alloc(ifj17_type_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_TYPE;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->name = name;
-  self->fields = ifj17_vec_new();
+  self->fields = ifj17_node_vec_new(arena);
 
   return self;
 }
@@ -437,9 +523,9 @@ ifj17_type_node_t *ifj17_type_node_new(const char *name, int lineno) {
  * with required `expr` and `block`.
  */
 
-ifj17_if_node_t *ifj17_if_node_new(ifj17_node_t *expr, ifj17_block_node_t *block,
-                                   int lineno) {
-  ifj17_if_node_t *self = malloc(sizeof(ifj17_if_node_t));
+ifj17_if_node_t *ifj17_if_node_new(ifj17_arena_t *arena, ifj17_node_t *expr,
+                                   ifj17_block_node_t *block, int lineno) {
+  ifj17_if_node_t *self = alloc(ifj17_if_node_t);
 
   if (unlikely(!self)) {
     return NULL;
@@ -447,10 +533,11 @@ ifj17_if_node_t *ifj17_if_node_new(ifj17_node_t *expr, ifj17_block_node_t *block
 
   self->base.type = IFJ17_NODE_IF;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->expr = expr;
   self->block = block;
   self->else_block = NULL;
-  self->else_ifs = ifj17_vec_new();
+  self->else_ifs = ifj17_node_vec_new(arena);
 
   return self;
 }
@@ -460,9 +547,9 @@ ifj17_if_node_t *ifj17_if_node_new(ifj17_node_t *expr, ifj17_block_node_t *block
  * otherwise "while", with required `expr` and `block`.
  */
 
-ifj17_while_node_t *ifj17_while_node_new(ifj17_node_t *expr,
+ifj17_while_node_t *ifj17_while_node_new(ifj17_arena_t *arena, ifj17_node_t *expr,
                                          ifj17_block_node_t *block, int lineno) {
-  ifj17_while_node_t *self = malloc(sizeof(ifj17_while_node_t));
+  ifj17_while_node_t *self = alloc(ifj17_while_node_t);
 
   if (unlikely(!self)) {
     return NULL;
@@ -470,6 +557,7 @@ ifj17_while_node_t *ifj17_while_node_new(ifj17_node_t *expr,
 
   self->base.type = IFJ17_NODE_WHILE;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->expr = expr;
   self->block = block;
 
@@ -480,8 +568,9 @@ ifj17_while_node_t *ifj17_while_node_new(ifj17_node_t *expr,
  * Alloc and initialize a new return node with the given `expr`.
  */
 
-ifj17_return_node_t *ifj17_return_node_new(ifj17_node_t *expr, int lineno) {
-  ifj17_return_node_t *self = malloc(sizeof(ifj17_return_node_t));
+ifj17_return_node_t *ifj17_return_node_new(ifj17_arena_t *arena, ifj17_node_t *expr,
+                                           int lineno) {
+  ifj17_return_node_t *self = alloc(ifj17_return_node_t);
 
   if (unlikely(!self)) {
     return NULL;
@@ -489,6 +578,7 @@ ifj17_return_node_t *ifj17_return_node_new(ifj17_node_t *expr, int lineno) {
 
   self->base.type = IFJ17_NODE_RETURN;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->expr = expr;
 
   return self;
@@ -498,14 +588,16 @@ ifj17_return_node_t *ifj17_return_node_new(ifj17_node_t *expr, int lineno) {
  * Alloc and initialize a new print node with the given `params`.
  */
 
-ifj17_print_node_t *ifj17_print_node_new(ifj17_vec_t *params, int lineno) {
-  ifj17_print_node_t *self = malloc(sizeof(ifj17_print_node_t));
+ifj17_print_node_t *ifj17_print_node_new(ifj17_arena_t *arena,
+                                         ifj17_node_vec_t *params, int lineno) {
+  ifj17_print_node_t *self = alloc(ifj17_print_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_PRINT;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->params = params;
 
   return self;
@@ -515,14 +607,16 @@ ifj17_print_node_t *ifj17_print_node_new(ifj17_vec_t *params, int lineno) {
  * Alloc and initialize a new input node with the given `params`.
  */
 
-ifj17_input_node_t *ifj17_input_node_new(ifj17_node_t *param, int lineno) {
-  ifj17_input_node_t *self = malloc(sizeof(ifj17_input_node_t));
+ifj17_input_node_t *ifj17_input_node_new(ifj17_arena_t *arena, ifj17_node_t *param,
+                                         int lineno) {
+  ifj17_input_node_t *self = alloc(ifj17_input_node_t);
   if (unlikely(!self)) {
     return NULL;
   }
 
   self->base.type = IFJ17_NODE_INPUT;
   self->base.lineno = lineno;
+  self->base.datatype = IFJ17_DATATYPE_UNKNOWN;
   self->param = param;
 
   return self;
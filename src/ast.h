@@ -7,9 +7,11 @@
 #ifndef IFJ17_AST_H
 #define IFJ17_AST_H
 
+#include "arena.h"
+#include "kvec.h"
 #include "object.h"
+#include "state.h"
 #include "token.h"
-#include "vec.h"
 
 /*
  * Nodes.
@@ -57,6 +59,18 @@ typedef enum {
 #undef n
 } ifj17_node_type;
 
+/*
+ * Static types of expressions, unknown until inferred.
+ */
+
+typedef enum {
+  IFJ17_DATATYPE_UNKNOWN,
+  IFJ17_DATATYPE_INTEGER,
+  IFJ17_DATATYPE_DOUBLE,
+  IFJ17_DATATYPE_STRING,
+  IFJ17_DATATYPE_BOOLEAN,
+} ifj17_datatype;
+
 /*
  * IFJ17 node.
  */
@@ -64,15 +78,54 @@ typedef enum {
 typedef struct {
   ifj17_node_type type;
   int lineno;
+  ifj17_datatype datatype;
 } ifj17_node_t;
 
+/*
+ * IFJ17 node vector.
+ */
+
+typedef kvec_t(ifj17_node_t *) ifj17_node_vec_t;
+
+/*
+ * Return the node vector length.
+ */
+
+#define ifj17_node_vec_length(self) kv_size(*self)
+
+/*
+ * Return the node at `i`.
+ */
+
+#define ifj17_node_vec_at(self, i) kv_A(*self, (i))
+
+/*
+ * Iterate the node vector, populating `i` and `val`.
+ */
+
+#define ifj17_node_vec_each(self, block)                                            \
+  {                                                                                 \
+    ifj17_node_t **vals = (self)->a;                                                \
+    int len = ifj17_node_vec_length(self);                                          \
+    for (int i = 0; i < len; ++i) {                                                 \
+      ifj17_node_t *val = vals[i];                                                  \
+      block;                                                                        \
+    }                                                                               \
+  }
+
+/*
+ * Keyword argument hash.
+ */
+
+KHASH_MAP_INIT_STR(node, ifj17_node_t *);
+
 /*
  * IFJ17 block node.
  */
 
 typedef struct {
   ifj17_node_t base;
-  ifj17_vec_t *stmts;
+  ifj17_node_vec_t *stmts;
 } ifj17_block_node_t;
 
 /*
@@ -81,8 +134,8 @@ typedef struct {
 
 typedef struct {
   ifj17_node_t base;
-  ifj17_vec_t *vec;
-  ifj17_hash_t *hash;
+  ifj17_node_vec_t *vec;
+  khash_t(node) * hash;
 } ifj17_args_node_t;
 
 /*
@@ -147,12 +200,14 @@ typedef struct {
 } ifj17_double_node_t;
 
 /*
- * IFJ17 id node.
+ * IFJ17 id node, with the slot of the local it resolves to,
+ * or -1.
  */
 
 typedef struct {
   ifj17_node_t base;
-  const char *val;
+  int slot;
+  ifj17_string_t *name;
 } ifj17_id_node_t;
 
 /*
@@ -161,7 +216,7 @@ typedef struct {
 
 typedef struct {
   ifj17_node_t base;
-  ifj17_vec_t *vec;
+  ifj17_node_vec_t *vec;
   ifj17_node_t *type;
 } ifj17_decl_node_t;
 
@@ -171,16 +226,19 @@ typedef struct {
 
 typedef struct {
   ifj17_node_t base;
-  ifj17_vec_t *vec;
+  ifj17_node_vec_t *vec;
 } ifj17_dim_node_t;
 
 /*
- * IFJ17 string node.
+ * IFJ17 string node, holding the interned literal as
+ * written until ifj17_string_node_value() decodes it.
  */
 
 typedef struct {
   ifj17_node_t base;
+  ifj17_string_t *str;
   const char *val;
+  ifj17_arena_t *arena;
 } ifj17_string_node_t;
 
 /*
@@ -189,7 +247,7 @@ typedef struct {
 
 typedef struct {
   ifj17_node_t base;
-  ifj17_vec_t *vals;
+  ifj17_node_vec_t *vals;
 } ifj17_array_node_t;
 
 /*
@@ -207,25 +265,28 @@ typedef struct {
 
 typedef struct {
   ifj17_node_t base;
-  ifj17_vec_t *pairs;
+  ifj17_node_vec_t *pairs;
 } ifj17_hash_node_t;
 
 /*
- * IFJ17 call node.
+ * IFJ17 call node, with the function or declare node
+ * of its `callee` once resolved.
  */
 
 typedef struct {
   ifj17_node_t base;
   ifj17_node_t *expr;
   ifj17_args_node_t *args;
+  ifj17_node_t *callee;
 } ifj17_call_node_t;
 
 /*
- * IFJ17 scope node.
+ * IFJ17 scope node, with `nslots` locals.
  */
 
 typedef struct {
   ifj17_node_t base;
+  int nslots;
   ifj17_block_node_t *block;
 } ifj17_scope_node_t;
 
@@ -235,21 +296,22 @@ typedef struct {
 
 typedef struct {
   ifj17_node_t base;
-  const char *name;
+  ifj17_string_t *name;
   ifj17_node_t *type;
-  ifj17_vec_t *params;
+  ifj17_node_vec_t *params;
 } ifj17_declare_node_t;
 
 /*
- * IFJ17 function node.
+ * IFJ17 function node, with `nslots` params and locals.
  */
 
 typedef struct {
   ifj17_node_t base;
-  const char *name;
+  int nslots;
+  ifj17_string_t *name;
   ifj17_node_t *type;
   ifj17_block_node_t *block;
-  ifj17_vec_t *params;
+  ifj17_node_vec_t *params;
 } ifj17_function_node_t;
 
 /*
@@ -258,8 +320,8 @@ typedef struct {
 
 typedef struct {
   ifj17_node_t base;
-  const char *name;
-  ifj17_vec_t *fields;
+  ifj17_string_t *name;
+  ifj17_node_vec_t *fields;
 } ifj17_type_node_t;
 
 /*
@@ -271,7 +333,7 @@ typedef struct {
   ifj17_node_t *expr;
   ifj17_block_node_t *block;
   ifj17_block_node_t *else_block;
-  ifj17_vec_t *else_ifs;
+  ifj17_node_vec_t *else_ifs;
 } ifj17_if_node_t;
 
 /*
@@ -299,7 +361,7 @@ typedef struct {
 
 typedef struct {
   ifj17_node_t base;
-  ifj17_vec_t *params;
+  ifj17_node_vec_t *params;
 } ifj17_print_node_t;
 
 /*
@@ -313,70 +375,95 @@ typedef struct {
 
 // protos
 
-ifj17_object_t *ifj17_node(ifj17_node_t *node);
+ifj17_node_vec_t *ifj17_node_vec_new(ifj17_arena_t *arena);
 
-ifj17_block_node_t *ifj17_block_node_new(int lineno);
+void ifj17_node_vec_push(ifj17_arena_t *arena, ifj17_node_vec_t *self,
+                         ifj17_node_t *node);
 
-ifj17_scope_node_t *ifj17_scope_node_new(ifj17_block_node_t *block, int lineno);
+ifj17_block_node_t *ifj17_block_node_new(ifj17_arena_t *arena, int lineno);
 
-ifj17_declare_node_t *ifj17_declare_node_new(const char *name, ifj17_node_t *type,
-                                                      ifj17_vec_t *params, int lineno);
+ifj17_scope_node_t *ifj17_scope_node_new(ifj17_arena_t *arena,
+                                         ifj17_block_node_t *block, int lineno);
 
-ifj17_function_node_t *ifj17_function_node_new(const char *name, ifj17_node_t *type,
+ifj17_declare_node_t *ifj17_declare_node_new(ifj17_arena_t *arena,
+                                             ifj17_string_t *name,
+                                             ifj17_node_t *type,
+                                             ifj17_node_vec_t *params, int lineno);
+
+ifj17_function_node_t *ifj17_function_node_new(ifj17_arena_t *arena,
+                                               ifj17_string_t *name,
+                                               ifj17_node_t *type,
                                                ifj17_block_node_t *block,
-                                               ifj17_vec_t *params, int lineno);
+                                               ifj17_node_vec_t *params, int lineno);
 
-ifj17_function_node_t *ifj17_function_node_new_from_expr(ifj17_node_t *expr,
-                                                         ifj17_vec_t *params,
+ifj17_function_node_t *ifj17_function_node_new_from_expr(ifj17_arena_t *arena,
+                                                         ifj17_node_t *expr,
+                                                         ifj17_node_vec_t *params,
                                                          int lineno);
 
-ifj17_subscript_node_t *ifj17_subscript_node_new(ifj17_node_t *left,
+ifj17_subscript_node_t *ifj17_subscript_node_new(ifj17_arena_t *arena,
+                                                 ifj17_node_t *left,
                                                  ifj17_node_t *right, int lineno);
 
-ifj17_slot_node_t *ifj17_slot_node_new(ifj17_node_t *left, ifj17_node_t *right,
-                                       int lineno);
+ifj17_slot_node_t *ifj17_slot_node_new(ifj17_arena_t *arena, ifj17_node_t *left,
+                                       ifj17_node_t *right, int lineno);
 
-ifj17_call_node_t *ifj17_call_node_new(ifj17_node_t *expr, int lineno);
+ifj17_call_node_t *ifj17_call_node_new(ifj17_arena_t *arena, ifj17_node_t *expr,
+                                       int lineno);
 
-ifj17_unary_op_node_t *ifj17_unary_op_node_new(ifj17_token op, ifj17_node_t *expr,
-                                               int postfix, int lineno);
+ifj17_unary_op_node_t *ifj17_unary_op_node_new(ifj17_arena_t *arena, ifj17_token op,
+                                               ifj17_node_t *expr, int postfix,
+                                               int lineno);
 
-ifj17_binary_op_node_t *ifj17_binary_op_node_new(ifj17_token op, ifj17_node_t *left,
+ifj17_binary_op_node_t *ifj17_binary_op_node_new(ifj17_arena_t *arena,
+                                                 ifj17_token op, ifj17_node_t *left,
                                                  ifj17_node_t *right, int lineno);
 
-ifj17_id_node_t *ifj17_id_node_new(const char *val, int lineno);
+ifj17_id_node_t *ifj17_id_node_new(ifj17_arena_t *arena, ifj17_string_t *name,
+                                   int lineno);
 
-ifj17_decl_node_t *ifj17_decl_node_new(ifj17_vec_t *vec, ifj17_node_t *type,
-                                       int lineno);
+ifj17_decl_node_t *ifj17_decl_node_new(ifj17_arena_t *arena, ifj17_node_vec_t *vec,
+                                       ifj17_node_t *type, int lineno);
 
-ifj17_dim_node_t *ifj17_dim_node_new(ifj17_vec_t *vec, int lineno);
+ifj17_dim_node_t *ifj17_dim_node_new(ifj17_arena_t *arena, ifj17_node_vec_t *vec,
+                                     int lineno);
 
-ifj17_int_node_t *ifj17_int_node_new(int val, int lineno);
+ifj17_int_node_t *ifj17_int_node_new(ifj17_arena_t *arena, int val, int lineno);
 
-ifj17_double_node_t *ifj17_double_node_new(double val, int lineno);
+ifj17_double_node_t *ifj17_double_node_new(ifj17_arena_t *arena, double val,
+                                           int lineno);
 
-ifj17_array_node_t *ifj17_array_node_new(int lineno);
+ifj17_array_node_t *ifj17_array_node_new(ifj17_arena_t *arena, int lineno);
 
-ifj17_hash_pair_node_t *ifj17_hash_pair_node_new(int lineno);
+ifj17_hash_pair_node_t *ifj17_hash_pair_node_new(ifj17_arena_t *arena, int lineno);
 
-ifj17_hash_node_t *ifj17_hash_node_new(int lineno);
+ifj17_hash_node_t *ifj17_hash_node_new(ifj17_arena_t *arena, int lineno);
 
-ifj17_string_node_t *ifj17_string_node_new(const char *val, int lineno);
+const char *ifj17_string_node_value(ifj17_string_node_t *self);
+
+ifj17_string_node_t *ifj17_string_node_new(ifj17_arena_t *arena, ifj17_string_t *str,
+                                           int lineno);
 
 ifj17_if_node_t *
-ifj17_if_node_new(ifj17_node_t *expr, ifj17_block_node_t *block, int lineno);
+ifj17_if_node_new(ifj17_arena_t *arena, ifj17_node_t *expr,
+                  ifj17_block_node_t *block, int lineno);
 
 ifj17_while_node_t *
-ifj17_while_node_new(ifj17_node_t *expr, ifj17_block_node_t *block, int lineno);
+ifj17_while_node_new(ifj17_arena_t *arena, ifj17_node_t *expr,
+                     ifj17_block_node_t *block, int lineno);
 
-ifj17_return_node_t *ifj17_return_node_new(ifj17_node_t *expr, int lineno);
+ifj17_return_node_t *ifj17_return_node_new(ifj17_arena_t *arena, ifj17_node_t *expr,
+                                           int lineno);
 
-ifj17_args_node_t *ifj17_args_node_new(int lineno);
+ifj17_args_node_t *ifj17_args_node_new(ifj17_arena_t *arena, int lineno);
 
-ifj17_type_node_t *ifj17_type_node_new(const char *name, int lineno);
+ifj17_type_node_t *ifj17_type_node_new(ifj17_arena_t *arena, ifj17_string_t *name,
+                                       int lineno);
 
-ifj17_print_node_t *ifj17_print_node_new(ifj17_vec_t *params, int lineno);
+ifj17_print_node_t *ifj17_print_node_new(ifj17_arena_t *arena,
+                                         ifj17_node_vec_t *params, int lineno);
 
-ifj17_input_node_t *ifj17_input_node_new(ifj17_node_t *param, int lineno);
+ifj17_input_node_t *ifj17_input_node_new(ifj17_arena_t *arena, ifj17_node_t *param,
+                                         int lineno);
 
 #endif /* IFJ17_AST_H */
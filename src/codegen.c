@@ -4,787 +4,461 @@
 // Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
 //
 
-#include "ast.h"
 #include "codegen.h"
+#include "fold.h"
 #include "internal.h"
-#include "opcodes.h"
-#include "visitor.h"
+#include "lower.h"
+#include "peephole.h"
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
-
-// TODO: MSB
-#define CONST(val)                                                                  \
-  (vm->main->constants[vm->main->nconstants] = val, 32 + vm->main->nconstants++)
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 /*
- * Emit an instruction.
+ * Append to the output: the string literal `lit`, the nul-terminated
+ * `str`, the decimal `n` and the IR operand `operand`.
  */
 
-#define emit(op, a, b, c) *vm->main->code++ = ABC(op, a, b, c);
-
-// BINARY_OP
-static int bin_op = 0;
-static int rel = 0;
-
-// IF
-static int from_if = 0;
-static int else_if_num = 0;
-static int else_num = 0;
-static int end_if_num = 0;
-
-// FUNCTION
-static int args = 0;
-static int params = 0;
-static int from_func = 0;
-static int from_call = 0;
-static int from_return = 0;
-static int glob_var = 0;
-static int loc_var = 0;
-static int scope = 0;
-
-// LOOPS
-static int from_loop = 0;
-static int loop_num = 0;
-static int mem_loop_num = 0;
-
-static int not = 0;
-static int from_minus = 0;
-static int from_dim = 0;
-static int label_cont = 0;
-static int int2float = 0;
-// static int func_control = 0;
-
-// print function
-
-int (*print_func)(const char *format, ...);
-
-void ifj17_set_codegenprint_func(int (*func)(const char *format, ...)) {
-  print_func = func;
-}
+#define text(lit) ifj17_emit_str(&self->out, lit)
+#define cstr(str) ifj17_emit_bytes(&self->out, str, strlen(str))
+#define number(n) ifj17_emit_int(&self->out, n)
+#define operand(operand) emit_operand(self, &(operand))
 
 /*
- * Emit binary operation.
+ * The frame variables of the function printed live in, its
+ * own for functions and the global one for the main scope.
  */
 
-static void emit_op(ifj17_visitor_t *self, ifj17_binary_op_node_t *node) {
-  switch (node->op) {
-  case IFJ17_TOKEN_OP_PLUS:
-    print_func("TYPE TF@temp_bool_1 ");
-    visit(node->left);
-    print_func("\n");
-    print_func("TYPE TF@temp_bool_2 ");
-    visit(node->right);
-    print_func("\n");
-    print_func("JUMPIFNEQ END_IF_0 TF@temp_bool_1 TF@temp_bool_2\n");
-    print_func("ADD ");
-    break;
-
-  case IFJ17_TOKEN_OP_MINUS:
-    print_func("TYPE TF@temp_bool_1 ");
-    visit(node->left);
-    print_func("\n");
-    print_func("TYPE TF@temp_bool_2 ");
-    visit(node->right);
-    print_func("\n");
-    print_func("JUMPIFNEQ END_IF_0 TF@temp_bool_1 TF@temp_bool_2\n");
-    print_func("SUB ");
-    break;
-  case IFJ17_TOKEN_OP_MUL:
-    print_func("TYPE TF@temp_bool_1 ");
-    visit(node->left);
-    print_func("\n");
-    print_func("TYPE TF@temp_bool_2 ");
-    visit(node->right);
-    print_func("\n");
-    print_func("JUMPIFNEQ END_IF_0 TF@temp_bool_1 TF@temp_bool_2\n");
-    print_func("MUL ");
-    break;
-  case IFJ17_TOKEN_OP_DIV:
-    int2float = 0;
-    label_cont = 0;
-    print_func("TYPE TF@temp_bool_1 ");
-    visit(node->left);
-    print_func("\n");
-    print_func("TYPE TF@temp_bool_2 float@1.5\n");
-    int2float++;
-    print_func("JUMPIFNEQ RES_IF_int2float_%d TF@temp_bool_1 TF@temp_bool_2\n",
-               int2float);
-    label_cont++;
-    print_func("JUMP CONT_%d\n", label_cont);
-    print_func("LABEL RES_IF_int2float_%d\n", int2float);
-    print_func("INT2FLOAT ");
-    visit(node->left);
-    print_func(" ");
-    visit(node->left);
-    print_func("\n");
-    print_func("LABEL CONT_%d\n", label_cont);
-
-    print_func("TYPE TF@temp_bool_1 ");
-    visit(node->right);
-    print_func("\n");
-    print_func("TYPE TF@temp_bool_2 float@1.5\n");
-    int2float++;
-    print_func("JUMPIFNEQ RES_IF_int2float_%d TF@temp_bool_1 TF@temp_bool_2\n",
-               int2float);
-    label_cont++;
-    print_func("JUMP CONT_%d\n", label_cont);
-    print_func("LABEL RES_IF_int2float_%d\n", label_cont);
-    print_func("INT2FLOAT ");
-    visit(node->right);
-    print_func(" ");
-    visit(node->right);
-    print_func("\n");
-    print_func("LABEL CONT_%d\n", label_cont);
-
-    print_func("DIV ");
-    break;
-  case IFJ17_TOKEN_OP_EQ:
-    print_func("TYPE TF@temp_bool_1 ");
-    visit(node->left);
-    print_func("\n");
-    print_func("TYPE TF@temp_bool_2 ");
-    visit(node->right);
-    print_func("\n");
-    print_func("JUMPIFNEQ END_IF_0 TF@temp_bool_1 TF@temp_bool_2\n");
-
-    print_func("JUMPIFEQ ");
-    if (from_if == 1) {
-      print_func("RES_IF_%d ", else_if_num);
-      from_if--;
-    }
-
-    if (from_loop == 1) {
-      print_func("LOOP_%d ", loop_num--);
-      from_loop--;
-    }
-    break;
-
-  case IFJ17_TOKEN_OP_NEQ:
-    print_func("TYPE TF@temp_bool_1 ");
-    visit(node->left);
-    print_func("\n");
-    print_func("TYPE TF@temp_bool_2 ");
-    visit(node->right);
-    print_func("\n");
-    print_func("JUMPIFNEQ END_IF_0 TF@temp_bool_1 TF@temp_bool_2\n");
-
-    print_func("JUMPIFNEQ ");
-    if (from_if == 1) {
-      print_func("RES_IF_%d ", else_if_num);
-      from_if--;
-    }
-    break;
-
-  case IFJ17_TOKEN_OP_BIT_AND:
-    print_func("AND ");
-    break;
+#define frame() (self->func->name ? "TF" : "GF")
 
-  case IFJ17_TOKEN_OP_BIT_OR:
-    print_func("OR ");
-    break;
+/*
+ * Is `node` a unit of its own, a function or the main scope?
+ */
 
-  case IFJ17_TOKEN_OP_LNOT:
-    print_func("NOT ");
-    break;
-    // case IFJ17_TOKEN_OP_MOD:
-    //   emit(MOD, 0, l, r);
-    //   break;
-    // case IFJ17_TOKEN_OP_LT:
-    //   emit(LT, 0, l, r);
-    //   emit(JMP, 0, 1, 0);
-    //   emit(LOADB, 0, CONST(1), 1);
-    //   emit(LOADB, 0, CONST(0), 0);
-    //   break;
-    // case IFJ17_TOKEN_OP_LTE:
-    //   emit(LTE, 0, l, r);
-    //   emit(JMP, 0, 1, 0);
-    //   emit(LOADB, 0, CONST(1), 1);
-    //   emit(LOADB, 0, CONST(0), 0);
-    //   break;
-  }
-}
+#define unit(node)                                                                  \
+  (IFJ17_NODE_FUNCTION == (node)->type || IFJ17_NODE_SCOPE == (node)->type)
 
 /*
+ * Top-level functions and the main scope, lowered and
+ * printed ahead of splicing into `outs`. Workers claim them
+ * through `next` and add their peephole hits to `context`.
+ */
 
-0: lt 5 2;
- : false1:
- : ...
- : ...
- : true1:
- : ...
- : ...
- : endif1:
- : ...
- : ...
- : ...
-*/
+typedef struct {
+  ifj17_codegen_ctx_t *context;
+  ifj17_node_t **funcs;
+  ifj17_emitter_t *outs;
+  int nfuncs;
+  int next;
+} units_t;
 
 /*
- * Visit block `node`.
+ * Local slot by name, for finding the locals named alike.
  */
 
-static void visit_block(ifj17_visitor_t *self, ifj17_block_node_t *node) {
-  ifj17_vec_each(node->stmts, { visit((ifj17_node_t *)val->value.as_pointer); });
-}
+typedef struct {
+  ifj17_string_t *name;
+  int slot;
+} named_t;
 
 /*
- * Visit int `node`.
+ * IFJcode17 types READ converts to, by datatype.
  */
 
-static void visit_int(ifj17_visitor_t *self, ifj17_int_node_t *node) {
-  if (from_return == 1) {
-    printf("PUSHS ");
-    print_func("int@%d", node->val);
-    from_return--;
-  } else if (from_minus == 1) {
-    print_func("int@-%d", node->val);
-    from_minus--;
-  } else {
-    print_func("int@%d", node->val);
-  }
-}
+static const char *read_types[] = {"string", "int", "float", "string", "bool"};
 
 /*
- * Visit double `node`.
+ * Emit local `slot`, a shadowing declaration qualified by
+ * its slot as "name$slot", there being one frame per function.
  */
 
-static void visit_double(ifj17_visitor_t *self, ifj17_double_node_t *node) {
+static void emit_local(ifj17_codegen_ctx_t *self, int slot) {
+  ifj17_string_t *name = kv_A(self->func->locals, slot).name;
 
-  if (from_minus == 1) {
-    print_func("float@-%g", node->val);
-    from_minus--;
-  } else {
-    print_func("float@%g", node->val);
+  ifj17_emit_var(&self->out, frame(), name->val, name->len);
+  if (self->shadowed[slot]) {
+    text("$");
+    number(slot);
   }
 }
 
 /*
- * Visit id `node`.
+ * Emit label `n`, within the function's namespace as
+ * "name$prefix_n".
  */
 
-static void visit_id(ifj17_visitor_t *self, ifj17_id_node_t *node) {
-
-  emit_op(self, node);
-
-  if (from_call == 1) {
-    print_func("%s", node->val);
-    from_call--;
-  } else if (from_func == 1 && from_return == 0) {
-    print_func("TF@%s", node->val);
-    if (args) {
-      printf("\n");
-    }
-  } else if (from_return == 1) {
-    printf("PUSHS ");
-    print_func("TF@%s", node->val);
-    from_return--;
-  }
-  // } else if (func_control == 1) {
-  //   if (!strcmp(("%s", node->val), "length")) {
-  //     printf("STRLEN");
-  //   }
-  // } else if (func_control == 2) {
-  //   print_func("GF@%s", node->val);
-  // }
-
-  else {
-    print_func("GF@%s", node->val);
-    if (args) {
-      print_func("\n", node->val);
-    }
+static void emit_label(ifj17_codegen_ctx_t *self, int n) {
+  if (self->func->name) {
+    ifj17_emit_bytes(&self->out, self->func->name->val, self->func->name->len);
+    text("$");
   }
+  ifj17_emit_label(&self->out, kv_A(self->func->labels, n), n);
 }
 
 /*
- * Visit decl `node`.
+ * Emit the IR `operand` as an IFJcode17 symbol.
  */
 
-static void visit_decl(ifj17_visitor_t *self, ifj17_decl_node_t *node) {
-
-  ifj17_vec_each(node->vec, {
+static void emit_operand(ifj17_codegen_ctx_t *self, ifj17_ir_operand_t *operand) {
+  ifj17_string_t *str;
 
-    if (params == 1) {
-      print_func("DEFVAR ");
-      visit((ifj17_node_t *)val->value.as_pointer);
-      print_func("\n");
-
-      printf("POPS ");
-      visit((ifj17_node_t *)val->value.as_pointer);
-      print_func("\n");
-
-    } else if (from_dim == 1) {
-      visit((ifj17_node_t *)val->value.as_pointer);
-      print_func(" ");
-    } else {
-      print_func("DEFVAR ");
-      visit((ifj17_node_t *)val->value.as_pointer);
-      print_func("\n");
-    }
-  });
+  switch (operand->kind) {
+  case IFJ17_IR_LOCAL:
+    emit_local(self, operand->val.index);
+    break;
+  case IFJ17_IR_TEMP:
+    cstr(frame());
+    text("@$");
+    number(operand->val.index);
+    break;
+  case IFJ17_IR_INT:
+    ifj17_emit_int_literal(&self->out, operand->val.as_int);
+    break;
+  case IFJ17_IR_DOUBLE:
+    ifj17_emit_float_literal(&self->out, operand->val.as_double);
+    break;
+  case IFJ17_IR_STRING:
+    str = operand->val.as_string;
+    ifj17_emit_string_literal(&self->out, str->val, str->len);
+    break;
+  case IFJ17_IR_BOOL:
+    operand->val.as_int ? text("bool@true") : text("bool@false");
+    break;
+  case IFJ17_IR_LABEL:
+    emit_label(self, operand->val.index);
+    break;
+  case IFJ17_IR_FUNC:
+    str = operand->val.as_string;
+    ifj17_emit_bytes(&self->out, str->val, str->len);
+    break;
+  case IFJ17_IR_TYPE:
+    cstr(read_types[operand->datatype]);
+    break;
+  }
 }
 
 /*
- * Visit string `node`.
+ * Emit "DEFVAR" of local `slot`.
  */
 
-static void visit_string(ifj17_visitor_t *self, ifj17_string_node_t *node) {
-  print_func("string@%s", node->val);
+static void emit_defvar(ifj17_codegen_ctx_t *self, int slot) {
+  text("DEFVAR ");
+  emit_local(self, slot);
+  text("\n");
 }
 
 /*
- * Visit unary op `node`.
+ * Emit the prologue of the function printed: its label, the
+ * frame of a function with the params popped off the data
+ * stack, the last pushed first, then every other variable,
+ * so none is redefined within a loop.
  */
 
-static void visit_unary_op(ifj17_visitor_t *self, ifj17_unary_op_node_t *node) {
+static void emit_prologue(ifj17_codegen_ctx_t *self) {
+  ifj17_ir_func_t *func = self->func;
+  int nlocals = kv_size(func->locals);
 
-  if (!strcmp(ifj17_token_type_string(node->op), "not")) {
-
-    if (not == 0) {
-      not++;
-      emit_op(self, node);
-      return;
-    } else if (not == 2) {
-      visit(node->expr);
-      not = 0;
-      return;
-    }
-  } else if (!strcmp(ifj17_token_type_string(node->op), "-")) {
-    if (not == 0) {
-      not++;
-      if (from_dim != 1) {
-        printf("MOVE ");
-      }
-      return;
-    } else if (not == 2) {
-      from_minus++;
-      visit(node->expr);
-      not = 0;
-      return;
-    }
+  if (!func->name) {
+    text("LABEL Scope\n");
+  } else {
+    text("LABEL ");
+    ifj17_emit_bytes(&self->out, func->name->val, func->name->len);
+    text("\nCREATEFRAME\n");
   }
-}
 
-/*
- * Visit binary op `node`.
- */
-
-static void visit_binary_op(ifj17_visitor_t *self, ifj17_binary_op_node_t *node) {
-
-  if (!strcmp(ifj17_token_type_string(node->op), "=")) {
-    if (node->right->type != IFJ17_NODE_BINARY_OP) {
-
-      if (node->right->type == IFJ17_NODE_CALL) {
-
-        // func_control++;
-        // if (func_control == 1) {
-        //   visit(node->right);
-        //   print_func(" ");
-        //   func_control++;
-        //   visit(node->left);
-        //   print_func(" ");
-        //   visit(node->right);
-        //   print_func("\n");
-        //   func_control--;
-        //   return;
-        // }
-
-        visit(node->right);
-        print_func("\n");
-        print_func("POPS ");
-        visit(node->left);
-        print_func("\n");
-        return;
-      }
-
-      else if (node->right->type == IFJ17_NODE_UNARY_OP) {
-
-        visit(node->right);
-        not++;
-        visit(node->left);
-        print_func(" ");
-        visit(node->right);
-        print_func("\n");
-        return;
-      }
-
-      else {
-        if (from_if == 1) {
-          print_func("TYPE TF@temp_bool_1 ");
-          visit(node->left);
-          print_func("\n");
-          print_func("TYPE TF@temp_bool_2 ");
-          visit(node->right);
-          print_func("\n");
-          print_func("JUMPIFNEQ END_IF_0 TF@temp_bool_1 TF@temp_bool_2\n");
-          print_func("JUMPIFEQ ");
-          print_func("RES_IF_%d ", else_if_num);
-          visit(node->right);
-          printf(" ");
-          visit(node->left);
-          printf("\n");
-          from_if--;
-          return;
-        }
-
-        print_func("MOVE ");
-        visit(node->left);
-        print_func(" ");
-        visit(node->right);
-        print_func("\n");
-        return;
-      }
-    }
+  for (int i = 0; i < func->nparams; ++i) {
+    emit_defvar(self, i);
   }
-
-  // emit_op(self, node);
-
-  if (!strcmp(ifj17_token_type_string(node->op), "+") ||
-      !strcmp(ifj17_token_type_string(node->op), "-") ||
-      !strcmp(ifj17_token_type_string(node->op), "*") ||
-      !strcmp(ifj17_token_type_string(node->op), "/") ||
-      !strcmp(ifj17_token_type_string(node->op), "and") ||
-      !strcmp(ifj17_token_type_string(node->op), "or")) {
-
-    if (bin_op == 1) {
-      emit_op(self, node);
-      return;
-    } else if (bin_op == 2) {
-      visit(node->left);
-      print_func(" ");
-      visit(node->right);
-      print_func("\n");
-      bin_op = bin_op - 2;
-      return;
-    }
+  for (int i = func->nparams - 1; i >= 0; --i) {
+    text("POPS ");
+    emit_local(self, i);
+    text("\n");
   }
 
-  else if (!strcmp(ifj17_token_type_string(node->op), "==") ||
-           !strcmp(ifj17_token_type_string(node->op), "<>")) {
-    emit_op(self, node);
-    visit(node->left);
-    print_func(" ");
-    visit(node->right);
-    print_func("\n");
-    return;
+  for (int i = func->nparams; i < nlocals; ++i) {
+    emit_defvar(self, i);
   }
-
-  else if (!strcmp(ifj17_token_type_string(node->op), ">") ||
-           !strcmp(ifj17_token_type_string(node->op), "<")) {
-
-    print_func("TYPE TF@temp_bool_1 ");
-    visit(node->left);
-    print_func("\n");
-    print_func("TYPE TF@temp_bool_2 ");
-    visit(node->right);
-    print_func("\n");
-    print_func("JUMPIFNEQ END_IF_0 TF@temp_bool_1 TF@temp_bool_2\n");
-
-    printf("DEFVAR TF@temp_bool_rel\n");
-    printf("GT TF@temp_bool_rel ");
-    visit(node->left);
-    printf(" ");
-    visit(node->right);
-    printf("\n");
-    printf("JUMPIFEQ RES_IF_%d TF@temp_bool_rel ", else_if_num);
-    printf("bool@true");
-    print_func("\n");
-    return;
+  for (size_t i = 0; i < kv_size(func->temps); ++i) {
+    text("DEFVAR ");
+    cstr(frame());
+    text("@$");
+    number(i);
+    text("\n");
   }
-
-  bin_op++;
-  visit(node->right);
-  visit(node->left);
-  print_func(" ");
-  bin_op++;
-  visit(node->right);
 }
 
 /*
- * Visit array `node`.
+ * Emit `instr`. Calls from a function save its frame around
+ * the callee's, which pushes its result before returning.
  */
 
-static void visit_array(ifj17_visitor_t *self, ifj17_array_node_t *node) {
-  // printf("(array\n");
-  // ++indents;
-  // ifj17_vec_each(node->vals, {
-  //   INDENT;
-  //   visit((ifj17_node_t *) val->value.as_pointer);
-  //   if (i != len - 1) printf("\n");
-  // });
-  // --indents;
-  // printf(")");
-}
-
-/*
- * Visit hash `node`.
- */
+static void emit_instr(ifj17_codegen_ctx_t *self, ifj17_ir_instr_t *instr) {
+  switch (instr->op) {
+  case IFJ17_IR_CALL:
+    if (self->func->name) {
+      text("PUSHFRAME\nCALL ");
+      operand(instr->a);
+      text("\nPOPFRAME\n");
+    } else {
+      text("CALL ");
+      operand(instr->a);
+      text("\n");
+    }
+    text("POPS ");
+    operand(instr->dst);
+    text("\n");
+    return;
+  case IFJ17_IR_RETURN:
+    text("PUSHS ");
+    operand(instr->a);
+    text("\nRETURN\n");
+    return;
+  }
 
-static void visit_hash(ifj17_visitor_t *self, ifj17_hash_node_t *node) {
-  // printf("(hash\n");
-  // ++indents;
-  // ifj17_hash_each(node->vals, {
-  //   INDENT;
-  //   printf("%s: ", slot);
-  //   visit((ifj17_node_t *) val->value.as_pointer);
-  //   printf("\n");
-  // });
-  // --indents;
-  // printf(")");
+  cstr(ifj17_ir_op_strings[instr->op]);
+  if (IFJ17_IR_NONE != instr->dst.kind) {
+    text(" ");
+    operand(instr->dst);
+  }
+  if (IFJ17_IR_NONE != instr->a.kind) {
+    text(" ");
+    operand(instr->a);
+  }
+  if (IFJ17_IR_NONE != instr->b.kind) {
+    text(" ");
+    operand(instr->b);
+  }
+  text("\n");
 }
 
 /*
- * Visit subscript `node`.
- */
-
-static void visit_subscript(ifj17_visitor_t *self, ifj17_subscript_node_t *node) {}
-
-/*
- * Visit slot `node`.
+ * Order locals by name, then by slot.
  */
 
-static void visit_slot(ifj17_visitor_t *self, ifj17_slot_node_t *node) {
-  // printf("(slot\n");
-  // ++indents;
-  // INDENT;
-  // visit(node->left);
-  // printf("\n");
-  // INDENT;
-  // visit(node->right);
-  // --indents;
-  // printf(")");
+static int compare_named(const void *a, const void *b) {
+  const named_t *x = a, *y = b;
+  if (x->name != y->name) {
+    return (uintptr_t)x->name < (uintptr_t)y->name ? -1 : 1;
+  }
+  return x->slot - y->slot;
 }
 
 /*
- * Visit call `node`.
+ * Print `func` as IFJcode17 into the context's output.
+ * Return 0 on failure.
  */
 
-static void visit_call(ifj17_visitor_t *self, ifj17_call_node_t *node) {
-
-  // if (func_control == 1 || func_control == 2) {
-  //   //  visit((ifj17_node_t *)node->expr);
-  //   if (func_control == 2) {
-  //     ifj17_vec_each(node->args->vec,
-  //                    { visit((ifj17_node_t *)val->value.as_pointer); });
-  //     return;
-  //   }
-  //   visit((ifj17_node_t *)node->expr);
-  //   return;
-  // }
-
-  args = ifj17_vec_length(node->args->vec);
-
-  if (ifj17_vec_length(node->args->vec)) {
-    print_func("PUSHS ");
-
-    ifj17_vec_each(node->args->vec,
-                   { visit((ifj17_node_t *)val->value.as_pointer); });
-    args = 0;
+int ifj17_codegen_func(ifj17_codegen_ctx_t *self, ifj17_ir_func_t *func) {
+  int nlocals = kv_size(func->locals);
+  named_t *named = malloc((nlocals + 1) * sizeof(named_t));
+
+  // locals named alike share a frame: sorted by name then
+  // slot, all but the first of each name are shadowing
+  self->shadowed = calloc(nlocals + 1, 1);
+  if (unlikely(!self->shadowed || !named)) {
+    free(self->shadowed);
+    free(named);
+    self->shadowed = NULL;
+    return 0;
   }
-  if (scope != 1) {
-    printf("PUSHFRAME\n");
+  for (int i = 0; i < nlocals; ++i) {
+    named[i] = (named_t){kv_A(func->locals, i).name, i};
   }
-
-  else {
-    print_func("CALL ");
-    from_call++;
-    visit((ifj17_node_t *)node->expr);
+  qsort(named, nlocals, sizeof(named_t), compare_named);
+  for (int i = 1; i < nlocals; ++i) {
+    self->shadowed[named[i].slot] = named[i].name == named[i - 1].name;
   }
+  free(named);
 
-  if (scope != 1) {
-    printf("\nPOPFRAME");
-  }
-}
+  self->func = func;
+  emit_prologue(self);
 
-/*
- * Visit scope `node`.
- */
+  for (size_t b = 0; b < kv_size(func->blocks); ++b) {
+    ifj17_ir_block_t *block = &kv_A(func->blocks, b);
+    if (-1 != block->label) {
+      text("LABEL ");
+      emit_label(self, block->label);
+      text("\n");
+    }
 
-static void visit_scope(ifj17_visitor_t *self, ifj17_scope_node_t *node) {
+    for (int i = block->first; i < block->first + block->len; ++i) {
+      emit_instr(self, &kv_A(func->code, i));
+    }
+  }
 
-  print_func("LABEL Scope\n");
-  print_func("CREATEFRAME\n");
-  print_func("DEFVAR TF@temp_bool_1\nDEFVAR TF@temp_bool_2\n");
-  scope++;
-  visit((ifj17_node_t *)node->block);
-  scope--;
-  print_func("LABEL END_IF_0\n");
+  free(self->shadowed);
+  self->shadowed = NULL;
+  self->func = NULL;
+  return !self->out.failed;
 }
 
 /*
- * Visit dim `node`.
+ * Initialize a codegen context with empty output and the
+ * peephole pass enabled.
  */
 
-static void visit_dim(ifj17_visitor_t *self, ifj17_dim_node_t *node) {
-
-  if (from_func == 1) {
-    loc_var++;
-  }
-  ifj17_vec_each(node->vec, {
-    ifj17_binary_op_node_t *bin = (ifj17_binary_op_node_t *)val->value.as_pointer;
-
-    visit(bin->left);
-
-    if (bin->right) {
-      from_dim++;
-      print_func("MOVE ");
-      visit(bin->left);
-      visit(bin->right);
-      not++;
-      visit(bin->right);
-      from_dim--;
-    }
-  });
+void ifj17_codegen_ctx_init(ifj17_codegen_ctx_t *self) {
+  memset(self, 0, sizeof(ifj17_codegen_ctx_t));
+  ifj17_emitter_init(&self->out);
+  self->peephole = 1;
 }
 
 /*
- * Visit function `node`.
+ * Free the context's output.
  */
 
-static void visit_function(ifj17_visitor_t *self, ifj17_function_node_t *node) {
-  from_func++;
-  printf("LABEL ");
-  print_func("%s\n", node->name);
-  printf("CREATEFRAME \n");
-
-  ifj17_vec_each(node->params, {
-    params++;
-    visit((ifj17_node_t *)val->value.as_pointer);
-    params--;
-  });
-
-  visit((ifj17_node_t *)node->block);
-
-  from_func--;
+void ifj17_codegen_ctx_free(ifj17_codegen_ctx_t *self) {
+  ifj17_emitter_free(&self->out);
 }
 
 /*
- * Visit `while` node.
+ * Lower the function or main scope `node`, fold it, apply the
+ * peephole rules unless disabled and print it into the
+ * context's output.
  */
 
-static void visit_while(ifj17_visitor_t *self, ifj17_while_node_t *node) {
-  loop_num = mem_loop_num;
-  printf("LABEL LOOP_%d\n", ++loop_num);
-  mem_loop_num++;
-  visit((ifj17_node_t *)node->block);
+static void generate(ifj17_codegen_ctx_t *context, ifj17_node_t *node) {
+  ifj17_ir_func_t func;
+  int ok = IFJ17_NODE_FUNCTION == node->type
+               ? ifj17_lower_function(&func, (ifj17_function_node_t *)node)
+               : ifj17_lower_scope(&func, (ifj17_scope_node_t *)node);
 
-  from_loop++;
-  visit((ifj17_node_t *)node->expr);
+  ok = ok && ifj17_fold(&func);
+  ok = ok && (!context->peephole || ifj17_peephole(&func, context->hits));
+  if (unlikely(!ok || !ifj17_codegen_func(context, &func))) {
+    context->out.failed = 1;
+  }
+  ifj17_ir_func_free(&func);
 }
 
 /*
- * Visit `return` node.
+ * Generate units until none are left, each with a fresh
+ * context.
  */
 
-static void visit_return(ifj17_visitor_t *self, ifj17_return_node_t *node) {
-
-  if (node->expr) {
-    from_return++;
-    visit((ifj17_node_t *)node->expr);
-    print_func(" \n");
+static void *work(void *data) {
+  units_t *units = data;
+  int i;
+
+  while ((i = __atomic_fetch_add(&units->next, 1, __ATOMIC_RELAXED)) <
+         units->nfuncs) {
+    ifj17_codegen_ctx_t context;
+    ifj17_codegen_ctx_init(&context);
+    context.peephole = units->context->peephole;
+    generate(&context, units->funcs[i]);
+    units->outs[i] = context.out;
+    for (int r = 0; r < IFJ17_PEEPHOLE_RULES; ++r) {
+      __atomic_fetch_add(&units->context->hits[r], context.hits[r],
+                         __ATOMIC_RELAXED);
+    }
   }
-  print_func("RETURN\n");
+
+  return NULL;
 }
 
 /*
- * Visit if `node`.
+ * Generate the top-level functions and main scope of `node`
+ * on up to `context->jobs` threads, the calling one included.
+ * Return 0 on failure.
  */
 
-static void visit_if(ifj17_visitor_t *self, ifj17_if_node_t *node) {
-  // We need these counters to make LABELs in bytecode with
-  // unique name. Should be refactored later if we have enough time
-
-  int mem_else_if_num = else_if_num;
-  else_if_num++;
-  from_if++;
-  end_if_num++;
+static int generate_units(units_t *units, ifj17_codegen_ctx_t *context,
+                          ifj17_node_t *node) {
+  pthread_t threads[IFJ17_CODEGEN_MAX_JOBS];
+  int nthreads = 0, jobs = context->jobs;
 
-  visit((ifj17_node_t *)node->expr);
+  memset(units, 0, sizeof(units_t));
+  units->context = context;
+  if (IFJ17_NODE_BLOCK != node->type) {
+    return 1;
+  }
 
-  // else ifs
-  ifj17_vec_each(node->else_ifs, {
-    from_if++;
-    else_if_num++;
-    ifj17_if_node_t *else_if = (ifj17_if_node_t *)val->value.as_pointer;
-    visit((ifj17_node_t *)else_if->expr);
+  ifj17_node_vec_t *stmts = ((ifj17_block_node_t *)node)->stmts;
+  ifj17_node_vec_each(stmts, {
+    if (unit(val))
+      units->nfuncs++;
   });
-
-  // else
-  if (node->else_block) {
-    print_func("JUMP RES_ELSE_%d\n", ++else_num);
+  if (!units->nfuncs) {
+    return 1;
   }
 
-  if (!node->else_block && ifj17_vec_length(node->else_ifs) == 0) {
-    print_func("JUMP END_IF_%d\n", end_if_num);
+  units->funcs = malloc(units->nfuncs * sizeof(ifj17_node_t *));
+  units->outs = malloc(units->nfuncs * sizeof(ifj17_emitter_t));
+  if (unlikely(!units->funcs || !units->outs)) {
+    free(units->funcs);
+    free(units->outs);
+    return 0;
   }
 
-  print_func("LABEL RES_IF_%d\n", ++mem_else_if_num);
+  int n = 0;
+  ifj17_node_vec_each(stmts, {
+    if (unit(val))
+      units->funcs[n++] = val;
+  });
 
-  visit((ifj17_node_t *)node->block);
+  if (jobs > units->nfuncs)
+    jobs = units->nfuncs;
+  if (jobs > IFJ17_CODEGEN_MAX_JOBS)
+    jobs = IFJ17_CODEGEN_MAX_JOBS;
 
-  print_func("JUMP END_IF_%d\n", end_if_num);
+  // a thread failing to start leaves its share to the others
+  while (nthreads < jobs - 1 &&
+         !pthread_create(&threads[nthreads], NULL, work, units)) {
+    ++nthreads;
+  }
 
-  // else ifs
-  ifj17_vec_each(node->else_ifs, {
-    ifj17_if_node_t *else_if = (ifj17_if_node_t *)val->value.as_pointer;
-    print_func("LABEL RES_IF_%d\n", ++mem_else_if_num);
-    visit((ifj17_node_t *)else_if->block);
-    print_func("JUMP END_IF_%d\n", end_if_num);
-  });
+  work(units);
 
-  if (node->else_block) {
-    print_func("LABEL RES_ELSE_%d\n", else_num);
-    visit((ifj17_node_t *)node->else_block);
-    print_func("JUMP END_IF_%d\n", end_if_num);
+  while (nthreads) {
+    pthread_join(threads[--nthreads], NULL);
   }
 
-  print_func("LABEL END_IF_%d\n", end_if_num);
+  return 1;
 }
 
 /*
- * Visit `type` node.
+ * Generate code for the analyzed `node` within `context`. Its
+ * functions and main scope are lowered to IR and printed on
+ * `context->jobs` threads, then spliced into the output in
+ * source order. Return 0 on failure.
  */
 
-static void visit_type(ifj17_visitor_t *self, ifj17_type_node_t *node) {}
+int ifj17_codegen(ifj17_codegen_ctx_t *context, ifj17_node_t *node) {
+  units_t units;
+  if (unlikely(!generate_units(&units, context, node))) {
+    return 0;
+  }
+
+  context->units = units.outs;
+
+  ifj17_emit_str(&context->out, ".IFJcode17\n");
+  ifj17_emit_str(&context->out, "JUMP Scope\n");
+  for (int i = 0; i < units.nfuncs; ++i) {
+    ifj17_emitter_t *out = &units.outs[i];
+    ifj17_emit_bytes(&context->out, out->buf, out->len);
+    context->out.failed |= out->failed;
+    ifj17_emitter_free(out);
+  }
+  ifj17_emit_str(&context->out, "\n");
+
+  free(units.funcs);
+  free(units.outs);
+  context->units = NULL;
+  return !context->out.failed;
+}
 
 /*
- * Generate code for the given `node`.
+ * Generate code for the given `node` within `context`,
+ * writing the output to stdout at once. Return 0 on failure.
  */
 
-ifj17_vm_t *ifj17_gen(ifj17_node_t *node) {
-  ifj17_vm_t *vm = malloc(sizeof(ifj17_vm_t));
-  if (!vm)
-    return NULL;
-  vm->main = malloc(sizeof(ifj17_activation_t));
-  vm->main->nconstants = 0;
-  vm->main->constants = malloc(1024 * sizeof(int)); // TODO: vec / objects
-  vm->main->ip = vm->main->code = malloc(64 * 1024);
-  ifj17_visitor_t visitor = {.data = (void *)vm,
-                             .visit_if = visit_if,
-                             .visit_id = visit_id,
-                             .visit_int = visit_int,
-                             .visit_slot = visit_slot,
-                             .visit_call = visit_call,
-                             .visit_hash = visit_hash,
-                             .visit_array = visit_array,
-                             .visit_while = visit_while,
-                             .visit_block = visit_block,
-                             .visit_dim = visit_dim,
-                             .visit_decl = visit_decl,
-                             .visit_double = visit_double,
-                             .visit_string = visit_string,
-                             .visit_return = visit_return,
-                             .visit_function = visit_function,
-                             .visit_scope = visit_scope,
-                             .visit_unary_op = visit_unary_op,
-                             .visit_binary_op = visit_binary_op,
-                             .visit_subscript = visit_subscript,
-                             .visit_type = visit_type};
-
-  print_func(".IFJcode17\n");
-  print_func("JUMP Scope\n");
-  ifj17_visit(&visitor, node);
-
-  // Reset code so we can free it later
-  vm->main->code = vm->main->ip;
-  print_func("\n");
-  return vm;
+int ifj17_gen(ifj17_codegen_ctx_t *context, ifj17_node_t *node) {
+  int ok = ifj17_codegen(context, node);
+  fflush(stdout);
+  if (ifj17_emitter_write(&context->out, STDOUT_FILENO) < 0) {
+    perror("write");
+  }
+  return ok;
 }
@@ -8,13 +8,47 @@
 #define IFJ17_CODE_H
 
 #include "ast.h"
-#include "vm.h"
+#include "emitter.h"
+#include "ir.h"
+#include "peephole.h"
+
+// Most codegen threads
+#ifndef IFJ17_CODEGEN_MAX_JOBS
+#define IFJ17_CODEGEN_MAX_JOBS 64
+#endif
+
+/*
+ * Codegen context, all the state of printing one compilation
+ * unit as IFJcode17, so units can be printed concurrently.
+ * The code is appended to `out`.
+ */
+
+typedef struct {
+  ifj17_emitter_t out;
+
+  // parallel functions
+  int jobs;
+  ifj17_emitter_t *units;
+  // peephole pass and its hits per rule
+  int peephole;
+  int hits[IFJ17_PEEPHOLE_RULES];
+
+  // function printed
+  ifj17_ir_func_t *func;
+  unsigned char *shadowed;
+} ifj17_codegen_ctx_t;
 
 // prototypes
-void ifj17_set_codegenprint_func(int (*func)(const char *format, ...));
 
+void ifj17_codegen_ctx_init(ifj17_codegen_ctx_t *self);
+
+void ifj17_codegen_ctx_free(ifj17_codegen_ctx_t *self);
+
+int ifj17_codegen_func(ifj17_codegen_ctx_t *self, ifj17_ir_func_t *func);
+
+int ifj17_codegen(ifj17_codegen_ctx_t *context, ifj17_node_t *node);
 
-ifj17_vm_t *ifj17_gen(ifj17_node_t *node);
+int ifj17_gen(ifj17_codegen_ctx_t *context, ifj17_node_t *node);
 
 
 #endif /* IFJ17_CODE_H */
@@ -0,0 +1,264 @@
+//
+// emitter.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "emitter.h"
+#include "internal.h"
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Initialize an empty emitter.
+ */
+
+void ifj17_emitter_init(ifj17_emitter_t *self) {
+  self->buf = NULL;
+  self->len = 0;
+  self->cap = 0;
+  self->failed = 0;
+}
+
+/*
+ * Make room for `len` more bytes, returning 0 on failure.
+ */
+
+static int reserve(ifj17_emitter_t *self, size_t len) {
+  if (likely(self->cap - self->len >= len)) {
+    return 1;
+  }
+
+  if (self->failed) {
+    return 0;
+  }
+
+  size_t cap = self->cap ? self->cap : IFJ17_EMITTER_SIZE;
+  while (cap - self->len < len) {
+    cap *= 2;
+  }
+
+  char *buf = realloc(self->buf, cap);
+  if (unlikely(!buf)) {
+    self->failed = 1;
+    return 0;
+  }
+
+  self->buf = buf;
+  self->cap = cap;
+  return 1;
+}
+
+/*
+ * Append `len` bytes of `str`.
+ */
+
+void ifj17_emit_bytes(ifj17_emitter_t *self, const char *str, size_t len) {
+  if (reserve(self, len)) {
+    memcpy(self->buf + self->len, str, len);
+    self->len += len;
+  }
+}
+
+/*
+ * Return room for `len` bytes past the output, or NULL on failure.
+ * Whatever the caller writes there is appended by bumping `len`.
+ */
+
+char *ifj17_emit_reserve(ifj17_emitter_t *self, size_t len) {
+  return reserve(self, len) ? self->buf + self->len : NULL;
+}
+
+/*
+ * Append `n` in decimal.
+ */
+
+void ifj17_emit_int(ifj17_emitter_t *self, int n) {
+  char tmp[12], *p = tmp + sizeof(tmp);
+  unsigned int u = n < 0 ? -(unsigned int)n : (unsigned int)n;
+
+  do {
+    *--p = '0' + u % 10;
+  } while (u /= 10);
+
+  if (n < 0) {
+    *--p = '-';
+  }
+
+  ifj17_emit_bytes(self, p, tmp + sizeof(tmp) - p);
+}
+
+/*
+ * Append `n` as printf's "%g" would. Whole numbers printed
+ * without an exponent skip the formatter.
+ */
+
+void ifj17_emit_double(ifj17_emitter_t *self, double n) {
+  char tmp[32];
+
+  if (n > -1e6 && n < 1e6 && n == (int)n && (n != 0 || !signbit(n))) {
+    ifj17_emit_int(self, (int)n);
+    return;
+  }
+
+  int len = snprintf(tmp, sizeof(tmp), "%g", n);
+  ifj17_emit_bytes(self, tmp, len);
+}
+
+/*
+ * Append the int literal `n`, as "int@n".
+ */
+
+void ifj17_emit_int_literal(ifj17_emitter_t *self, int n) {
+  ifj17_emit_str(self, "int@");
+  ifj17_emit_int(self, n);
+}
+
+/*
+ * Append the float literal `n`, as "float@n".
+ */
+
+void ifj17_emit_float_literal(ifj17_emitter_t *self, double n) {
+  ifj17_emit_str(self, "float@");
+  ifj17_emit_double(self, n);
+}
+
+/*
+ * Append the byte `c`, as a "\ddd" escape unless printable
+ * in IFJcode17: whitespace, control characters, '#' and '\'.
+ */
+
+static void emit_char(ifj17_emitter_t *self, unsigned char c) {
+  char tmp[4] = {'\\', '0' + c / 100, '0' + c / 10 % 10, '0' + c % 10};
+
+  if (c <= ' ' || '#' == c || '\\' == c) {
+    ifj17_emit_bytes(self, tmp, sizeof(tmp));
+  } else {
+    ifj17_emit_bytes(self, (char *)&c, 1);
+  }
+}
+
+/*
+ * Append the `len` bytes of source string literal `str` as
+ * "string@str", its escapes \n, \t, \", \\, \ddd and \xhh
+ * resolved. A \ddd past 255, which the lexer rejects, is
+ * clamped to 255.
+ */
+
+void ifj17_emit_string_literal(ifj17_emitter_t *self, const char *str, size_t len) {
+  const unsigned char *s = (const unsigned char *)str, *end = s + len;
+  int c;
+
+  ifj17_emit_str(self, "string@");
+  while (s < end) {
+    if ('\\' == (c = *s++) && s < end) {
+      switch (c = *s++) {
+      case 'n':
+        c = '\n';
+        break;
+      case 't':
+        c = '\t';
+        break;
+      case 'x':
+        c = 0;
+        for (int i = 0; i < 2 && s < end && isxdigit(*s); ++i, ++s) {
+          c = c << 4 | (isdigit(*s) ? *s - '0' : (*s | 0x20) - 'a' + 10);
+        }
+        break;
+      default:
+        if (isdigit(c)) {
+          c -= '0';
+          for (int i = 0; i < 2 && s < end && isdigit(*s); ++i) {
+            c = c * 10 + *s++ - '0';
+          }
+          c = c > 255 ? 255 : c;
+        }
+      }
+    }
+    emit_char(self, c);
+  }
+}
+
+/*
+ * Append the variable `name` of `len` bytes qualified
+ * by `frame`, as "GF@name".
+ */
+
+void ifj17_emit_var(ifj17_emitter_t *self, const char *frame, const char *name,
+                    size_t len) {
+  ifj17_emit_bytes(self, frame, strlen(frame));
+  ifj17_emit_str(self, "@");
+  ifj17_emit_bytes(self, name, len);
+}
+
+/*
+ * Append label `n` of the `prefix` family, as "prefix_n".
+ */
+
+void ifj17_emit_label(ifj17_emitter_t *self, const char *prefix, int n) {
+  ifj17_emit_bytes(self, prefix, strlen(prefix));
+  ifj17_emit_str(self, "_");
+  ifj17_emit_int(self, n);
+}
+
+/*
+ * Write everything emitted to `fd`, in a single write() unless
+ * it is interrupted or partial. Return -1 on failure.
+ */
+
+int ifj17_emitter_write(ifj17_emitter_t *self, int fd) {
+  const char *buf = self->buf;
+  size_t len = self->len;
+
+  if (self->failed) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  while (len) {
+    ssize_t n = write(fd, buf, len);
+    if (n < 0) {
+      if (EINTR == errno)
+        continue;
+      return -1;
+    }
+    buf += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+/*
+ * Copy what fits of the output into the caller's `buf` of
+ * `size` bytes, nul-terminated like snprintf. Return the
+ * output length.
+ */
+
+size_t ifj17_emitter_copy(ifj17_emitter_t *self, char *buf, size_t size) {
+  if (size) {
+    size_t len = self->len < size - 1 ? self->len : size - 1;
+    if (len) {
+      memcpy(buf, self->buf, len);
+    }
+    buf[len] = 0;
+  }
+
+  return self->len;
+}
+
+/*
+ * Free the buffer, leaving the emitter empty.
+ */
+
+void ifj17_emitter_free(ifj17_emitter_t *self) {
+  free(self->buf);
+  ifj17_emitter_init(self);
+}
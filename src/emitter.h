@@ -0,0 +1,67 @@
+//
+// emitter.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_EMITTER_H
+#define IFJ17_EMITTER_H
+
+#include <stddef.h>
+
+// Initial buffer size
+#ifndef IFJ17_EMITTER_SIZE
+#define IFJ17_EMITTER_SIZE (16 * 1024)
+#endif
+
+/*
+ * Output emitter.
+ *
+ * Generated code is appended into one growable buffer and
+ * written out at once. A failed allocation is sticky: further
+ * appends are dropped and writing the buffer out fails.
+ */
+
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t cap;
+  int failed;
+} ifj17_emitter_t;
+
+/*
+ * Append the string literal `lit`, its length known at compile time.
+ */
+
+#define ifj17_emit_str(self, lit) ifj17_emit_bytes(self, lit, sizeof(lit) - 1)
+
+// prototypes
+
+void ifj17_emitter_init(ifj17_emitter_t *self);
+
+void ifj17_emit_bytes(ifj17_emitter_t *self, const char *str, size_t len);
+
+char *ifj17_emit_reserve(ifj17_emitter_t *self, size_t len);
+
+void ifj17_emit_int(ifj17_emitter_t *self, int n);
+
+void ifj17_emit_double(ifj17_emitter_t *self, double n);
+
+void ifj17_emit_int_literal(ifj17_emitter_t *self, int n);
+
+void ifj17_emit_float_literal(ifj17_emitter_t *self, double n);
+
+void ifj17_emit_string_literal(ifj17_emitter_t *self, const char *str, size_t len);
+
+void ifj17_emit_var(ifj17_emitter_t *self, const char *frame, const char *name,
+                    size_t len);
+
+void ifj17_emit_label(ifj17_emitter_t *self, const char *prefix, int n);
+
+int ifj17_emitter_write(ifj17_emitter_t *self, int fd);
+
+size_t ifj17_emitter_copy(ifj17_emitter_t *self, char *buf, size_t size);
+
+void ifj17_emitter_free(ifj17_emitter_t *self);
+
+#endif /* IFJ17_EMITTER_H */
@@ -6,30 +6,70 @@
 //
 
 #include "errors.h"
+#include "internal.h"
+#include <stdio.h>
 
 /*
- * Report syntax or parse error.
+ * Append a diagnostic for the parser's current error to its
+ * list, returning it, or NULL on failure.
  */
 
-void ifj17_report_error(ifj17_parser_t *parser) {
-  char *err, *type = "parse";
-  ifj17_lexer_t *lex = parser->lex;
+ifj17_diagnostic_t *ifj17_diagnose(ifj17_parser_t *parser) {
+  ifj17_arena_t *arena = &parser->state->arena;
+  ifj17_token_t *tok = parser->tok;
+  const char *err, *type = "parse";
 
   // error message
   if (parser->err) {
     err = parser->err;
-    // lexer
-  } else if (lex->error) {
-    err = lex->error;
+    // lexer, carried by the offending token
+  } else if (tok->type == IFJ17_TOKEN_ILLEGAL && tok->value.as_error) {
+    err = tok->value.as_error;
     type = "syntax";
     // generate
   } else {
     char buf[64];
     snprintf(buf, 64, "unexpected token '%s'",
-             ifj17_token_type_string(lex->tok.type));
-    err = buf;
+             ifj17_token_type_string(tok->type));
+    if (unlikely(!(err = ifj17_arena_strdup(arena, buf)))) {
+      return NULL;
+    }
+  }
+
+  ifj17_diagnostic_t *diag = ifj17_arena_alloc(arena, sizeof(ifj17_diagnostic_t));
+  if (unlikely(!diag)) {
+    return NULL;
+  }
+
+  diag->next = NULL;
+  diag->lineno = tok->lineno;
+  diag->type = type;
+  diag->ctx = parser->ctx;
+  diag->msg = err;
+
+  if (parser->last) {
+    parser->last->next = diag;
+  } else {
+    parser->diagnostics = diag;
+  }
+  parser->last = diag;
+  parser->ndiagnostics++;
+
+  return diag;
+}
+
+/*
+ * Report every collected syntax or parse error, or
+ * the current one when none were collected.
+ */
+
+void ifj17_report_error(ifj17_parser_t *parser) {
+  if (!parser->diagnostics) {
+    ifj17_diagnose(parser);
   }
 
-  fprintf(stderr, "ifj17(%s:%d). %s error in %s, %s.\n", lex->filename, lex->lineno,
-          type, parser->ctx, err);
+  for (ifj17_diagnostic_t *diag = parser->diagnostics; diag; diag = diag->next) {
+    fprintf(stderr, "ifj17(%s:%d). %s error in %s, %s.\n", parser->lex->filename,
+            diag->lineno, diag->type, diag->ctx, diag->msg);
+  }
 }
@@ -11,6 +11,8 @@
 
 // prototypes
 
+ifj17_diagnostic_t *ifj17_diagnose(ifj17_parser_t *parser);
+
 void ifj17_report_error(ifj17_parser_t *parser);
 
 #endif /* IFJ17_ERRORS_H */
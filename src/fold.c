@@ -0,0 +1,434 @@
+//
+// fold.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#include "fold.h"
+#include "internal.h"
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Folding state: the constant each local and temporary is
+ * known to hold at the instruction folded, as learned since
+ * instruction `learned`, the locals holding one constant
+ * throughout the function, the assignments to each local,
+ * the reads of each temporary, the instructions found dead
+ * and whether folding is still in the function's `entry`,
+ * before any label or branch.
+ */
+
+typedef struct {
+  ifj17_ir_func_t *func;
+  ifj17_ir_operand_t *locals;
+  ifj17_ir_operand_t *temps;
+  ifj17_ir_operand_t *constants;
+  int *defs;
+  int *reads;
+  char *dead;
+  int learned;
+  int entry;
+} fold_t;
+
+/*
+ * Is `operand` a local or temporary?
+ */
+
+#define variable(operand)                                                           \
+  (IFJ17_IR_LOCAL == (operand).kind || IFJ17_IR_TEMP == (operand).kind)
+
+/*
+ * Int arithmetic, wrapping around on overflow.
+ */
+
+#define wrap(a, op, b) ((int)((unsigned int)(a)op(unsigned int)(b)))
+
+/*
+ * Return the known value of variable `operand`.
+ */
+
+static ifj17_ir_operand_t *known(fold_t *self, ifj17_ir_operand_t *operand) {
+  return IFJ17_IR_LOCAL == operand->kind ? &self->locals[operand->val.index]
+                                         : &self->temps[operand->val.index];
+}
+
+/*
+ * Replace `operand` with the constant it is known to hold.
+ */
+
+static void propagate(fold_t *self, ifj17_ir_operand_t *operand) {
+  if (!variable(*operand)) {
+    return;
+  }
+
+  ifj17_ir_operand_t *value = known(self, operand);
+  if (IFJ17_IR_LOCAL == operand->kind &&
+      IFJ17_IR_NONE != self->constants[operand->val.index].kind) {
+    value = &self->constants[operand->val.index];
+  }
+
+  if (IFJ17_IR_NONE != value->kind) {
+    *operand = *value;
+  }
+}
+
+/*
+ * Can double `n` be written as a literal without losing
+ * precision? Results that can not are left to run time.
+ */
+
+static int exact(double n) {
+  char tmp[32];
+  snprintf(tmp, sizeof(tmp), "%g", n);
+  return isfinite(n) && strtod(tmp, NULL) == n;
+}
+
+/*
+ * Compare constants `a` and `b` into `order`. Return 0 when
+ * they do not compare at compile time: strings with escape
+ * sequences are compared by their value only at run time.
+ */
+
+static int compare(ifj17_ir_operand_t *a, ifj17_ir_operand_t *b, int *order) {
+  if (a->kind != b->kind) {
+    return 0;
+  }
+
+  switch (a->kind) {
+  case IFJ17_IR_INT:
+  case IFJ17_IR_BOOL:
+    *order = (a->val.as_int > b->val.as_int) - (a->val.as_int < b->val.as_int);
+    return 1;
+  case IFJ17_IR_DOUBLE:
+    *order = (a->val.as_double > b->val.as_double) -
+             (a->val.as_double < b->val.as_double);
+    return 1;
+  case IFJ17_IR_STRING: {
+    ifj17_string_t *x = a->val.as_string, *y = b->val.as_string;
+    if (x == y) {
+      *order = 0;
+      return 1;
+    }
+    if (memchr(x->val, '\\', x->len) || memchr(y->val, '\\', y->len)) {
+      return 0;
+    }
+    int len = x->len < y->len ? x->len : y->len;
+    if (!(*order = memcmp(x->val, y->val, len))) {
+      *order = (x->len > y->len) - (x->len < y->len);
+    }
+    return 1;
+  }
+  default:
+    return 0;
+  }
+}
+
+/*
+ * Return string constant `a` followed by `b`, owned by the
+ * function, or NULL on failure. Literals concatenate as
+ * written, escape sequences included.
+ */
+
+static ifj17_string_t *concat(fold_t *self, ifj17_string_t *a, ifj17_string_t *b) {
+  ifj17_string_t *str = malloc(sizeof(ifj17_string_t) + a->len + b->len + 1);
+  if (unlikely(!str)) {
+    return NULL;
+  }
+
+  str->len = a->len + b->len;
+  str->hash = 0;
+  str->ident = 0;
+  memcpy(str->val, a->val, a->len);
+  memcpy(str->val + a->len, b->val, b->len);
+  str->val[str->len] = 0;
+
+  kv_push(ifj17_string_t *, self->func->strings, str);
+  return str;
+}
+
+/*
+ * Evaluate `instr` of constant operands into `value` by the
+ * IFJcode17 semantics. Return 0 when it must run: an operand
+ * is not constant, or the result would trap or lose precision.
+ */
+
+static int evaluate(fold_t *self, ifj17_ir_instr_t *instr,
+                    ifj17_ir_operand_t *value) {
+  ifj17_ir_operand_t *a = &instr->a, *b = &instr->b;
+  double n;
+  int order;
+
+  switch (instr->op) {
+  case IFJ17_IR_ADD:
+  case IFJ17_IR_SUB:
+  case IFJ17_IR_MUL:
+  case IFJ17_IR_DIV:
+    if (IFJ17_IR_INT == a->kind && IFJ17_IR_INT == b->kind) {
+      int x = a->val.as_int, y = b->val.as_int;
+      switch (instr->op) {
+      case IFJ17_IR_ADD:
+        *value = ifj17_ir_int(wrap(x, +, y));
+        return 1;
+      case IFJ17_IR_SUB:
+        *value = ifj17_ir_int(wrap(x, -, y));
+        return 1;
+      case IFJ17_IR_MUL:
+        *value = ifj17_ir_int(wrap(x, *, y));
+        return 1;
+      default:
+        return 0;
+      }
+    }
+    if (IFJ17_IR_DOUBLE != a->kind || IFJ17_IR_DOUBLE != b->kind) {
+      return 0;
+    }
+    switch (instr->op) {
+    case IFJ17_IR_ADD:
+      n = a->val.as_double + b->val.as_double;
+      break;
+    case IFJ17_IR_SUB:
+      n = a->val.as_double - b->val.as_double;
+      break;
+    case IFJ17_IR_MUL:
+      n = a->val.as_double * b->val.as_double;
+      break;
+    default:
+      if (0 == b->val.as_double) {
+        return 0;
+      }
+      n = a->val.as_double / b->val.as_double;
+    }
+    *value = ifj17_ir_double(n);
+    return exact(n);
+  case IFJ17_IR_LT:
+  case IFJ17_IR_GT:
+  case IFJ17_IR_EQ:
+    if (!compare(a, b, &order)) {
+      return 0;
+    }
+    *value = ifj17_ir_bool(IFJ17_IR_LT == instr->op   ? order < 0
+                           : IFJ17_IR_GT == instr->op ? order > 0
+                                                      : order == 0);
+    return 1;
+  case IFJ17_IR_AND:
+  case IFJ17_IR_OR:
+    if (IFJ17_IR_BOOL != a->kind || IFJ17_IR_BOOL != b->kind) {
+      return 0;
+    }
+    *value = ifj17_ir_bool(IFJ17_IR_AND == instr->op
+                               ? a->val.as_int && b->val.as_int
+                               : a->val.as_int || b->val.as_int);
+    return 1;
+  case IFJ17_IR_NOT:
+    if (IFJ17_IR_BOOL != a->kind) {
+      return 0;
+    }
+    *value = ifj17_ir_bool(!a->val.as_int);
+    return 1;
+  case IFJ17_IR_CONCAT:
+    if (IFJ17_IR_STRING != a->kind || IFJ17_IR_STRING != b->kind) {
+      return 0;
+    }
+    *value = ifj17_ir_string(concat(self, a->val.as_string, b->val.as_string));
+    if (unlikely(!value->val.as_string)) {
+      self->func->failed = 1;
+      return 0;
+    }
+    return 1;
+  case IFJ17_IR_INT2FLOAT:
+    if (IFJ17_IR_INT != a->kind) {
+      return 0;
+    }
+    *value = ifj17_ir_double(a->val.as_int);
+    return 1;
+  case IFJ17_IR_FLOAT2R2EINT:
+  case IFJ17_IR_FLOAT2INT:
+    if (IFJ17_IR_DOUBLE != a->kind) {
+      return 0;
+    }
+    n = IFJ17_IR_FLOAT2INT == instr->op ? trunc(a->val.as_double)
+                                        : nearbyint(a->val.as_double);
+    if (!(n >= INT_MIN && n <= INT_MAX)) {
+      return 0;
+    }
+    *value = ifj17_ir_int((int)n);
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/*
+ * Count the assignments to each local, those made
+ * elsewhere included.
+ */
+
+static void count_defs(fold_t *self) {
+  ifj17_ir_func_t *func = self->func;
+
+  memset(self->defs, 0, kv_size(func->locals) * sizeof(int));
+  ifj17_ir_each(func, {
+    if (IFJ17_IR_LOCAL == instr->dst.kind) {
+      self->defs[instr->dst.val.index]++;
+    }
+  });
+
+  // params are assigned by the caller, untyped locals by no dim
+  for (size_t i = 0; i < kv_size(func->locals); ++i) {
+    if ((int)i < func->nparams ||
+        IFJ17_DATATYPE_UNKNOWN == kv_A(func->locals, i).datatype) {
+      self->defs[i]++;
+    }
+  }
+}
+
+/*
+ * Fold the instructions of `block`, carrying on what is known
+ * from the previous block when entered only by falling through.
+ */
+
+static void fold_block(fold_t *self, ifj17_ir_block_t *block) {
+  ifj17_ir_func_t *func = self->func;
+  ifj17_ir_operand_t value;
+  int order;
+
+  // reached by jumps too, nothing is known: forget what the
+  // instructions since the last label taught, not every variable
+  if (-1 != block->label) {
+    for (int i = self->learned; i < block->first; ++i) {
+      ifj17_ir_instr_t *instr = &kv_A(func->code, i);
+      if (variable(instr->dst)) {
+        *known(self, &instr->dst) = ifj17_ir_none();
+      }
+    }
+    self->learned = block->first;
+    self->entry = 0;
+  }
+
+  for (int i = block->first; i < block->first + block->len; ++i) {
+    ifj17_ir_instr_t *instr = &kv_A(func->code, i);
+    propagate(self, &instr->a);
+    propagate(self, &instr->b);
+    if (ifj17_ir_terminator(instr->op)) {
+      self->entry = 0;
+    }
+
+    switch (instr->op) {
+    case IFJ17_IR_JUMPIFEQ:
+    case IFJ17_IR_JUMPIFNEQ:
+      if (compare(&instr->a, &instr->b, &order)) {
+        if ((0 == order) == (IFJ17_IR_JUMPIFEQ == instr->op)) {
+          instr->op = IFJ17_IR_JUMP;
+          instr->a = instr->b = ifj17_ir_none();
+        } else {
+          self->dead[i] = 1;
+        }
+      }
+      continue;
+    case IFJ17_IR_MOVE:
+      break;
+    default:
+      if (evaluate(self, instr, &value)) {
+        instr->op = IFJ17_IR_MOVE;
+        instr->a = value;
+        instr->b = ifj17_ir_none();
+      }
+    }
+
+    if (variable(instr->dst)) {
+      int constant = IFJ17_IR_MOVE == instr->op && ifj17_ir_constant(instr->a);
+      *known(self, &instr->dst) = constant ? instr->a : ifj17_ir_none();
+
+      // a local assigned once before any label or branch holds the
+      // constant at every read, all coming after it; assigned in a
+      // branch, it may be read on a path that skipped the branch
+      if (constant && self->entry && IFJ17_IR_LOCAL == instr->dst.kind &&
+          1 == self->defs[instr->dst.val.index]) {
+        self->constants[instr->dst.val.index] = instr->a;
+        self->dead[i] = 1;
+      }
+    }
+  }
+}
+
+/*
+ * Mark dead the instructions computing temporaries never
+ * read, the last first so a dead chain goes at once.
+ */
+
+static void sweep(fold_t *self) {
+  ifj17_ir_func_t *func = self->func;
+
+#define count(operand, n)                                                           \
+  if (IFJ17_IR_TEMP == (operand).kind)                                              \
+    self->reads[(operand).val.index] += n;
+
+  memset(self->reads, 0, kv_size(func->temps) * sizeof(int));
+  ifj17_ir_each(func, {
+    if (!self->dead[i]) {
+      count(instr->a, 1);
+      count(instr->b, 1);
+    }
+  });
+
+  for (size_t i = kv_size(func->code); i--;) {
+    ifj17_ir_instr_t *instr = &kv_A(func->code, i);
+    if (self->dead[i] || IFJ17_IR_TEMP != instr->dst.kind ||
+        self->reads[instr->dst.val.index] || IFJ17_IR_CALL == instr->op ||
+        IFJ17_IR_READ == instr->op) {
+      continue;
+    }
+
+    self->dead[i] = 1;
+    count(instr->a, -1);
+    count(instr->b, -1);
+  }
+
+#undef count
+}
+
+/*
+ * Fold the constant expressions of `self` and propagate
+ * constants through its locals and temporaries: within a
+ * block and the blocks it falls into, and throughout for
+ * locals assigned a constant once before any label or branch,
+ * e.g. a constant-initialized dim opening the scope.
+ * Conditional jumps on constants become unconditional or
+ * go, as do the computations left unread. Return 0 on failure.
+ */
+
+int ifj17_fold(ifj17_ir_func_t *self) {
+  size_t nlocals = kv_size(self->locals), ntemps = kv_size(self->temps);
+  fold_t fold = {.func = self, .entry = 1};
+  int ok = 0;
+
+  fold.locals = calloc(nlocals + 1, sizeof(ifj17_ir_operand_t));
+  fold.temps = calloc(ntemps + 1, sizeof(ifj17_ir_operand_t));
+  fold.constants = calloc(nlocals + 1, sizeof(ifj17_ir_operand_t));
+  fold.defs = calloc(nlocals + 1, sizeof(int));
+  fold.reads = calloc(ntemps + 1, sizeof(int));
+  fold.dead = calloc(kv_size(self->code) + 1, 1);
+
+  if (likely(fold.locals && fold.temps && fold.constants && fold.defs &&
+             fold.reads && fold.dead)) {
+    count_defs(&fold);
+    for (size_t b = 0; b < kv_size(self->blocks); ++b) {
+      fold_block(&fold, &kv_A(self->blocks, b));
+    }
+    sweep(&fold);
+    ifj17_ir_compact(self, fold.dead);
+    ok = 1;
+  }
+
+  free(fold.locals);
+  free(fold.temps);
+  free(fold.constants);
+  free(fold.defs);
+  free(fold.reads);
+  free(fold.dead);
+  return ok && !self->failed;
+}
@@ -0,0 +1,16 @@
+//
+// fold.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_FOLD_H
+#define IFJ17_FOLD_H
+
+#include "ir.h"
+
+// prototypes
+
+int ifj17_fold(ifj17_ir_func_t *self);
+
+#endif /* IFJ17_FOLD_H */
@@ -6,11 +6,16 @@
 
 #include "codegen.h"
 #include "errors.h"
+#include "fold.h"
 #include "ifj17.h"
 #include "lexer.h"
 #include "linenoise.h"
+#include "lower.h"
 #include "parser.h"
+#include "peephole.h"
 #include "prettyprint.h"
+#include "semantic.h"
+#include "state.h"
 #include "utils.h"
 #include "vm.h"
 #include <errno.h>
@@ -28,6 +33,42 @@ static int ast = 0;
 
 static int tokens = 0;
 
+// --ir
+
+static int ir = 0;
+
+// --stats
+
+static int stats = 0;
+
+// --pipeline
+
+static int pipeline = 0;
+
+// --errors
+
+static int errors = 0;
+
+// --jobs
+
+static int jobs = 1;
+
+// --no-peephole
+
+static int peephole = 1;
+
+// --no-resolve
+
+static int resolve = 1;
+
+// --no-fuse
+
+static int fuse = 1;
+
+// --run
+
+static int run = 0;
+
 /*
  * Output usage information.
  */
@@ -39,6 +80,15 @@ void usage() {
                   "\n"
                   "\n    -A, --ast       output ast to stdout"
                   "\n    -T, --tokens    output tokens to stdout"
+                  "\n    -I, --ir        output intermediate code to stdout"
+                  "\n    -R, --run       run the generated code"
+                  "\n    -S, --stats     output compilation statistics to stderr"
+                  "\n    -P, --pipeline  lex on a separate thread while parsing"
+                  "\n    -E, --errors    report all syntax errors"
+                  "\n    -j, --jobs <n>  generate functions on <n> threads"
+                  "\n    --no-peephole   skip the peephole optimizations"
+                  "\n    --no-resolve    run looking names up on each access"
+                  "\n    --no-fuse       run without superinstructions"
                   "\n    -h, --help      output help information"
                   "\n    -V, --version   output ifj17 version"
                   "\n"
@@ -73,10 +123,12 @@ void repl() {
   while ((line = linenoise("ifj17> "))) {
     if ('\0' != line[0]) {
       // parse the input
+      ifj17_state_t state;
+      ifj17_state_init(&state);
       ifj17_lexer_t lex;
       ifj17_lexer_init(&lex, line, "stdin");
       ifj17_parser_t parser;
-      ifj17_parser_init(&parser, &lex);
+      ifj17_parser_init(&parser, &lex, &state);
       ifj17_block_node_t *root;
 
       // oh noes!
@@ -87,6 +139,7 @@ void repl() {
 
       // print
       ifj17_prettyprint((ifj17_node_t *)root);
+      ifj17_state_free(&state);
       linenoiseHistoryAdd(line);
     }
     free(line);
@@ -115,6 +168,45 @@ const char **parse_args(int *argc, const char **argv) {
       tokens = 1;
       --*argc;
       ++argv;
+    } else if (!strcmp("-I", arg) || !strcmp("--ir", arg)) {
+      ir = 1;
+      --*argc;
+      ++argv;
+    } else if (!strcmp("-R", arg) || !strcmp("--run", arg)) {
+      run = 1;
+      --*argc;
+      ++argv;
+    } else if (!strcmp("-S", arg) || !strcmp("--stats", arg)) {
+      stats = 1;
+      --*argc;
+      ++argv;
+    } else if (!strcmp("-E", arg) || !strcmp("--errors", arg)) {
+      errors = 1;
+      --*argc;
+      ++argv;
+    } else if (!strcmp("-P", arg) || !strcmp("--pipeline", arg)) {
+      pipeline = 1;
+      --*argc;
+      ++argv;
+    } else if (!strcmp("--no-peephole", arg)) {
+      peephole = 0;
+      --*argc;
+      ++argv;
+    } else if (!strcmp("--no-resolve", arg)) {
+      resolve = 0;
+      --*argc;
+      ++argv;
+    } else if (!strcmp("--no-fuse", arg)) {
+      fuse = 0;
+      --*argc;
+      ++argv;
+    } else if (!strcmp("-j", arg) || !strcmp("--jobs", arg)) {
+      if (i + 1 == len || (jobs = atoi(args[++i])) < 1) {
+        fprintf(stderr, "%s requires a thread count\n", arg);
+        exit(1);
+      }
+      *argc -= 2;
+      argv += 2;
     } else if ('-' == arg[0]) {
       fprintf(stderr, "unknown flag %s\n", arg);
       exit(1);
@@ -125,46 +217,165 @@ const char **parse_args(int *argc, const char **argv) {
 }
 
 /*
- * Evaluate `source` with the given
+ * Evaluate the `len` bytes of `source` with the given
  * `path` name and return status.
  */
 
-int eval(char *source, const char *path) {
+int eval(const char *source, size_t len, const char *path) {
+  // the lexer stops at the first nul, refuse the rest unread
+  const char *nul = memchr(source, 0, len);
+  if (nul) {
+    int lineno = 1;
+    for (const char *c = source; c < nul; ++c) {
+      lineno += '\n' == *c;
+    }
+    fprintf(stderr, "ifj17(%s:%d). syntax error in source, nul character.\n", path,
+            lineno);
+    return 1;
+  }
+
   // parse the input
+  ifj17_state_t state;
+  ifj17_state_init(&state);
   ifj17_lexer_t lex;
   ifj17_lexer_init(&lex, source, path);
   ifj17_parser_t parser;
-  ifj17_parser_init(&parser, &lex);
+  ifj17_parser_init(&parser, &lex, &state);
   ifj17_block_node_t *root;
 
+  // --errors
+  parser.recover = errors;
+
   // --tokens
   if (tokens) {
-    while (ifj17_scan(&lex)) {
-      printf("  \e[90m%d : \e[m", lex.lineno);
-      ifj17_token_inspect(&lex.tok);
+    size_t len;
+    ifj17_token_t *toks = ifj17_lex_all(&lex, &len);
+    for (size_t i = 0; toks && i + 1 < len; ++i) {
+      printf("  \e[90m%d : \e[m", toks[i].lineno);
+      ifj17_token_inspect(&toks[i], lex.source);
     }
+    free(toks);
+    ifj17_state_free(&state);
     return 0;
   }
 
+  // --pipeline
+  ifj17_pipeline_t *pipe = NULL;
+  if (pipeline && (pipe = malloc(sizeof(ifj17_pipeline_t)))) {
+    if (ifj17_pipeline_start(pipe, &lex)) {
+      parser.pipeline = pipe;
+    } else {
+      free(pipe);
+      pipe = NULL;
+    }
+  }
+
+  root = ifj17_parse(&parser);
+
+  if (pipe) {
+    ifj17_pipeline_stop(pipe);
+    if (stats) {
+      ifj17_pipeline_inspect(pipe);
+    }
+    free(pipe);
+  }
+
   // oh noes!
-  if (!(root = ifj17_parse(&parser))) {
+  if (!root) {
     ifj17_report_error(&parser);
+    ifj17_state_free(&state);
     return 1;
   }
 
-  // --ast
-  ifj17_set_prettyprint_func(printf);
-  ifj17_prettyprint((ifj17_node_t *)root);
+  // --ast, stdout being the program's when running
+  if (ast || !run) {
+    ifj17_set_prettyprint_func(printf);
+    ifj17_prettyprint((ifj17_node_t *)root);
+  }
+
+  // analyze
+  ifj17_semantic_t sem;
+  ifj17_semantic_init(&sem, &state);
+  if (!ifj17_analyze(&sem, (ifj17_node_t *)root)) {
+    ifj17_semantic_report(&sem, path);
+    ifj17_state_free(&state);
+    return sem.error;
+  }
+
+  // --ir
+  if (ir) {
+    ifj17_ir_t program;
+    ifj17_emitter_t out;
+    int hits[IFJ17_PEEPHOLE_RULES] = {0};
+    ifj17_emitter_init(&out);
+    if (!ifj17_lower(&program, (ifj17_node_t *)root)) {
+      out.failed = 1;
+    }
+    for (size_t i = 0; i < kv_size(program.funcs); ++i) {
+      ifj17_ir_func_t *func = kv_A(program.funcs, i);
+      out.failed |= !ifj17_fold(func);
+      out.failed |= peephole && !ifj17_peephole(func, hits);
+    }
+    ifj17_ir_dump(&program, &out);
+    if (ifj17_emitter_write(&out, STDOUT_FILENO) < 0) {
+      perror("write");
+    }
+    if (stats && peephole) {
+      ifj17_peephole_inspect(hits);
+    }
+    ifj17_emitter_free(&out);
+    ifj17_ir_free(&program);
+    ifj17_state_free(&state);
+    return 0;
+  }
 
   // evaluate
-  ifj17_vm_t *vm = ifj17_gen((ifj17_node_t *)root);
-  // ifj17_object_t *obj = ifj17_eval(vm);
-  // ifj17_object_inspect(obj);
-  //
-  // ifj17_object_free(obj);
-  ifj17_vm_free(vm);
-
-  return 0;
+
+  int status = 0;
+  ifj17_codegen_ctx_t context;
+  ifj17_codegen_ctx_init(&context);
+  context.jobs = jobs;
+  context.peephole = peephole;
+
+  // --run
+  if (run) {
+    ifj17_vm_t vm;
+    ifj17_vm_profile_t profile = {{0}};
+    ifj17_vm_init(&vm);
+    vm.resolve = resolve;
+    vm.fuse = fuse;
+    vm.profile = stats ? &profile : NULL;
+    if (!ifj17_codegen(&context, (ifj17_node_t *)root)) {
+      vm.error = IFJ17_VM_INTERNAL;
+      vm.msg = "out of memory";
+    } else if (ifj17_vm_load(&vm, context.out.buf, context.out.len)) {
+      ifj17_eval(&vm);
+    }
+    if ((status = vm.error)) {
+      ifj17_vm_report(&vm, path);
+    }
+    if (stats) {
+      ifj17_vm_inspect(&vm);
+    }
+    ifj17_vm_free(&vm);
+  } else {
+    ifj17_gen(&context, (ifj17_node_t *)root);
+  }
+
+  // --stats
+  if (stats) {
+    ifj17_state_inspect(&state);
+    ifj17_arena_inspect(&state.arena);
+    if (peephole) {
+      ifj17_peephole_inspect(context.hits);
+    }
+  }
+  ifj17_codegen_ctx_free(&context);
+
+  // release the ast
+  ifj17_state_free(&state);
+
+  return status;
 }
 
 /*
@@ -172,17 +383,24 @@ int eval(char *source, const char *path) {
  */
 
 int main(int argc, const char **argv) {
-  int tried_ext = 0;
+  int status, tried_ext = 0;
   const char *path, *orig;
-  char *source;
+  ifj17_source_t source;
 
   // parse arguments
   argv = parse_args(&argc, argv);
 
   // eval stdin
   if (argc == 1 && isatty(0) == false) {
-    source = read_until_eof(stdin);
-    return eval(source, "stdin");
+    size_t len;
+    char *input = read_until_eof(stdin, &len);
+    if (!input) {
+      perror("stdin");
+      exit(1);
+    }
+    status = eval(input, len, "stdin");
+    free(input);
+    return status;
   }
 
   // REPL
@@ -192,7 +410,7 @@ int main(int argc, const char **argv) {
   // eval file
   orig = path = argv[1];
 read:
-  if (!(source = file_read(path))) {
+  if (!ifj17_source_open(&source, path)) {
     // try with .ifj17 extension
     if (!tried_ext) {
       tried_ext = 1;
@@ -205,5 +423,7 @@ read:
     exit(1);
   }
 
-  return eval(source, path);
+  status = eval(source.data, source.len, path);
+  ifj17_source_close(&source);
+  return status;
 }
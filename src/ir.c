@@ -0,0 +1,352 @@
+//
+// ir.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#include "ir.h"
+#include "internal.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * IR opcode strings.
+ */
+
+const char *ifj17_ir_op_strings[] = {
+#define o(op, str) str,
+    IFJ17_IR_OP_LIST
+#undef o
+};
+
+/*
+ * IR opcode names, as dumped.
+ */
+
+static const char *op_names[] = {
+#define o(op, str) #op,
+    IFJ17_IR_OP_LIST
+#undef o
+};
+
+/*
+ * Datatype names, as dumped.
+ */
+
+static const char *datatype_names[] = {"unknown", "integer", "double", "string",
+                                       "boolean"};
+
+/*
+ * Push an uninitialized element onto vector `v` of `func`,
+ * returning it, or NULL when growing it failed.
+ */
+
+#define push(func, type, v)                                                         \
+  ((v).n < (v).m || grow((void **)&(v).a, &(v).m, sizeof(type))                     \
+       ? &(v).a[(v).n++]                                                            \
+       : ((func)->failed = 1, (type *)NULL))
+
+/*
+ * Double the capacity `*m` of the array `*a` of `size` byte
+ * elements. Return 0 on failure.
+ */
+
+static int grow(void **a, size_t *m, size_t size) {
+  size_t cap = *m ? *m * 2 : 16;
+  void *buf = realloc(*a, cap * size);
+  if (unlikely(!buf)) {
+    return 0;
+  }
+
+  *a = buf;
+  *m = cap;
+  return 1;
+}
+
+/*
+ * Initialize an empty function, the main scope without a `name`.
+ */
+
+void ifj17_ir_func_init(ifj17_ir_func_t *self, ifj17_string_t *name) {
+  self->name = name;
+  self->datatype = IFJ17_DATATYPE_UNKNOWN;
+  self->nparams = 0;
+  kv_init(self->locals);
+  kv_init(self->temps);
+  kv_init(self->labels);
+  kv_init(self->blocks);
+  kv_init(self->code);
+  kv_init(self->strings);
+  self->failed = 0;
+}
+
+/*
+ * Free the arrays and strings of the function.
+ */
+
+void ifj17_ir_func_free(ifj17_ir_func_t *self) {
+  kv_destroy(self->locals);
+  kv_destroy(self->temps);
+  kv_destroy(self->labels);
+  kv_destroy(self->blocks);
+  kv_destroy(self->code);
+  for (size_t i = 0; i < kv_size(self->strings); ++i) {
+    free(kv_A(self->strings, i));
+  }
+  kv_destroy(self->strings);
+}
+
+/*
+ * Return a new temporary of `datatype`.
+ */
+
+ifj17_ir_operand_t ifj17_ir_temp(ifj17_ir_func_t *self, ifj17_datatype datatype) {
+  unsigned char *temp = push(self, unsigned char, self->temps);
+  if (temp) {
+    *temp = datatype;
+  }
+
+  return ifj17_ir_operand(IFJ17_IR_TEMP, datatype, index, kv_size(self->temps) - 1);
+}
+
+/*
+ * Return a new label of the `prefix` family, placed later.
+ */
+
+int ifj17_ir_label(ifj17_ir_func_t *self, const char *prefix) {
+  const char **label = push(self, const char *, self->labels);
+  if (label) {
+    *label = prefix;
+  }
+
+  return kv_size(self->labels) - 1;
+}
+
+/*
+ * Start a block at `label`, or -1 for a block entered only
+ * by falling through.
+ */
+
+void ifj17_ir_place(ifj17_ir_func_t *self, int label) {
+  ifj17_ir_block_t *block;
+  size_t n = kv_size(self->blocks);
+
+  // name the empty block just started
+  if (n && !kv_A(self->blocks, n - 1).len && -1 == kv_A(self->blocks, n - 1).label) {
+    kv_A(self->blocks, n - 1).label = label;
+    return;
+  }
+
+  if ((block = push(self, ifj17_ir_block_t, self->blocks))) {
+    block->label = label;
+    block->first = kv_size(self->code);
+    block->len = 0;
+  }
+}
+
+/*
+ * Append instruction `op`, starting a block after a jump.
+ */
+
+void ifj17_ir_emit(ifj17_ir_func_t *self, ifj17_ir_op op, ifj17_ir_operand_t dst,
+                   ifj17_ir_operand_t a, ifj17_ir_operand_t b) {
+  size_t n = kv_size(self->blocks);
+  if (!n || (kv_A(self->blocks, n - 1).len &&
+             ifj17_ir_terminator(kv_A(self->code, kv_size(self->code) - 1).op))) {
+    ifj17_ir_place(self, -1);
+    if (unlikely(self->failed)) {
+      return;
+    }
+    n = kv_size(self->blocks);
+  }
+
+  ifj17_ir_instr_t *instr = push(self, ifj17_ir_instr_t, self->code);
+  if (unlikely(!instr)) {
+    return;
+  }
+
+  instr->op = op;
+  instr->dst = dst;
+  instr->a = a;
+  instr->b = b;
+  kv_A(self->blocks, n - 1).len++;
+}
+
+/*
+ * Can control fall off the end of the code emitted so far?
+ */
+
+int ifj17_ir_falls_through(ifj17_ir_func_t *self) {
+  size_t n = kv_size(self->code);
+  if (!n || !kv_A(self->blocks, kv_size(self->blocks) - 1).len) {
+    return 1;
+  }
+
+  ifj17_ir_op op = kv_A(self->code, n - 1).op;
+  return IFJ17_IR_JUMP != op && IFJ17_IR_RETURN != op;
+}
+
+/*
+ * Drop the instructions marked `dead`, closing up the blocks.
+ */
+
+void ifj17_ir_compact(ifj17_ir_func_t *self, const char *dead) {
+  int n = 0;
+
+  for (size_t b = 0; b < kv_size(self->blocks); ++b) {
+    ifj17_ir_block_t *block = &kv_A(self->blocks, b);
+    int first = n;
+
+    for (int i = block->first; i < block->first + block->len; ++i) {
+      if (!dead[i]) {
+        kv_A(self->code, n++) = kv_A(self->code, i);
+      }
+    }
+
+    block->first = first;
+    block->len = n - first;
+  }
+
+  kv_size(self->code) = n;
+}
+
+/*
+ * Initialize an empty program.
+ */
+
+void ifj17_ir_init(ifj17_ir_t *self) { kv_init(self->funcs); }
+
+/*
+ * Free the program and its functions.
+ */
+
+void ifj17_ir_free(ifj17_ir_t *self) {
+  for (size_t i = 0; i < kv_size(self->funcs); ++i) {
+    ifj17_ir_func_free(kv_A(self->funcs, i));
+    free(kv_A(self->funcs, i));
+  }
+  kv_destroy(self->funcs);
+}
+
+/*
+ * Dump `operand` of `func`.
+ */
+
+static void dump_operand(ifj17_ir_func_t *func, ifj17_ir_operand_t *operand,
+                         ifj17_emitter_t *out) {
+  ifj17_string_t *str;
+  int n;
+
+  switch (operand->kind) {
+  case IFJ17_IR_LOCAL:
+    str = kv_A(func->locals, operand->val.index).name;
+    ifj17_emit_bytes(out, str->val, str->len);
+    break;
+  case IFJ17_IR_TEMP:
+    ifj17_emit_str(out, "%");
+    ifj17_emit_int(out, operand->val.index);
+    break;
+  case IFJ17_IR_INT:
+    ifj17_emit_int(out, operand->val.as_int);
+    break;
+  case IFJ17_IR_DOUBLE:
+    ifj17_emit_double(out, operand->val.as_double);
+    break;
+  case IFJ17_IR_STRING:
+    str = operand->val.as_string;
+    ifj17_emit_str(out, "!\"");
+    ifj17_emit_bytes(out, str->val, str->len);
+    ifj17_emit_str(out, "\"");
+    break;
+  case IFJ17_IR_BOOL:
+    operand->val.as_int ? ifj17_emit_str(out, "true") : ifj17_emit_str(out, "false");
+    break;
+  case IFJ17_IR_LABEL:
+    n = operand->val.index;
+    ifj17_emit_label(out, kv_A(func->labels, n), n);
+    break;
+  case IFJ17_IR_FUNC:
+    str = operand->val.as_string;
+    ifj17_emit_bytes(out, str->val, str->len);
+    break;
+  case IFJ17_IR_TYPE:
+    ifj17_emit_bytes(out, datatype_names[operand->datatype],
+                     strlen(datatype_names[operand->datatype]));
+    break;
+  }
+}
+
+/*
+ * Dump `func` as text into `out`, a block per label.
+ */
+
+void ifj17_ir_dump_func(ifj17_ir_func_t *self, ifj17_emitter_t *out) {
+  if (self->name) {
+    ifj17_emit_str(out, "function ");
+    ifj17_emit_bytes(out, self->name->val, self->name->len);
+  } else {
+    ifj17_emit_str(out, "scope");
+  }
+  ifj17_emit_str(out, "\n");
+
+  for (size_t i = 0; i < kv_size(self->locals); ++i) {
+    ifj17_ir_local_t *local = &kv_A(self->locals, i);
+    if ((int)i < self->nparams) {
+      ifj17_emit_str(out, "  param ");
+    } else {
+      ifj17_emit_str(out, "  local ");
+    }
+    ifj17_emit_bytes(out, local->name->val, local->name->len);
+    ifj17_emit_str(out, " ");
+    ifj17_emit_bytes(out, datatype_names[local->datatype],
+                     strlen(datatype_names[local->datatype]));
+    ifj17_emit_str(out, "\n");
+  }
+
+  for (size_t b = 0; b < kv_size(self->blocks); ++b) {
+    ifj17_ir_block_t *block = &kv_A(self->blocks, b);
+    if (-1 == block->label) {
+      ifj17_emit_str(out, "-:\n");
+    } else {
+      ifj17_emit_label(out, kv_A(self->labels, block->label), block->label);
+      ifj17_emit_str(out, ":\n");
+    }
+
+    for (int i = block->first; i < block->first + block->len; ++i) {
+      ifj17_ir_instr_t *instr = &kv_A(self->code, i);
+      ifj17_emit_str(out, "  ");
+      if (IFJ17_IR_NONE != instr->dst.kind && IFJ17_IR_LABEL != instr->dst.kind) {
+        dump_operand(self, &instr->dst, out);
+        ifj17_emit_str(out, " = ");
+      }
+
+      ifj17_emit_bytes(out, op_names[instr->op], strlen(op_names[instr->op]));
+      if (IFJ17_IR_LABEL == instr->dst.kind) {
+        ifj17_emit_str(out, " ");
+        dump_operand(self, &instr->dst, out);
+      }
+      if (IFJ17_IR_NONE != instr->a.kind) {
+        ifj17_emit_str(out, " ");
+        dump_operand(self, &instr->a, out);
+      }
+      if (IFJ17_IR_NONE != instr->b.kind) {
+        ifj17_emit_str(out, ", ");
+        dump_operand(self, &instr->b, out);
+      }
+      ifj17_emit_str(out, "\n");
+    }
+  }
+}
+
+/*
+ * Dump the program as text into `out`.
+ */
+
+void ifj17_ir_dump(ifj17_ir_t *self, ifj17_emitter_t *out) {
+  for (size_t i = 0; i < kv_size(self->funcs); ++i) {
+    if (i) {
+      ifj17_emit_str(out, "\n");
+    }
+    ifj17_ir_dump_func(kv_A(self->funcs, i), out);
+  }
+}
@@ -0,0 +1,219 @@
+//
+// ir.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_IR_H
+#define IFJ17_IR_H
+
+#include "ast.h"
+#include "emitter.h"
+#include "kvec.h"
+
+/*
+ * IR opcodes, with the IFJcode17 instruction each one is
+ * printed as. ARG pushes a call argument; CALL pops the
+ * result into its destination.
+ */
+
+#define IFJ17_IR_OP_LIST                                                            \
+  o(MOVE, "MOVE") o(ADD, "ADD") o(SUB, "SUB") o(MUL, "MUL") o(DIV, "DIV")           \
+      o(LT, "LT") o(GT, "GT") o(EQ, "EQ") o(AND, "AND") o(OR, "OR") o(NOT, "NOT")   \
+          o(CONCAT, "CONCAT") o(INT2FLOAT, "INT2FLOAT")                             \
+              o(FLOAT2R2EINT, "FLOAT2R2EINT") o(FLOAT2INT, "FLOAT2INT")             \
+                  o(READ, "READ") o(WRITE, "WRITE")                                 \
+                      o(ARG, "PUSHS") o(CALL, "CALL") o(RETURN, "RETURN")           \
+                          o(JUMP, "JUMP") o(JUMPIFEQ, "JUMPIFEQ")                   \
+                              o(JUMPIFNEQ, "JUMPIFNEQ")
+
+/*
+ * IR opcodes enum.
+ */
+
+typedef enum {
+#define o(op, str) IFJ17_IR_##op,
+  IFJ17_IR_OP_LIST
+#undef o
+} ifj17_ir_op;
+
+/*
+ * IR opcode strings.
+ */
+
+extern const char *ifj17_ir_op_strings[];
+
+/*
+ * IR operand kinds.
+ */
+
+typedef enum {
+  IFJ17_IR_NONE,
+  IFJ17_IR_LOCAL,
+  IFJ17_IR_TEMP,
+  IFJ17_IR_INT,
+  IFJ17_IR_DOUBLE,
+  IFJ17_IR_STRING,
+  IFJ17_IR_BOOL,
+  IFJ17_IR_LABEL,
+  IFJ17_IR_FUNC,
+  IFJ17_IR_TYPE,
+} ifj17_ir_kind;
+
+/*
+ * IR operand: a local by slot, a temporary, a constant, a
+ * label, a called function or the type READ converts to.
+ * Strings hold the interned literal as written.
+ */
+
+typedef struct {
+  unsigned char kind;
+  unsigned char datatype;
+  union {
+    int index;
+    int as_int;
+    double as_double;
+    ifj17_string_t *as_string;
+  } val;
+} ifj17_ir_operand_t;
+
+/*
+ * Operand constructors.
+ */
+
+#define ifj17_ir_operand(k, type, field, v)                                         \
+  ((ifj17_ir_operand_t){.kind = (k), .datatype = (type), .val.field = (v)})
+
+#define ifj17_ir_none()                                                             \
+  ifj17_ir_operand(IFJ17_IR_NONE, IFJ17_DATATYPE_UNKNOWN, index, 0)
+
+#define ifj17_ir_int(n)                                                             \
+  ifj17_ir_operand(IFJ17_IR_INT, IFJ17_DATATYPE_INTEGER, as_int, n)
+
+#define ifj17_ir_double(n)                                                          \
+  ifj17_ir_operand(IFJ17_IR_DOUBLE, IFJ17_DATATYPE_DOUBLE, as_double, n)
+
+#define ifj17_ir_string(str)                                                        \
+  ifj17_ir_operand(IFJ17_IR_STRING, IFJ17_DATATYPE_STRING, as_string, str)
+
+#define ifj17_ir_bool(b)                                                            \
+  ifj17_ir_operand(IFJ17_IR_BOOL, IFJ17_DATATYPE_BOOLEAN, as_int, b)
+
+#define ifj17_ir_label_operand(n)                                                   \
+  ifj17_ir_operand(IFJ17_IR_LABEL, IFJ17_DATATYPE_UNKNOWN, index, n)
+
+/*
+ * Is `operand` a constant?
+ */
+
+#define ifj17_ir_constant(operand)                                                  \
+  ((operand).kind >= IFJ17_IR_INT && (operand).kind <= IFJ17_IR_BOOL)
+
+/*
+ * Does `op` end a basic block?
+ */
+
+#define ifj17_ir_terminator(op)                                                     \
+  (IFJ17_IR_JUMP == (op) || IFJ17_IR_JUMPIFEQ == (op) ||                           \
+   IFJ17_IR_JUMPIFNEQ == (op) || IFJ17_IR_RETURN == (op))
+
+/*
+ * IR instruction, `dst` = `a` op `b`.
+ */
+
+typedef struct {
+  ifj17_ir_op op;
+  ifj17_ir_operand_t dst;
+  ifj17_ir_operand_t a;
+  ifj17_ir_operand_t b;
+} ifj17_ir_instr_t;
+
+/*
+ * Basic block, `len` instructions from `first`, entered
+ * at its `label` or by falling through from the previous
+ * block. Only the last instruction may jump.
+ */
+
+typedef struct {
+  int label;
+  int first;
+  int len;
+} ifj17_ir_block_t;
+
+/*
+ * Local variable, params first.
+ */
+
+typedef struct {
+  ifj17_string_t *name;
+  ifj17_datatype datatype;
+} ifj17_ir_local_t;
+
+/*
+ * IR function, lowered from a function or the main scope
+ * (without a `name`). Locals, temporaries, labels, blocks
+ * and code are flat arrays, indexed by the operands. String
+ * constants made by the passes are owned by `strings`.
+ */
+
+typedef struct {
+  ifj17_string_t *name;
+  ifj17_datatype datatype;
+  int nparams;
+  kvec_t(ifj17_ir_local_t) locals;
+  kvec_t(unsigned char) temps;
+  kvec_t(const char *) labels;
+  kvec_t(ifj17_ir_block_t) blocks;
+  kvec_t(ifj17_ir_instr_t) code;
+  kvec_t(ifj17_string_t *) strings;
+  int failed;
+} ifj17_ir_func_t;
+
+/*
+ * IR program, its functions and main scope in source order.
+ */
+
+typedef struct {
+  kvec_t(ifj17_ir_func_t *) funcs;
+} ifj17_ir_t;
+
+/*
+ * Iterate the instructions of `func`, populating `i` and `instr`.
+ */
+
+#define ifj17_ir_each(func, block)                                                  \
+  {                                                                                 \
+    for (size_t i = 0; i < kv_size((func)->code); ++i) {                            \
+      ifj17_ir_instr_t *instr = &kv_A((func)->code, i);                             \
+      block;                                                                        \
+    }                                                                               \
+  }
+
+// prototypes
+
+void ifj17_ir_func_init(ifj17_ir_func_t *self, ifj17_string_t *name);
+
+void ifj17_ir_func_free(ifj17_ir_func_t *self);
+
+ifj17_ir_operand_t ifj17_ir_temp(ifj17_ir_func_t *self, ifj17_datatype datatype);
+
+int ifj17_ir_label(ifj17_ir_func_t *self, const char *prefix);
+
+void ifj17_ir_place(ifj17_ir_func_t *self, int label);
+
+void ifj17_ir_emit(ifj17_ir_func_t *self, ifj17_ir_op op, ifj17_ir_operand_t dst,
+                   ifj17_ir_operand_t a, ifj17_ir_operand_t b);
+
+int ifj17_ir_falls_through(ifj17_ir_func_t *self);
+
+void ifj17_ir_compact(ifj17_ir_func_t *self, const char *dead);
+
+void ifj17_ir_init(ifj17_ir_t *self);
+
+void ifj17_ir_free(ifj17_ir_t *self);
+
+void ifj17_ir_dump_func(ifj17_ir_func_t *self, ifj17_emitter_t *out);
+
+void ifj17_ir_dump(ifj17_ir_t *self, ifj17_emitter_t *out);
+
+#endif /* IFJ17_IR_H */
@@ -5,6 +5,7 @@
 //
 
 #include "lexer.h"
+#include "internal.h"
 #include <ctype.h>
 #include <math.h>
 #include <stdio.h>
@@ -24,10 +25,18 @@
 #endif
 
 /*
- * Undo the previous char.
+ * Undo the previous char. The source is never written to,
+ * so it may be a read-only mapping.
  */
 
-#define undo (self->source[--self->offset] = self->stash)
+#define undo (--self->offset)
+
+/*
+ * Advance past the run matched by fast path `fn`.
+ */
+
+#define span(fn)                                                                    \
+  (self->offset = self->simd->fn(self->source + self->offset) - self->source)
 
 /*
  * Assign token `t`.
@@ -45,7 +54,8 @@
  * Set error `msg` and assign ILLEGAL token.
  */
 
-#define error(msg) (self->error = msg, token(ILLEGAL))
+#define error(msg)                                                                  \
+  (self->error = msg, self->tok.value.as_error = msg, token(ILLEGAL))
 
 /*
  * True if the lexer should insert a semicolon after `t`.
@@ -59,10 +69,12 @@
  * Initialize lexer with the given `source` and `filename`.
  */
 
-void ifj17_lexer_init(ifj17_lexer_t *self, char *source, const char *filename) {
+void ifj17_lexer_init(ifj17_lexer_t *self, const char *source,
+                      const char *filename) {
   self->error = NULL;
   self->source = source;
   self->filename = filename;
+  self->simd = ifj17_simd_best();
   self->lineno = 1;
   self->offset = 0;
 }
@@ -83,89 +95,82 @@ static int hex(const char c) {
 }
 
 /*
- * Scan identifier.
+ * Keyword slot for a case-folded keyword of `len` bytes starting
+ * with `first` and ending with `last`. Collision-free over the
+ * IFJ17 keywords, see the table below.
+ */
+
+#define keyword_slot(len, first, last)                                              \
+  (((len) ^ ((first) | 0x20) << 2 ^ ((last) | 0x20) << 3) & 63)
+
+#define keyword(tok, name, first, last)                                             \
+  [keyword_slot(sizeof(name) - 1, first, last)] = {name, sizeof(name) - 1,          \
+                                                   IFJ17_TOKEN_##tok}
+
+/*
+ * Keyword table indexed by keyword_slot().
+ */
+
+static const struct {
+  const char *name;
+  int len;
+  ifj17_token type;
+} keywords[64] = {
+    keyword(IF, "if", 'i', 'f'),
+    keyword(OP_BIT_OR, "or", 'o', 'r'),
+    keyword(AS, "as", 'a', 's'),
+    keyword(DO, "do", 'd', 'o'),
+    keyword(FOR, "for", 'f', 'r'),
+    keyword(END, "end", 'e', 'd'),
+    keyword(DIM, "dim", 'd', 'm'),
+    keyword(OP_BIT_AND, "and", 'a', 'd'),
+    keyword(OP_LNOT, "not", 'n', 't'),
+    keyword(ELSE, "else", 'e', 'e'),
+    keyword(TYPE, "type", 't', 'e'),
+    keyword(THEN, "then", 't', 'n'),
+    keyword(LOOP, "loop", 'l', 'p'),
+    keyword(WHILE, "while", 'w', 'e'),
+    keyword(SCOPE, "scope", 's', 'e'),
+    keyword(PRINT, "print", 'p', 't'),
+    keyword(INPUT, "input", 'i', 't'),
+    keyword(ELSEIF, "elseif", 'e', 'f'),
+    keyword(RETURN, "return", 'r', 'n'),
+    keyword(DECLARE, "declare", 'd', 'e'),
+    keyword(FUNCTION, "function", 'f', 'n'),
+};
+
+/*
+ * Scan identifier, leaving its name as a slice of the source.
+ * Keywords are case insensitive and matched in place by
+ * folding each byte with 0x20, which leaves digits and
+ * underscores unable to match a keyword letter.
  */
 
 static int scan_ident(ifj17_lexer_t *self, int c) {
-  int len = 0;
-  char buf[128]; // TODO: ditch these buffers
+  const char *str = self->source + self->offset - 1;
   token(ID);
+  self->tok.offset = self->offset - 1;
 
-  do {
-    buf[len++] = c;
-  } while (isalpha(c = next) || isdigit(c) || '_' == c);
-  undo;
+  // names are mostly short, only long runs go to the fast path
+  int n = IFJ17_KEYWORD_MAX;
+  while ((isalpha(c = next) || isdigit(c) || '_' == c) && --n)
+    ;
+  n ? undo : span(ident);
 
-  // transform all keywords to the lower case
-  for (unsigned int i = 0; buf[i]; i++) {
-    buf[i] = tolower(buf[i]);
-  }
+  int len = self->tok.len = self->offset - self->tok.offset;
+  if (len < 2 || len > IFJ17_KEYWORD_MAX)
+    return 1;
 
-  buf[len++] = 0;
-  switch (len - 1) {
-  case 2:
-    if (strcmp("if", buf) == 0)
-      return token(IF);
-    if (strcmp("or", buf) == 0)
-      return token(OP_BIT_OR);
-    if (strcmp("as", buf) == 0)
-      return token(AS);
-    if (strcmp("do", buf) == 0)
-      return token(DO);
-    break;
-  case 3:
-    if (strcmp("for", buf) == 0)
-      return token(FOR);
-    if (strcmp("end", buf) == 0)
-      return token(END);
-    if (strcmp("dim", buf) == 0)
-      return token(DIM);
-    if (strcmp("and", buf) == 0)
-      return token(OP_BIT_AND);
-    if (strcmp("not", buf) == 0)
-      return token(OP_LNOT);
-    break;
-  case 4:
-    if (strcmp("else", buf) == 0)
-      return token(ELSE);
-    if (strcmp("type", buf) == 0)
-      return token(TYPE);
-    if (strcmp("then", buf) == 0)
-      return token(THEN);
-    if (strcmp("loop", buf) == 0)
-      return token(LOOP);
-    break;
-  case 5:
-    if (strcmp("while", buf) == 0)
-      return token(WHILE);
-    if (strcmp("scope", buf) == 0)
-      return token(SCOPE);
-    if (strcmp("print", buf) == 0)
-      return token(PRINT);
-    if (strcmp("input", buf) == 0)
-      return token(INPUT);
-    break;
-  case 6:
-    if (strcmp("elseif", buf) == 0)
-      return token(ELSEIF);
-    if (strcmp("return", buf) == 0)
-      return token(RETURN);
-    break;
-  case 7:
-    if (strcmp("declare", buf) == 0)
-      return token(DECLARE);
-    break;
-  case 8:
-    if (strcmp("function", buf) == 0)
-      return token(FUNCTION);
-    break;
-  default:
-    if (strcmp("return", buf) == 0)
-      return token(RETURN);
+  int i = keyword_slot(len, str[0], str[len - 1]);
+  if (keywords[i].len != len)
+    return 1;
+
+  for (const char *kw = keywords[i].name; *kw; ++kw, ++str) {
+    if ((*str | 0x20) != *kw)
+      return 1;
   }
 
-  self->tok.value.as_string = strdup(buf);
-  return 1;
+  return self->tok.type = keywords[i].type;
 }
 
 /*
@@ -174,7 +179,7 @@ static int scan_ident(ifj17_lexer_t *self, int c) {
 
 static int hex_literal(ifj17_lexer_t *self) {
   int a = hex(next);
-  int b = hex(next);
+  int b = a > -1 ? hex(next) : -1;
   if (a > -1 && b > -1)
     return a << 4 | b;
   error("string hex literal \\x contains invalid digits");
@@ -182,88 +187,121 @@ static int hex_literal(ifj17_lexer_t *self) {
 }
 
 /*
- * Scan string.
+ * Scan the rest of string decimal literal \ddd, its first
+ * digit `c` read, returning -1 past 255.
+ */
+
+static int decimal_literal(ifj17_lexer_t *self, int c) {
+  int n = c - '0';
+  for (int i = 0; i < 2; ++i) {
+    if ((c = next) < '0' || c > '9') {
+      undo;
+      break;
+    }
+    n = n * 10 + c - '0';
+  }
+  if (n <= 255)
+    return n;
+  error("string decimal literal \\ddd exceeds 255");
+  return -1;
+}
+
+/*
+ * Scan string, validating its escapes and leaving the
+ * undecoded literal as a slice of the source.
  */
 
 static int scan_string(ifj17_lexer_t *self) {
-  int c, len = 0;
-  char buf[128];
+  int c;
   token(STRING);
+  self->tok.offset = self->offset;
 
   while ('"' != (c = next)) {
     switch (c) {
+    case 0:
+      undo;
+      error("unterminated string literal");
+      return 0;
     case '\n':
       ++self->lineno;
       break;
     case '\\':
       switch (c = next) {
+      case 0:
+        undo;
+        error("unterminated string literal");
+        return 0;
+      case 'x':
+        if (-1 == hex_literal(self))
+          return 0;
+        break;
+      default:
+        if (c >= '0' && c <= '9' && -1 == decimal_literal(self, c))
+          return 0;
+      }
+      break;
+    }
+  }
+
+  self->tok.len = self->offset - 1 - self->tok.offset;
+  return 1;
+}
+
+/*
+ * Append escape `seq` to `buf`, followed by the \035 marker.
+ */
+
+#define escape(seq)                                                                 \
+  (memcpy(buf + len, seq, sizeof(seq) - 1), len += sizeof(seq) - 1, c = '\035')
+
+/*
+ * Decode the `len` bytes of string literal `str` into `buf`, which
+ * must hold IFJ17_STRING_DECODE_SIZE(len) bytes. Return the decoded
+ * length; `buf` is nul-terminated.
+ */
+
+int ifj17_string_decode(char *buf, const char *str, int size) {
+  int c, len = 0;
+  const char *end = str + size;
+
+  while (str < end) {
+    if ('\\' == (c = *str++) && str < end) {
+      switch (c = *str++) {
       case 'a':
-        c = '\035';
-        buf[len++] = '0';
-        buf[len++] = '0';
-        buf[len++] = '7';
+        escape("007");
         break;
       case 'b':
-        c = '\035';
-        buf[len++] = '\\';
-        buf[len++] = '0';
-        buf[len++] = '0';
-        buf[len++] = '8';
+        escape("\\008");
         break;
       case 'e':
-        c = '\035';
-        buf[len++] = '\\';
-        buf[len++] = '0';
-        buf[len++] = '2';
-        buf[len++] = '7';
+        escape("\\027");
         break;
       case 'f':
-        c = '\035';
-        buf[len++] = '\\';
-        buf[len++] = '0';
-        buf[len++] = '1';
-        buf[len++] = '2';
+        escape("\\012");
         break;
       case 'n':
-        c = '\035';
-        buf[len++] = '\\';
-        buf[len++] = '0';
-        buf[len++] = '3';
-        buf[len++] = '5';
+        escape("\\035");
         break;
       case 'r':
-        c = '\035';
-        buf[len++] = '\\';
-        buf[len++] = '0';
-        buf[len++] = '1';
-        buf[len++] = '3';
+        escape("\\013");
         break;
       case 't':
-        c = '\035';
-        buf[len++] = '\\';
-        buf[len++] = '0';
-        buf[len++] = '0';
-        buf[len++] = '9';
+        escape("\\009");
         break;
       case 'v':
-        c = '\035';
-        buf[len++] = '\\';
-        buf[len++] = '0';
-        buf[len++] = '1';
-        buf[len++] = '1';
+        escape("\\011");
         break;
       case 'x':
-        if (-1 == (c = hex_literal(self)))
-          return 0;
+        c = hex(str[0]) << 4 | hex(str[1]);
+        str += 2;
+        break;
       }
-      break;
     }
     buf[len++] = c;
   }
 
-  buf[len++] = 0;
-  self->tok.value.as_string = strdup(buf); // TODO: remove
-  return 1;
+  buf[len] = 0;
+  return len;
 }
 
 /*
@@ -317,6 +355,13 @@ scan_int:
     else if ('e' == c || 'E' == c)
       goto scan_expo;
     n = n * 10 + c - '0';
+
+    // the rest of the digit run at once
+    if (isdigit(self->source[self->offset])) {
+      for (const char *end = self->simd->digits(self->source + self->offset);
+           self->source + self->offset < end; ++self->offset)
+        n = n * 10 + self->source[self->offset] - '0';
+    }
   } while (isdigit(c = next) || '_' == c || '.' == c || 'e' == c || 'E' == c);
   undo;
   self->tok.value.as_int = n;
@@ -365,11 +410,10 @@ scan_expo : {
 }
 
 /*
- * Scan the next token in the stream, returns 0
- * on EOS, ILLEGAL token, or a syntax error.
+ * Scan the next token.
  */
 
-int ifj17_scan(ifj17_lexer_t *self) {
+static int scan(ifj17_lexer_t *self) {
   int c;
 
 // scan
@@ -377,6 +421,8 @@ scan:
   switch (c = next) {
   case ' ':
   case '\t':
+    if (' ' == self->source[self->offset] || '\t' == self->source[self->offset])
+      span(blanks);
     goto scan;
   case '(':
     return token(LPAREN);
@@ -433,9 +479,7 @@ scan:
     }
   case '/':
     if ('\'' == next) {
-      while ((c = next) != '\'' && c)
-        ;
-      undo;
+      span(quote);
       goto scan;
     }
     return '=' == next ? token(OP_DIV_ASSIGN) : (undo, token(OP_DIV));
@@ -482,15 +526,16 @@ scan:
       return undo, token(OP_GT);
     }
   case '\\':
-    return token(OP_DIV_ASSIGN);
+    return token(OP_IDIV);
   case '\'':
     if ((c = next) == '/') {
       goto scan;
-    } else {
-      while ((c = next) != '\n' && c)
-        ;
+    } else if (!c) {
       undo;
       goto scan;
+    } else {
+      span(line);
+      goto scan;
     }
   case ';':
     return token(SEMICOLON);
@@ -502,6 +547,7 @@ scan:
     ++self->lineno;
     goto scan;
   case 0:
+    undo;
     token(EOS);
     return 0;
   default:
@@ -514,3 +560,68 @@ scan:
     return 0;
   }
 }
+
+/*
+ * Scan the next token in the stream, returns 0
+ * on EOS, ILLEGAL token, or a syntax error.
+ */
+
+int ifj17_scan(ifj17_lexer_t *self) {
+  int ret = scan(self);
+  self->tok.lineno = self->lineno;
+  return ret;
+}
+
+/*
+ * Scan up to `n` tokens into `toks`, returning how many were
+ * scanned. Stops early after the EOS or ILLEGAL token ending
+ * the stream, which is stored as the last one.
+ */
+
+int ifj17_lex(ifj17_lexer_t *self, ifj17_token_t *toks, int n) {
+  int i = 0;
+
+  while (i < n) {
+    int more = ifj17_scan(self);
+    toks[i++] = self->tok;
+    if (!more) {
+      break;
+    }
+  }
+
+  return i;
+}
+
+/*
+ * Scan the whole stream into an array of tokens ending with
+ * EOS or ILLEGAL, storing its length in `len`. The caller
+ * frees the array. Return NULL on failure.
+ */
+
+ifj17_token_t *ifj17_lex_all(ifj17_lexer_t *self, size_t *len) {
+  size_t size = IFJ17_TOKEN_BLOCK;
+  ifj17_token_t *toks = malloc(size * sizeof(ifj17_token_t));
+  if (unlikely(!toks)) {
+    return NULL;
+  }
+
+  *len = 0;
+  for (;;) {
+    int n = ifj17_lex(self, toks + *len, size - *len);
+    *len += n;
+
+    ifj17_token type = toks[*len - 1].type;
+    if (type == IFJ17_TOKEN_EOS || type == IFJ17_TOKEN_ILLEGAL) {
+      return toks;
+    }
+
+    if (*len == size) {
+      ifj17_token_t *tmp = realloc(toks, (size *= 2) * sizeof(ifj17_token_t));
+      if (unlikely(!tmp)) {
+        free(toks);
+        return NULL;
+      }
+      toks = tmp;
+    }
+  }
+}
@@ -7,16 +7,27 @@
 #ifndef IFJ17_LEXER_H
 #define IFJ17_LEXER_H
 
+#include "simd.h"
 #include "token.h"
 #include <stdio.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
-// Buffer size
-#ifndef IFJ17_BUF_SIZE
-#define IFJ17_BUF_SIZE 1024
+// Tokens scanned per batch
+#ifndef IFJ17_TOKEN_BLOCK
+#define IFJ17_TOKEN_BLOCK 1024
 #endif
 
+// Longest keyword
+#define IFJ17_KEYWORD_MAX 8
+
+/*
+ * Upper bound of a decoded string literal of `len` bytes,
+ * as an escape pair may expand to five bytes.
+ */
+
+#define IFJ17_STRING_DECODE_SIZE(len) ((len) / 2 * 5 + (len) % 2 + 1)
+
 /*
  * Lexer struct.
  */
@@ -25,16 +36,23 @@ typedef struct {
   int stash;
   int lineno;
   off_t offset;
-  char *source;
+  const char *source;
   const char *filename;
+  const ifj17_simd_t *simd;
   ifj17_token_t tok;
-  char buf[IFJ17_BUF_SIZE];
 } ifj17_lexer_t;
 
 // prototypes
 
 int ifj17_scan(ifj17_lexer_t *self);
 
-void ifj17_lexer_init(ifj17_lexer_t *self, char *source, const char *filename);
+int ifj17_lex(ifj17_lexer_t *self, ifj17_token_t *toks, int n);
+
+ifj17_token_t *ifj17_lex_all(ifj17_lexer_t *self, size_t *len);
+
+int ifj17_string_decode(char *buf, const char *str, int len);
+
+void ifj17_lexer_init(ifj17_lexer_t *self, const char *source,
+                      const char *filename);
 
 #endif /* IFJ17_LEXER_H */
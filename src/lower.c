@@ -0,0 +1,724 @@
+//
+// lower.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#include "lower.h"
+#include "internal.h"
+#include "semantic.h"
+#include "token.h"
+#include "visitor.h"
+#include <math.h>
+#include <stdlib.h>
+
+/*
+ * Lowering state: the function being built, the operand the
+ * expression visited wants its value in, and where it left it.
+ */
+
+typedef struct {
+  ifj17_ir_func_t *func;
+  ifj17_ir_operand_t dst;
+  ifj17_ir_operand_t result;
+} lower_t;
+
+/*
+ * The lowering state of visitor `self`.
+ */
+
+#define ctx ((lower_t *)self->data)
+
+/*
+ * Append instruction `op` to the function.
+ */
+
+#define emit(op, dst, a, b) ifj17_ir_emit(ctx->func, IFJ17_IR_##op, dst, a, b)
+
+/*
+ * Is `type` a number?
+ */
+
+#define numeric(type)                                                               \
+  (IFJ17_DATATYPE_INTEGER == (type) || IFJ17_DATATYPE_DOUBLE == (type))
+
+/*
+ * Literals of the default string value and the input prompt,
+ * laid out as interned strings.
+ */
+
+static struct {
+  int len;
+  unsigned int hash;
+  int ident;
+  char val[3];
+} empty = {0, 0, 0, ""}, prompt = {2, 0, 0, "? "};
+
+/*
+ * Return the value variables of `type` start with.
+ */
+
+static ifj17_ir_operand_t zero(ifj17_datatype type) {
+  switch (type) {
+  case IFJ17_DATATYPE_DOUBLE:
+    return ifj17_ir_double(0);
+  case IFJ17_DATATYPE_STRING:
+    return ifj17_ir_string((ifj17_string_t *)&empty);
+  case IFJ17_DATATYPE_BOOLEAN:
+    return ifj17_ir_bool(0);
+  default:
+    return ifj17_ir_int(0);
+  }
+}
+
+/*
+ * Lower expression `node`, into `dst` when it suits the value,
+ * returning the operand holding the value.
+ */
+
+static ifj17_ir_operand_t expr(ifj17_visitor_t *self, ifj17_node_t *node,
+                               ifj17_ir_operand_t dst) {
+  ctx->dst = dst;
+  ctx->result = ifj17_ir_none();
+  visit(node);
+  return ctx->result;
+}
+
+/*
+ * Return the operand a result of `type` is computed into: the
+ * wanted destination when of that type, or a new temporary.
+ */
+
+static ifj17_ir_operand_t target(ifj17_visitor_t *self, ifj17_datatype type) {
+  ifj17_ir_operand_t dst = ctx->dst;
+  ctx->dst = ifj17_ir_none();
+
+  if (IFJ17_IR_NONE != dst.kind && dst.datatype == type) {
+    return dst;
+  }
+  return ifj17_ir_temp(ctx->func, type);
+}
+
+/*
+ * Return `operand` converted to the number `type`, constants
+ * at compile time, into `dst` when given.
+ */
+
+static ifj17_ir_operand_t convert(ifj17_visitor_t *self, ifj17_ir_operand_t operand,
+                                  ifj17_datatype type, ifj17_ir_operand_t dst) {
+  if (!numeric(type) || !numeric(operand.datatype) || type == operand.datatype) {
+    return operand;
+  }
+
+  if (IFJ17_IR_INT == operand.kind) {
+    return ifj17_ir_double(operand.val.as_int);
+  }
+  if (IFJ17_IR_DOUBLE == operand.kind) {
+    return ifj17_ir_int((int)nearbyint(operand.val.as_double));
+  }
+
+  if (IFJ17_IR_NONE == dst.kind) {
+    dst = ifj17_ir_temp(ctx->func, type);
+  }
+
+  if (IFJ17_DATATYPE_DOUBLE == type) {
+    emit(INT2FLOAT, dst, operand, ifj17_ir_none());
+  } else {
+    emit(FLOAT2R2EINT, dst, operand, ifj17_ir_none());
+  }
+  return dst;
+}
+
+/*
+ * Store `value` into the local or temporary `dst`.
+ */
+
+static void store(ifj17_visitor_t *self, ifj17_ir_operand_t dst,
+                  ifj17_ir_operand_t value) {
+  if (value.kind == dst.kind && value.val.index == dst.val.index) {
+    return;
+  }
+
+  value = convert(self, value, dst.datatype, dst);
+  if (value.kind != dst.kind || value.val.index != dst.val.index) {
+    emit(MOVE, dst, value, ifj17_ir_none());
+  }
+}
+
+/*
+ * Lower the assignment of expression `node` to `dst`.
+ */
+
+static void assign(ifj17_visitor_t *self, ifj17_ir_operand_t dst,
+                   ifj17_node_t *node) {
+  store(self, dst, expr(self, node, dst));
+}
+
+/*
+ * Return the local operand of resolved id `node`.
+ */
+
+static ifj17_ir_operand_t local(ifj17_id_node_t *node) {
+  return ifj17_ir_operand(IFJ17_IR_LOCAL, node->base.datatype, index, node->slot);
+}
+
+/*
+ * Lower the operands of comparison `node` to a common type.
+ */
+
+static void operands(ifj17_visitor_t *self, ifj17_binary_op_node_t *node,
+                     ifj17_ir_operand_t *left, ifj17_ir_operand_t *right) {
+  *left = expr(self, node->left, ifj17_ir_none());
+  *right = expr(self, node->right, ifj17_ir_none());
+
+  if (numeric(left->datatype) && numeric(right->datatype) &&
+      left->datatype != right->datatype) {
+    *left = convert(self, *left, IFJ17_DATATYPE_DOUBLE, ifj17_ir_none());
+    *right = convert(self, *right, IFJ17_DATATYPE_DOUBLE, ifj17_ir_none());
+  }
+}
+
+/*
+ * Lower condition `node`, jumping to `label` when it is false
+ * and falling through when true.
+ */
+
+static void unless(ifj17_visitor_t *self, ifj17_node_t *node, int label) {
+  ifj17_ir_operand_t to = ifj17_ir_label_operand(label), left, right, test;
+  ifj17_binary_op_node_t *bin = (ifj17_binary_op_node_t *)node;
+
+  if (IFJ17_NODE_BINARY_OP == node->type && bin->right) {
+    switch (bin->op) {
+    case IFJ17_TOKEN_OP_ASSIGN:
+    case IFJ17_TOKEN_OP_EQ:
+      operands(self, bin, &left, &right);
+      emit(JUMPIFNEQ, to, left, right);
+      return;
+    case IFJ17_TOKEN_OP_NEQ:
+      operands(self, bin, &left, &right);
+      emit(JUMPIFEQ, to, left, right);
+      return;
+    case IFJ17_TOKEN_OP_LT:
+    case IFJ17_TOKEN_OP_GTE:
+      operands(self, bin, &left, &right);
+      test = ifj17_ir_temp(ctx->func, IFJ17_DATATYPE_BOOLEAN);
+      emit(LT, test, left, right);
+      emit(JUMPIFEQ, to, test, ifj17_ir_bool(IFJ17_TOKEN_OP_GTE == bin->op));
+      return;
+    case IFJ17_TOKEN_OP_GT:
+    case IFJ17_TOKEN_OP_LTE:
+      operands(self, bin, &left, &right);
+      test = ifj17_ir_temp(ctx->func, IFJ17_DATATYPE_BOOLEAN);
+      emit(GT, test, left, right);
+      emit(JUMPIFEQ, to, test, ifj17_ir_bool(IFJ17_TOKEN_OP_LTE == bin->op));
+      return;
+    }
+  }
+
+  test = expr(self, node, ifj17_ir_none());
+  emit(JUMPIFNEQ, to, test, ifj17_ir_bool(1));
+}
+
+/*
+ * Walk the params of `callee`, populating the declaration
+ * `decl` and default value `init` of the `n`th one. Return 0
+ * past the last param.
+ */
+
+static int param(ifj17_node_t *callee, int n, ifj17_decl_node_t **decl,
+                 ifj17_node_t **init) {
+  ifj17_node_vec_t *params = IFJ17_NODE_FUNCTION == callee->type
+                                 ? ((ifj17_function_node_t *)callee)->params
+                                 : ((ifj17_declare_node_t *)callee)->params;
+
+  ifj17_node_vec_each(params, {
+    ifj17_binary_op_node_t *bin = (ifj17_binary_op_node_t *)val;
+    int init_given = IFJ17_NODE_BINARY_OP == val->type;
+    *decl = (ifj17_decl_node_t *)(init_given ? bin->left : val);
+    *init = init_given ? bin->right : NULL;
+    if (n < ifj17_node_vec_length((*decl)->vec)) {
+      return 1;
+    }
+    n -= ifj17_node_vec_length((*decl)->vec);
+  });
+
+  return 0;
+}
+
+/*
+ * Visit block `node`.
+ */
+
+static void visit_block(ifj17_visitor_t *self, ifj17_block_node_t *node) {
+  ifj17_node_vec_each(node->stmts, {
+    ctx->dst = ifj17_ir_none();
+    visit(val);
+  });
+}
+
+/*
+ * Visit int `node`.
+ */
+
+static void visit_int(ifj17_visitor_t *self, ifj17_int_node_t *node) {
+  ctx->result = ifj17_ir_int(node->val);
+}
+
+/*
+ * Visit double `node`.
+ */
+
+static void visit_double(ifj17_visitor_t *self, ifj17_double_node_t *node) {
+  ctx->result = ifj17_ir_double(node->val);
+}
+
+/*
+ * Visit string `node`.
+ */
+
+static void visit_string(ifj17_visitor_t *self, ifj17_string_node_t *node) {
+  ctx->result = ifj17_ir_string(node->str);
+}
+
+/*
+ * Visit id `node`.
+ */
+
+static void visit_id(ifj17_visitor_t *self, ifj17_id_node_t *node) {
+  ctx->result = local(node);
+}
+
+/*
+ * Visit decl `node`, adding its locals.
+ */
+
+static void visit_decl(ifj17_visitor_t *self, ifj17_decl_node_t *node) {
+  ifj17_node_vec_each(node->vec, {
+    ifj17_id_node_t *id = (ifj17_id_node_t *)val;
+    kv_A(ctx->func->locals, id->slot).name = id->name;
+    kv_A(ctx->func->locals, id->slot).datatype = id->base.datatype;
+  });
+}
+
+/*
+ * Visit dim `node`, initializing its variables.
+ */
+
+static void visit_dim(ifj17_visitor_t *self, ifj17_dim_node_t *node) {
+  ifj17_node_vec_each(node->vec, {
+    ifj17_binary_op_node_t *init = (ifj17_binary_op_node_t *)val;
+    ifj17_decl_node_t *decl = (ifj17_decl_node_t *)init->left;
+
+    visit((ifj17_node_t *)decl);
+    ifj17_node_vec_each(decl->vec, {
+      ifj17_ir_operand_t dst = local((ifj17_id_node_t *)val);
+      if (init->right) {
+        assign(self, dst, init->right);
+      } else if (IFJ17_DATATYPE_UNKNOWN != dst.datatype) {
+        emit(MOVE, dst, zero(dst.datatype), ifj17_ir_none());
+      }
+    });
+  });
+}
+
+/*
+ * Visit unary op `node`.
+ */
+
+static void visit_unary_op(ifj17_visitor_t *self, ifj17_unary_op_node_t *node) {
+  ifj17_ir_operand_t dst = ctx->dst;
+  ifj17_ir_operand_t value = expr(self, node->expr, ifj17_ir_none());
+  ctx->dst = dst;
+
+  switch (node->op) {
+  case IFJ17_TOKEN_OP_MINUS:
+    if (IFJ17_IR_INT == value.kind) {
+      ctx->result = ifj17_ir_int(-value.val.as_int);
+    } else if (IFJ17_IR_DOUBLE == value.kind) {
+      ctx->result = ifj17_ir_double(-value.val.as_double);
+    } else {
+      ctx->result = target(self, value.datatype);
+      emit(SUB, ctx->result, zero(value.datatype), value);
+    }
+    break;
+  case IFJ17_TOKEN_OP_LNOT:
+  case IFJ17_TOKEN_OP_NOT:
+    ctx->result = target(self, IFJ17_DATATYPE_BOOLEAN);
+    emit(NOT, ctx->result, value, ifj17_ir_none());
+    break;
+  default:
+    ctx->result = value;
+  }
+}
+
+/*
+ * Lower the integer division `node`, dividing as doubles
+ * and truncating the quotient.
+ */
+
+static void idiv(ifj17_visitor_t *self, ifj17_binary_op_node_t *node) {
+  ifj17_ir_operand_t dst = ctx->dst, left, right, quotient;
+
+  left = expr(self, node->left, ifj17_ir_none());
+  left = convert(self, left, IFJ17_DATATYPE_DOUBLE, ifj17_ir_none());
+  right = expr(self, node->right, ifj17_ir_none());
+  right = convert(self, right, IFJ17_DATATYPE_DOUBLE, ifj17_ir_none());
+
+  quotient = ifj17_ir_temp(ctx->func, IFJ17_DATATYPE_DOUBLE);
+  emit(DIV, quotient, left, right);
+  ctx->dst = dst;
+  ctx->result = target(self, IFJ17_DATATYPE_INTEGER);
+  emit(FLOAT2INT, ctx->result, quotient, ifj17_ir_none());
+}
+
+/*
+ * Lower binary op `node` as an expression.
+ */
+
+static void binary(ifj17_visitor_t *self, ifj17_binary_op_node_t *node) {
+  ifj17_ir_operand_t dst = ctx->dst, left, right, result;
+  ifj17_datatype type = node->base.datatype;
+  ifj17_ir_op op;
+  int negate = 0;
+
+  switch (node->op) {
+  case IFJ17_TOKEN_OP_PLUS:
+    op = IFJ17_DATATYPE_STRING == type ? IFJ17_IR_CONCAT : IFJ17_IR_ADD;
+    break;
+  case IFJ17_TOKEN_OP_MINUS:
+    op = IFJ17_IR_SUB;
+    break;
+  case IFJ17_TOKEN_OP_MUL:
+    op = IFJ17_IR_MUL;
+    break;
+  case IFJ17_TOKEN_OP_DIV:
+    op = IFJ17_IR_DIV;
+    break;
+  case IFJ17_TOKEN_OP_IDIV:
+    idiv(self, node);
+    return;
+  case IFJ17_TOKEN_OP_AND:
+  case IFJ17_TOKEN_OP_BIT_AND:
+    op = IFJ17_IR_AND;
+    break;
+  case IFJ17_TOKEN_OP_OR:
+  case IFJ17_TOKEN_OP_BIT_OR:
+    op = IFJ17_IR_OR;
+    break;
+  case IFJ17_TOKEN_OP_NEQ:
+    negate = 1;
+    // fall through
+  case IFJ17_TOKEN_OP_ASSIGN:
+  case IFJ17_TOKEN_OP_EQ:
+    op = IFJ17_IR_EQ;
+    break;
+  case IFJ17_TOKEN_OP_GTE:
+    negate = 1;
+    // fall through
+  case IFJ17_TOKEN_OP_LT:
+    op = IFJ17_IR_LT;
+    break;
+  case IFJ17_TOKEN_OP_LTE:
+    negate = 1;
+    // fall through
+  case IFJ17_TOKEN_OP_GT:
+    op = IFJ17_IR_GT;
+    break;
+  default:
+    ctx->result = expr(self, node->left, dst);
+    return;
+  }
+
+  if (IFJ17_DATATYPE_BOOLEAN == type) {
+    operands(self, node, &left, &right);
+  } else {
+    left = expr(self, node->left, ifj17_ir_none());
+    left = convert(self, left, type, ifj17_ir_none());
+    right = expr(self, node->right, ifj17_ir_none());
+    right = convert(self, right, type, ifj17_ir_none());
+  }
+
+  ctx->dst = dst;
+  result = target(self, type);
+  ifj17_ir_emit(ctx->func, op, result, left, right);
+  if (negate) {
+    emit(NOT, result, result, ifj17_ir_none());
+  }
+  ctx->result = result;
+}
+
+/*
+ * Visit binary op `node`: an assignment, compound ones
+ * included, or an expression.
+ */
+
+static void visit_binary_op(ifj17_visitor_t *self, ifj17_binary_op_node_t *node) {
+  ifj17_token op;
+
+  switch (node->op) {
+  case IFJ17_TOKEN_OP_ASSIGN:
+    if (IFJ17_IR_NONE == ctx->dst.kind && IFJ17_NODE_ID == node->left->type) {
+      assign(self, local((ifj17_id_node_t *)node->left), node->right);
+      return;
+    }
+    break;
+  case IFJ17_TOKEN_OP_PLUS_ASSIGN:
+    op = IFJ17_TOKEN_OP_PLUS;
+    goto compound;
+  case IFJ17_TOKEN_OP_MINUS_ASSIGN:
+    op = IFJ17_TOKEN_OP_MINUS;
+    goto compound;
+  case IFJ17_TOKEN_OP_MUL_ASSIGN:
+    op = IFJ17_TOKEN_OP_MUL;
+    goto compound;
+  case IFJ17_TOKEN_OP_DIV_ASSIGN:
+    op = IFJ17_TOKEN_OP_DIV;
+  compound : {
+    ifj17_binary_op_node_t value = *node;
+    ifj17_datatype type = node->left->datatype, from = node->right->datatype;
+    value.op = op;
+    value.base.datatype =
+        IFJ17_TOKEN_OP_DIV == op || type != from ? IFJ17_DATATYPE_DOUBLE : type;
+    if (IFJ17_DATATYPE_STRING == type) {
+      value.base.datatype = type;
+    }
+    ctx->dst = ifj17_ir_none();
+    store(self, local((ifj17_id_node_t *)node->left),
+          expr(self, (ifj17_node_t *)&value, local((ifj17_id_node_t *)node->left)));
+    return;
+  }
+  }
+
+  binary(self, node);
+}
+
+/*
+ * Visit call `node`, pushing the arguments converted to the
+ * params' types, defaults for those left out.
+ */
+
+static void visit_call(ifj17_visitor_t *self, ifj17_call_node_t *node) {
+  ifj17_ir_operand_t dst = ctx->dst, arg;
+  ifj17_node_vec_t *args = node->args->vec;
+  ifj17_decl_node_t *decl;
+  ifj17_node_t *init;
+
+  for (int n = 0; param(node->callee, n, &decl, &init); ++n) {
+    if (n < ifj17_node_vec_length(args)) {
+      arg = expr(self, ifj17_node_vec_at(args, n), ifj17_ir_none());
+    } else if (init) {
+      arg = expr(self, init, ifj17_ir_none());
+    } else {
+      break;
+    }
+    arg = convert(self, arg, ifj17_datatype_of(decl->type), ifj17_ir_none());
+    emit(ARG, ifj17_ir_none(), arg, ifj17_ir_none());
+  }
+
+  ctx->dst = dst;
+  ctx->result = target(self, node->base.datatype);
+  emit(CALL, ctx->result,
+       ifj17_ir_operand(IFJ17_IR_FUNC, IFJ17_DATATYPE_UNKNOWN, as_string,
+                        ((ifj17_id_node_t *)node->expr)->name),
+       ifj17_ir_none());
+}
+
+/*
+ * Visit `while` node, testing before each iteration.
+ */
+
+static void visit_while(ifj17_visitor_t *self, ifj17_while_node_t *node) {
+  int loop = ifj17_ir_label(ctx->func, "LOOP");
+  int end = ifj17_ir_label(ctx->func, "END_LOOP");
+
+  ifj17_ir_place(ctx->func, loop);
+  unless(self, node->expr, end);
+  visit((ifj17_node_t *)node->block);
+  emit(JUMP, ifj17_ir_label_operand(loop), ifj17_ir_none(), ifj17_ir_none());
+  ifj17_ir_place(ctx->func, end);
+}
+
+/*
+ * Visit `return` node, converting to the function's result.
+ */
+
+static void visit_return(ifj17_visitor_t *self, ifj17_return_node_t *node) {
+  ifj17_ir_operand_t value = zero(ctx->func->datatype);
+
+  if (node->expr) {
+    value = expr(self, node->expr, ifj17_ir_none());
+    value = convert(self, value, ctx->func->datatype, ifj17_ir_none());
+  }
+
+  emit(RETURN, ifj17_ir_none(), value, ifj17_ir_none());
+}
+
+/*
+ * Lower the branch of condition `cond` to `block`, continuing
+ * at `end` after it.
+ */
+
+static void branch(ifj17_visitor_t *self, ifj17_node_t *cond,
+                   ifj17_block_node_t *block, int end) {
+  int next = ifj17_ir_label(ctx->func, "ELSE");
+
+  unless(self, cond, next);
+  visit((ifj17_node_t *)block);
+  if (ifj17_ir_falls_through(ctx->func)) {
+    emit(JUMP, ifj17_ir_label_operand(end), ifj17_ir_none(), ifj17_ir_none());
+  }
+  ifj17_ir_place(ctx->func, next);
+}
+
+/*
+ * Visit if `node`, a branch per condition.
+ */
+
+static void visit_if(ifj17_visitor_t *self, ifj17_if_node_t *node) {
+  int end = ifj17_ir_label(ctx->func, "END_IF");
+
+  branch(self, node->expr, node->block, end);
+
+  ifj17_node_vec_each(node->else_ifs, {
+    ifj17_if_node_t *else_if = (ifj17_if_node_t *)val;
+    branch(self, else_if->expr, else_if->block, end);
+  });
+
+  if (node->else_block) {
+    visit((ifj17_node_t *)node->else_block);
+  }
+
+  ifj17_ir_place(ctx->func, end);
+}
+
+/*
+ * Visit print `node`.
+ */
+
+static void visit_print(ifj17_visitor_t *self, ifj17_print_node_t *node) {
+  ifj17_node_vec_each(node->params, {
+    emit(WRITE, ifj17_ir_none(), expr(self, val, ifj17_ir_none()), ifj17_ir_none());
+  });
+}
+
+/*
+ * Visit input `node`, prompting for its variable.
+ */
+
+static void visit_input(ifj17_visitor_t *self, ifj17_input_node_t *node) {
+  ifj17_ir_operand_t dst = local((ifj17_id_node_t *)node->param);
+
+  emit(WRITE, ifj17_ir_none(), ifj17_ir_string((ifj17_string_t *)&prompt),
+       ifj17_ir_none());
+  emit(READ, dst, ifj17_ir_operand(IFJ17_IR_TYPE, dst.datatype, index, 0),
+       ifj17_ir_none());
+}
+
+/*
+ * Lower the statements of `block` into `func`, with `nslots`
+ * locals. Return 0 on failure.
+ */
+
+static int lower(ifj17_ir_func_t *func, ifj17_block_node_t *block, int nslots) {
+  lower_t state = {func};
+  ifj17_visitor_t visitor = {.data = (void *)&state,
+                             .visit_if = visit_if,
+                             .visit_id = visit_id,
+                             .visit_int = visit_int,
+                             .visit_call = visit_call,
+                             .visit_while = visit_while,
+                             .visit_block = visit_block,
+                             .visit_dim = visit_dim,
+                             .visit_decl = visit_decl,
+                             .visit_double = visit_double,
+                             .visit_string = visit_string,
+                             .visit_return = visit_return,
+                             .visit_print = visit_print,
+                             .visit_input = visit_input,
+                             .visit_unary_op = visit_unary_op,
+                             .visit_binary_op = visit_binary_op};
+  ifj17_visitor_t *self = &visitor;
+
+  // slots hold their names once declared
+  if (nslots) {
+    kv_resize(ifj17_ir_local_t, func->locals, nslots);
+    if (unlikely(!func->locals.a)) {
+      return 0;
+    }
+    func->locals.n = nslots;
+  }
+
+  if (func->name) {
+    ifj17_function_node_t *node = (ifj17_function_node_t *)block;
+    ifj17_node_vec_each(node->params, {
+      ifj17_node_t *decl = val;
+      if (IFJ17_NODE_BINARY_OP == val->type) {
+        decl = ((ifj17_binary_op_node_t *)val)->left;
+      }
+      visit(decl);
+      func->nparams += ifj17_node_vec_length(((ifj17_decl_node_t *)decl)->vec);
+    });
+    block = node->block;
+  }
+
+  visit((ifj17_node_t *)block);
+
+  // implicit result
+  if (func->name && ifj17_ir_falls_through(func)) {
+    emit(RETURN, ifj17_ir_none(), zero(func->datatype), ifj17_ir_none());
+  }
+
+  return !func->failed;
+}
+
+/*
+ * Lower function `node` into `func`. Return 0 on failure.
+ */
+
+int ifj17_lower_function(ifj17_ir_func_t *func, ifj17_function_node_t *node) {
+  ifj17_ir_func_init(func, node->name);
+  func->datatype = ifj17_datatype_of(node->type);
+  return lower(func, (ifj17_block_node_t *)node, node->nslots);
+}
+
+/*
+ * Lower the main scope `node` into `func`. Return 0 on failure.
+ */
+
+int ifj17_lower_scope(ifj17_ir_func_t *func, ifj17_scope_node_t *node) {
+  ifj17_ir_func_init(func, NULL);
+  return lower(func, node->block, node->nslots);
+}
+
+/*
+ * Lower the analyzed program `node` into `self`, its
+ * functions and scope in source order. Return 0 on failure.
+ */
+
+int ifj17_lower(ifj17_ir_t *self, ifj17_node_t *node) {
+  ifj17_ir_init(self);
+  if (IFJ17_NODE_BLOCK != node->type) {
+    return 1;
+  }
+
+  ifj17_node_vec_each(((ifj17_block_node_t *)node)->stmts, {
+    if (IFJ17_NODE_FUNCTION != val->type && IFJ17_NODE_SCOPE != val->type) {
+      continue;
+    }
+
+    ifj17_ir_func_t *func = malloc(sizeof(ifj17_ir_func_t));
+    if (unlikely(!func)) {
+      return 0;
+    }
+
+    kv_push(ifj17_ir_func_t *, self->funcs, func);
+    if (IFJ17_NODE_FUNCTION == val->type) {
+      if (unlikely(!ifj17_lower_function(func, (ifj17_function_node_t *)val)))
+        return 0;
+    } else if (unlikely(!ifj17_lower_scope(func, (ifj17_scope_node_t *)val))) {
+      return 0;
+    }
+  });
+
+  return 1;
+}
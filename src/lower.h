@@ -0,0 +1,21 @@
+//
+// lower.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_LOWER_H
+#define IFJ17_LOWER_H
+
+#include "ast.h"
+#include "ir.h"
+
+// prototypes
+
+int ifj17_lower_function(ifj17_ir_func_t *func, ifj17_function_node_t *node);
+
+int ifj17_lower_scope(ifj17_ir_func_t *func, ifj17_scope_node_t *node);
+
+int ifj17_lower(ifj17_ir_t *self, ifj17_node_t *node);
+
+#endif /* IFJ17_LOWER_H */
@@ -4,6 +4,8 @@
 // Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
 //
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "object.h"
 #include "internal.h"
 #include <assert.h>
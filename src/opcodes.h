@@ -8,32 +8,87 @@
 #define IFJ17_OPCODES_H_H
 
 /*
- * Opcodes.
+ * IFJcode17 opcodes, with the operands each takes: "v" a
+ * variable, "s" a variable or constant, "l" a label and "t"
+ * a type.
  */
 
 #define IFJ17_OP_LIST                                                               \
-  o(HALT, "halt") o(JMP, "jmp") o(LOADK, "loadk") o(LOADB, "loadb") o(MOVE, "move") \
-      o(EQ, "eq") o(LT, "lt") o(LTE, "lte") o(ADD, "add") o(SUB, "sub")             \
-          o(DIV, "div") o(MUL, "mul") o(MOD, "mod") o(POW, "pow")                   \
-              o(NEGATE, "negate") o(BIT_SHL, "bshl") o(BIT_SHR, "bshr")             \
-                  o(BIT_AND, "band") o(BIT_OR, "bor") o(BIT_XOR, "bxor")
+  o(MOVE, "vs") o(CREATEFRAME, "") o(PUSHFRAME, "") o(POPFRAME, "") o(DEFVAR, "v")  \
+      o(CALL, "l") o(RETURN, "") o(PUSHS, "s") o(POPS, "v") o(CLEARS, "")           \
+          o(ADD, "vss") o(SUB, "vss") o(MUL, "vss") o(DIV, "vss") o(LT, "vss")      \
+              o(GT, "vss") o(EQ, "vss") o(AND, "vss") o(OR, "vss") o(NOT, "vs")     \
+                  o(INT2FLOAT, "vs") o(FLOAT2INT, "vs") o(FLOAT2R2EINT, "vs")       \
+                      o(FLOAT2R2OINT, "vs") o(INT2CHAR, "vs") o(STRI2INT, "vss")    \
+                          o(READ, "vt") o(WRITE, "s") o(CONCAT, "vss")              \
+                              o(STRLEN, "vs") o(GETCHAR, "vss") o(SETCHAR, "vss")   \
+                                  o(TYPE, "vs") o(LABEL, "l") o(JUMP, "l")          \
+                                      o(JUMPIFEQ, "lss") o(JUMPIFNEQ, "lss")        \
+                                          o(BREAK, "") o(DPRINT, "s")
 
 /*
- * Opcodes enum.
+ * Superinstructions the interpreter fuses adjacent pairs of
+ * instructions into, by the opcodes of the first and the
+ * second. The first must not jump.
+ */
+
+#define IFJ17_SUPER_LIST                                                            \
+  s(MOVE_MOVE, MOVE, MOVE) s(DEFVAR_DEFVAR, DEFVAR, DEFVAR)                         \
+      s(DEFVAR_MOVE, DEFVAR, MOVE) s(PUSHS_CALL, PUSHS, CALL)                       \
+          s(PUSHS_RETURN, PUSHS, RETURN) s(LT_JUMPIFEQ, LT, JUMPIFEQ)               \
+              s(GT_JUMPIFEQ, GT, JUMPIFEQ)
+
+/*
+ * Opcodes enum, the superinstructions following the
+ * opcodes IFJcode17 spells.
  */
 
 typedef enum {
-#define o(op, str) IFJ17_OP_##op,
+#define o(op, operands) IFJ17_OP_##op,
   IFJ17_OP_LIST
 #undef o
+#define s(op, first, second) IFJ17_OP_##op,
+  IFJ17_SUPER_LIST
+#undef s
+  IFJ17_OPS
 } ifj17_op_t;
 
+/*
+ * Superinstructions enum.
+ */
+
+enum {
+#define s(op, first, second) IFJ17_SUPER_##op,
+  IFJ17_SUPER_LIST
+#undef s
+  IFJ17_SUPERS
+};
+
+/*
+ * Number of opcodes IFJcode17 spells.
+ */
+
+#define IFJ17_BASE_OPS (IFJ17_OPS - IFJ17_SUPERS)
+
 /*
  * Opcode strings.
  */
 
-static char *ifj17_op_strings[] = {
-#define o(op, str) str,
+static const char *ifj17_op_strings[] = {
+#define o(op, operands) #op,
+    IFJ17_OP_LIST
+#undef o
+#define s(op, first, second) #op,
+    IFJ17_SUPER_LIST
+#undef s
+};
+
+/*
+ * Opcode operands.
+ */
+
+static const char *ifj17_op_operands[] = {
+#define o(op, operands) operands,
     IFJ17_OP_LIST
 #undef o
 };
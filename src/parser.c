@@ -5,6 +5,8 @@
 //
 
 #include "parser.h"
+#include "errors.h"
+#include "internal.h"
 #include "prettyprint.h"
 #include "token.h"
 #include "vec.h"
@@ -18,7 +20,7 @@
 #ifdef EBUG_PARSER
 #define debug(name)                                                                 \
   fprintf(stderr, "\n\e[90m%s\e[0m\n", name);                                       \
-  ifj17_token_inspect(&self->lex->tok);
+  ifj17_token_inspect(self->tok, self->lex->source);
 #else
 #define debug(name)
 #endif
@@ -37,10 +39,10 @@
 #endif
 
 /*
- * Consume a token from the lexer
+ * Consume a token from the ring.
  */
 
-#define next (self->tok = (ifj17_scan(self->lex), &self->lex->tok))
+#define next (self->tok = advance(self))
 
 /*
  * Check if the current token is `t`.
@@ -60,12 +62,6 @@
 
 #define error(str) ((self->err = self->err ? self->err : str), NULL)
 
-/*
- * The lexer's current line number.
- */
-
-#define lineno self->lex->lineno
-
 // forward declarations
 
 static ifj17_block_node_t *block(ifj17_parser_t *self);
@@ -74,17 +70,107 @@ static ifj17_node_t *call_expr(ifj17_parser_t *self, ifj17_node_t *left);
 static ifj17_node_t *not_expr(ifj17_parser_t *self);
 
 /*
- * Initialize with the given lexer.
+ * Initialize with the given lexer and compilation `state`.
  */
 
-void ifj17_parser_init(ifj17_parser_t *self, ifj17_lexer_t *lex) {
+void ifj17_parser_init(ifj17_parser_t *self, ifj17_lexer_t *lex,
+                       ifj17_state_t *state) {
   self->lex = lex;
-  self->tok = NULL;
+  self->state = state;
+  self->pipeline = NULL;
   self->ctx = NULL;
   self->err = NULL;
   self->in_args = 0;
+  self->recover = 0;
+  self->ndiagnostics = 0;
+  self->diagnostics = NULL;
+  self->last = NULL;
+
+  // placeholder until the first token is consumed
+  self->toks[0].type = IFJ17_TOKEN_ILLEGAL;
+  self->toks[0].value.as_error = NULL;
+  self->toks[0].lineno = lex->lineno;
+  self->tok = &self->toks[0];
+  self->pos = 0;
+  self->end = 1;
+}
+
+/*
+ * Lex the next batch into the ring, keeping the previous token,
+ * the current one and everything after it. Return 0 when the
+ * ring is full.
+ */
+
+static int fill(ifj17_parser_t *self) {
+  unsigned int mask = IFJ17_TOKEN_RING - 1;
+  unsigned int room = IFJ17_TOKEN_RING - 1 - (self->end - self->pos);
+  unsigned int tail = IFJ17_TOKEN_RING - (self->end & mask);
+
+  if (room > tail) {
+    room = tail;
+  }
+  if (room > IFJ17_TOKEN_BLOCK) {
+    room = IFJ17_TOKEN_BLOCK;
+  }
+  if (!room) {
+    return 0;
+  }
+
+  ifj17_token_t *toks = &self->toks[self->end & mask];
+  self->end += self->pipeline ? ifj17_pipeline_read(self->pipeline, toks, room)
+                              : ifj17_lex(self->lex, toks, room);
+  return 1;
+}
+
+/*
+ * Return the token `n` ahead of the current one, or NULL when
+ * that is beyond the ring. Peeking past the end of the stream
+ * yields its last token.
+ */
+
+ifj17_token_t *ifj17_parser_peek(ifj17_parser_t *self, int n) {
+  while (self->end - self->pos <= n) {
+    if (!fill(self)) {
+      return NULL;
+    }
+  }
+
+  return &self->toks[(self->pos + n) & (IFJ17_TOKEN_RING - 1)];
+}
+
+/*
+ * Advance to the next token.
+ */
+
+static ifj17_token_t *advance(ifj17_parser_t *self) {
+  ++self->pos;
+  return ifj17_parser_peek(self, 0);
 }
 
+/*
+ * The compilation arena owning every node.
+ */
+
+#define arena (&self->state->arena)
+
+/*
+ * The current token's line number.
+ */
+
+#define lineno self->tok->lineno
+
+/*
+ * Intern the current identifier or string literal.
+ */
+
+#define ident(self)                                                                 \
+  ifj17_identifier(self->state, self->lex->source + self->tok->offset,              \
+                   self->tok->len)
+
+#define literal(self)                                                               \
+  ifj17_string_intern(self->state, self->lex->source + self->tok->offset,           \
+                      self->tok->len)
+
 /*
  * '(' expr ')'
  */
@@ -123,7 +209,7 @@ int arg_list(ifj17_parser_t *self, ifj17_array_node_t *arr, ifj17_token delim) {
   if (!(val = expr(self)))
     return 0;
 
-  ifj17_vec_push(arr->vals, ifj17_node(val));
+  ifj17_node_vec_push(arena, arr->vals, val);
 
   // ',' arg_list
   if (accept(COMMA)) {
@@ -139,7 +225,7 @@ int arg_list(ifj17_parser_t *self, ifj17_array_node_t *arr, ifj17_token delim) {
  */
 
 static ifj17_node_t *array_expr(ifj17_parser_t *self) {
-  ifj17_array_node_t *node = ifj17_array_node_new(lineno);
+  ifj17_array_node_t *node = ifj17_array_node_new(arena, lineno);
   debug("array_expr");
 
   if (!accept(LBRACK))
@@ -162,7 +248,7 @@ int hash_pairs(ifj17_parser_t *self, ifj17_hash_node_t *hash, ifj17_token delim)
   if (delim == self->tok->type)
     return 1;
 
-  ifj17_hash_pair_node_t *pair = ifj17_hash_pair_node_new(lineno);
+  ifj17_hash_pair_node_t *pair = ifj17_hash_pair_node_new(arena, lineno);
   if (!(pair->key = expr(self)))
     return 0;
 
@@ -175,7 +261,7 @@ int hash_pairs(ifj17_parser_t *self, ifj17_hash_node_t *hash, ifj17_token delim)
   if (!(pair->val = expr(self)))
     return 0;
 
-  ifj17_vec_push(hash->pairs, ifj17_node((ifj17_node_t *)pair));
+  ifj17_node_vec_push(arena, hash->pairs, (ifj17_node_t *)pair);
 
   // ',' hash_pairs
   if (accept(COMMA)) {
@@ -191,7 +277,7 @@ int hash_pairs(ifj17_parser_t *self, ifj17_hash_node_t *hash, ifj17_token delim)
  */
 
 static ifj17_node_t *hash_expr(ifj17_parser_t *self) {
-  ifj17_hash_node_t *node = ifj17_hash_node_new(lineno);
+  ifj17_hash_node_t *node = ifj17_hash_node_new(arena, lineno);
   debug("hash_expr");
 
   if (!accept(LBRACE))
@@ -213,8 +299,7 @@ static ifj17_node_t *type_expr(ifj17_parser_t *self) {
   if (!is(ID))
     return NULL;
 
-  ifj17_node_t *ret =
-      (ifj17_node_t *)ifj17_id_node_new(self->tok->value.as_string, lineno);
+  ifj17_node_t *ret = (ifj17_node_t *)ifj17_id_node_new(arena, ident(self), lineno);
   next;
 
   return ret;
@@ -232,13 +317,12 @@ static ifj17_node_t *decl_expr(ifj17_parser_t *self) {
     return NULL;
   }
 
-  ifj17_vec_t *vec = ifj17_vec_new();
+  ifj17_node_vec_t *vec = ifj17_node_vec_new(arena);
   int decl_line = lineno;
   while (is(ID)) {
     // id
-    ifj17_node_t *id =
-        (ifj17_node_t *)ifj17_id_node_new(self->tok->value.as_string, lineno);
-    ifj17_vec_push(vec, ifj17_node(id));
+    ifj17_node_t *id = (ifj17_node_t *)ifj17_id_node_new(arena, ident(self), lineno);
+    ifj17_node_vec_push(arena, vec, id);
     next;
 
     // ','
@@ -256,7 +340,7 @@ static ifj17_node_t *decl_expr(ifj17_parser_t *self) {
     return error("expecting type");
   }
 
-  return (ifj17_node_t *)ifj17_decl_node_new(vec, type, decl_line);
+  return (ifj17_node_t *)ifj17_decl_node_new(arena, vec, type, decl_line);
 }
 
 /*
@@ -275,16 +359,16 @@ static ifj17_node_t *primary_expr(ifj17_parser_t *self) {
   ifj17_token_t *tok = self->tok;
   switch (tok->type) {
   case IFJ17_TOKEN_ID:
-    ret = (ifj17_node_t *)ifj17_id_node_new(tok->value.as_string, lineno);
+    ret = (ifj17_node_t *)ifj17_id_node_new(arena, ident(self), lineno);
     break;
   case IFJ17_TOKEN_INT:
-    ret = (ifj17_node_t *)ifj17_int_node_new(tok->value.as_int, lineno);
+    ret = (ifj17_node_t *)ifj17_int_node_new(arena, tok->value.as_int, lineno);
     break;
   case IFJ17_TOKEN_DOUBLE:
-    ret = (ifj17_node_t *)ifj17_double_node_new(tok->value.as_double, lineno);
+    ret = (ifj17_node_t *)ifj17_double_node_new(arena, tok->value.as_double, lineno);
     break;
   case IFJ17_TOKEN_STRING:
-    ret = (ifj17_node_t *)ifj17_string_node_new(tok->value.as_string, lineno);
+    ret = (ifj17_node_t *)ifj17_string_node_new(arena, literal(self), lineno);
     break;
   case IFJ17_TOKEN_LBRACK:
     return array_expr(self);
@@ -299,47 +383,41 @@ static ifj17_node_t *primary_expr(ifj17_parser_t *self) {
 }
 
 /*
- *   call_expr
- * | call_expr '**' call_expr
+ * Expression operators keyed on token type. Binary operators
+ * have a precedence above zero, higher binding tighter, and
+ * the error context set once they are consumed; `prefix` marks
+ * unary prefix operators.
  */
 
-static ifj17_node_t *pow_expr(ifj17_parser_t *self) {
-  ifj17_node_t *node, *right;
-  int line = lineno;
-
-  debug("pow_expr");
-  if (!(node = call_expr(self, NULL)))
-    return NULL;
-  if (accept(OP_POW)) {
-    context("** operation");
-    if (right = call_expr(self, NULL)) {
-      return (ifj17_node_t *)ifj17_binary_op_node_new(IFJ17_TOKEN_OP_POW, node,
-                                                      right, line);
-    } else {
-      return error("missing right-hand expression");
-    }
-  }
-  return node;
-}
-
-/*
- *   pow_expr
- * | pow_expr '++'
- * | pow_expr '--'
- */
-
-static ifj17_node_t *postfix_expr(ifj17_parser_t *self) {
-  ifj17_node_t *node;
-  int line = lineno;
-  debug("postfix_expr");
-  if (!(node = pow_expr(self)))
-    return NULL;
-  if (is(OP_INCR) || is(OP_DECR)) {
-    node = (ifj17_node_t *)ifj17_unary_op_node_new(self->tok->type, node, 1, line);
-    next;
-  }
-  return node;
-}
+static const struct {
+  char prec;
+  char prefix;
+  char *ctx;
+} operators[IFJ17_TOKEN_OP_BIT_SHR + 1] = {
+    [IFJ17_TOKEN_OP_OR] = {1, 0, "|| operation"},
+    [IFJ17_TOKEN_OP_AND] = {2, 0, "&& operation"},
+    [IFJ17_TOKEN_OP_BIT_OR] = {3, 0, "or operation"},
+    [IFJ17_TOKEN_OP_BIT_XOR] = {4, 0, "^ operation"},
+    [IFJ17_TOKEN_OP_BIT_AND] = {5, 0, "& operation"},
+    [IFJ17_TOKEN_OP_EQ] = {6, 0, "equality operation"},
+    [IFJ17_TOKEN_OP_NEQ] = {6, 0, "equality operation"},
+    [IFJ17_TOKEN_OP_LT] = {7, 0, "relational operation"},
+    [IFJ17_TOKEN_OP_LTE] = {7, 0, "relational operation"},
+    [IFJ17_TOKEN_OP_GT] = {7, 0, "relational operation"},
+    [IFJ17_TOKEN_OP_GTE] = {7, 0, "relational operation"},
+    [IFJ17_TOKEN_OP_BIT_SHL] = {8, 0, "shift operation"},
+    [IFJ17_TOKEN_OP_BIT_SHR] = {8, 0, "shift operation"},
+    [IFJ17_TOKEN_OP_PLUS] = {9, 1, "additive operation"},
+    [IFJ17_TOKEN_OP_MINUS] = {9, 1, "additive operation"},
+    [IFJ17_TOKEN_OP_IDIV] = {10, 0, "integer division"},
+    [IFJ17_TOKEN_OP_MUL] = {11, 0, "multiplicative operation"},
+    [IFJ17_TOKEN_OP_DIV] = {11, 0, "multiplicative operation"},
+    [IFJ17_TOKEN_OP_MOD] = {11, 0, "multiplicative operation"},
+    [IFJ17_TOKEN_OP_INCR] = {0, 1, NULL},
+    [IFJ17_TOKEN_OP_DECR] = {0, 1, NULL},
+    [IFJ17_TOKEN_OP_BIT_NOT] = {0, 1, NULL},
+    [IFJ17_TOKEN_OP_NOT] = {0, 1, NULL},
+};
 
 /*
  *   '++' unary_expr
@@ -348,256 +426,87 @@ static ifj17_node_t *postfix_expr(ifj17_parser_t *self) {
  * | '+' unary_expr
  * | '-' unary_expr
  * | '!' unary_expr
- * | primary_expr
+ * | call_expr ('**' call_expr)? ('++' | '--')?
  */
 
 static ifj17_node_t *unary_expr(ifj17_parser_t *self) {
-  debug("unary_expr");
+  ifj17_node_t *node, *right;
   int line = lineno;
-  if (is(OP_INCR) || is(OP_DECR) || is(OP_BIT_NOT) || is(OP_PLUS) || is(OP_MINUS) ||
-      is(OP_NOT)) {
+  debug("unary_expr");
+
+  // prefix
+  if (operators[self->tok->type].prefix) {
     int op = self->tok->type;
     next;
-    return (ifj17_node_t *)ifj17_unary_op_node_new(op, unary_expr(self), 0, line);
+    return (ifj17_node_t *)ifj17_unary_op_node_new(arena, op, unary_expr(self), 0,
+                                                   line);
   }
-  return postfix_expr(self);
-}
-
-/*
- * unary_expr (('* | '/' | '%') unary_expr)*
- */
 
-static ifj17_node_t *multiplicative_expr(ifj17_parser_t *self) {
-  ifj17_token op;
-  ifj17_node_t *node, *right;
-  int line = lineno;
-  debug("multiplicative_expr");
-  if (!(node = unary_expr(self)))
+  if (!(node = call_expr(self, NULL)))
     return NULL;
-  while (is(OP_MUL) || is(OP_DIV) || is(OP_MOD)) {
-    op = self->tok->type;
-    next;
-    context("multiplicative operation");
-    if (right = unary_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(op, node, right, line);
-    } else {
-      return error("missing right-hand expression");
-    }
-  }
-  return node;
-}
-
-/*
- * multiplicative_expr (('+ | '-') multiplicative_expr)*
- */
 
-static ifj17_node_t *additive_expr(ifj17_parser_t *self) {
-  ifj17_token op;
-  ifj17_node_t *node, *right;
-  int line = lineno;
-  debug("additive_expr");
-  if (!(node = multiplicative_expr(self)))
-    return NULL;
-  while (is(OP_PLUS) || is(OP_MINUS)) {
-    op = self->tok->type;
-    next;
-    context("additive operation");
-    if (right = multiplicative_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(op, node, right, line);
-    } else {
+  // '**'
+  if (accept(OP_POW)) {
+    context("** operation");
+    if (!(right = call_expr(self, NULL)))
       return error("missing right-hand expression");
-    }
+    node = (ifj17_node_t *)ifj17_binary_op_node_new(arena, IFJ17_TOKEN_OP_POW, node,
+                                                    right, line);
   }
-  return node;
-}
 
-/*
- * additive_expr (('<<' | '>>') additive_expr)*
- */
-
-static ifj17_node_t *shift_expr(ifj17_parser_t *self) {
-  ifj17_token op;
-  ifj17_node_t *node, *right;
-  int line = lineno;
-  debug("shift_expr");
-  if (!(node = additive_expr(self)))
-    return NULL;
-  while (is(OP_BIT_SHL) || is(OP_BIT_SHR)) {
-    op = self->tok->type;
+  // postfix
+  if (is(OP_INCR) || is(OP_DECR)) {
+    node = (ifj17_node_t *)ifj17_unary_op_node_new(arena, self->tok->type, node, 1,
+                                                   line);
     next;
-    context("shift operation");
-    if (right = additive_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(op, node, right, line);
-    } else {
-      return error("missing right-hand expression");
-    }
   }
-  return node;
-}
 
-/*
- * shift_expr (('<' | '<=' | '>' | '>=') shift_expr)*
- */
-
-static ifj17_node_t *relational_expr(ifj17_parser_t *self) {
-  ifj17_token op;
-  ifj17_node_t *node, *right;
-  int line = lineno;
-  debug("relational_expr");
-  if (!(node = shift_expr(self)))
-    return NULL;
-  while (is(OP_LT) || is(OP_LTE) || is(OP_GT) || is(OP_GTE)) {
-    op = self->tok->type;
-    next;
-    context("relational operation");
-    if (right = shift_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(op, node, right, line);
-    } else {
-      return error("missing right-hand expression");
-    }
-  }
   return node;
 }
 
 /*
- * relational_expr (('==' | '<>') relational_expr)*
+ * unary_expr (op binary_expr)*, where each op binds
+ * tighter than `prec` and left-associates.
  */
 
-static ifj17_node_t *equality_expr(ifj17_parser_t *self) {
-  ifj17_token op;
+static ifj17_node_t *binary_expr(ifj17_parser_t *self, int prec) {
   ifj17_node_t *node, *right;
   int line = lineno;
-  debug("equality_expr");
-  if (!(node = relational_expr(self)))
-    return NULL;
-  while (is(OP_EQ) || is(OP_NEQ)) {
-    op = self->tok->type;
-    next;
-    context("equality operation");
-    if (right = relational_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(op, node, right, line);
-    } else {
-      return error("missing right-hand expression");
-    }
-  }
-  return node;
-}
-
-/*
- * equality_expr ('and' equality_expr)*
- */
+  debug("binary_expr");
 
-static ifj17_node_t *bitwise_and_expr(ifj17_parser_t *self) {
-  ifj17_node_t *node, *right;
-  debug("bitwise_and_expr");
-  int line = lineno;
-  if (!(node = equality_expr(self)))
+  if (!(node = unary_expr(self)))
     return NULL;
-  while (accept(OP_BIT_AND)) {
-    context("& operation");
-    if (right = equality_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(IFJ17_TOKEN_OP_BIT_AND, node,
-                                                      right, line);
-    } else {
-      return error("missing right-hand expression");
-    }
-  }
-  return node;
-}
 
-/*
- * bitwise_and_expr ('^' bitwise_and_expr)*
- */
-
-static ifj17_node_t *bitwise_xor_expr(ifj17_parser_t *self) {
-  ifj17_node_t *node, *right;
-  debug("bitwise_xor_expr");
-  int line = lineno;
-  if (!(node = bitwise_and_expr(self)))
-    return NULL;
-  while (accept(OP_BIT_XOR)) {
-    context("^ operation");
-    if (right = bitwise_and_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(IFJ17_TOKEN_OP_BIT_XOR, node,
-                                                      right, line);
-    } else {
+  while (operators[self->tok->type].prec > prec) {
+    ifj17_token op = self->tok->type;
+    next;
+    context(operators[op].ctx);
+    if (!(right = binary_expr(self, operators[op].prec)))
       return error("missing right-hand expression");
-    }
+    node = (ifj17_node_t *)ifj17_binary_op_node_new(arena, op, node, right, line);
   }
-  return node;
-}
 
-/*
- * bitwise_xor_expr ('|' bitwise_xor_expr)*
- */
-
-static ifj17_node_t *bitswise_or_expr(ifj17_parser_t *self) {
-  ifj17_node_t *node, *right;
-  debug("bitswise_or_expr");
-  int line = lineno;
-  if (!(node = bitwise_xor_expr(self)))
-    return NULL;
-  while (accept(OP_BIT_OR)) {
-    context("or operation");
-    if (right = bitwise_xor_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(IFJ17_TOKEN_OP_BIT_OR, node,
-                                                      right, line);
-    } else {
-      return error("missing right-hand expression");
-    }
-  }
   return node;
 }
 
 /*
- * bitswise_or_expr ('&&' bitswise_or_expr)*
+ * binary_expr '&'?
  */
 
-static ifj17_node_t *logical_and_expr(ifj17_parser_t *self) {
-  ifj17_node_t *node, *right;
-  debug("logical_and_expr");
+static ifj17_node_t *fork_expr(ifj17_parser_t *self) {
+  ifj17_node_t *node;
   int line = lineno;
-  if (!(node = bitswise_or_expr(self)))
-    return NULL;
-  while (accept(OP_AND)) {
-    context("&& operation");
-    if (right = bitswise_or_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(IFJ17_TOKEN_OP_AND, node,
-                                                      right, line);
-    } else {
-      return error("missing right-hand expression");
-    }
-  }
-  return node;
-}
-
-/*
- * logical_and_expr ('||' logical_and_expr)* '&'?
- */
+  debug("fork_expr");
 
-static ifj17_node_t *logical_or_expr(ifj17_parser_t *self) {
-  ifj17_node_t *node, *right;
-  int line = lineno;
-  debug("logical_or_expr");
-  if (!(node = logical_and_expr(self)))
+  if (!(node = binary_expr(self, 0)))
     return NULL;
 
-  // '||'
-  while (accept(OP_OR)) {
-    context("|| operation");
-    if (right = logical_and_expr(self)) {
-      node = (ifj17_node_t *)ifj17_binary_op_node_new(IFJ17_TOKEN_OP_OR, node, right,
-                                                      line);
-    } else {
-      return error("missing right-hand expression");
-    }
-  }
-
   // '&'
   if (accept(OP_FORK)) {
-    ifj17_id_node_t *id = ifj17_id_node_new("fork", line);
-    ifj17_call_node_t *call = ifj17_call_node_new((ifj17_node_t *)id, line);
-    ifj17_vec_push(call->args->vec, ifj17_node(node));
+    ifj17_string_t *name = ifj17_identifier(self->state, "fork", 4);
+    ifj17_id_node_t *id = ifj17_id_node_new(arena, name, line);
+    ifj17_call_node_t *call = ifj17_call_node_new(arena, (ifj17_node_t *)id, line);
+    ifj17_node_vec_push(arena, call->args->vec, node);
     node = (ifj17_node_t *)call;
   }
 
@@ -608,8 +517,8 @@ static ifj17_node_t *logical_or_expr(ifj17_parser_t *self) {
  * (decl_expr ('=' expr)? (',' decl_expr ('=' expr)?)*)
  */
 
-static ifj17_vec_t *function_params(ifj17_parser_t *self) {
-  ifj17_vec_t *params = ifj17_vec_new();
+static ifj17_node_vec_t *function_params(ifj17_parser_t *self) {
+  ifj17_node_vec_t *params = ifj17_node_vec_new(arena);
   debug("params");
   context("function params");
 
@@ -625,22 +534,22 @@ static ifj17_vec_t *function_params(ifj17_parser_t *self) {
     context("function param");
 
     // ('=' expr)?
-    ifj17_object_t *param;
+    ifj17_node_t *param;
     if (accept(OP_ASSIGN)) {
       ifj17_node_t *val = expr(self);
       if (!val)
         return NULL;
-      param = ifj17_node((ifj17_node_t *)ifj17_binary_op_node_new(
-          IFJ17_TOKEN_OP_ASSIGN, decl, val, line));
+      param = (ifj17_node_t *)ifj17_binary_op_node_new(arena, IFJ17_TOKEN_OP_ASSIGN,
+                                                       decl, val, line);
     } else {
       // if there isn't a value we need a type
       if (!decl->type) {
         return error("expecting type");
       }
-      param = ifj17_node((ifj17_node_t *)decl);
+      param = decl;
     }
 
-    ifj17_vec_push(params, param);
+    ifj17_node_vec_push(arena, params, param);
   } while (accept(COMMA));
 
   return params;
@@ -652,7 +561,7 @@ static ifj17_vec_t *function_params(ifj17_parser_t *self) {
 
 static ifj17_node_t *function_expr(ifj17_parser_t *self) {
   ifj17_block_node_t *body;
-  ifj17_vec_t *params;
+  ifj17_node_vec_t *params;
   debug("function_expr");
 
   // 'as'
@@ -699,7 +608,7 @@ static ifj17_node_t *slot_access_expr(ifj17_parser_t *self, ifj17_node_t *left)
 
 ifj17_args_node_t *call_args(ifj17_parser_t *self) {
   ifj17_node_t *node;
-  ifj17_args_node_t *args = ifj17_args_node_new(lineno);
+  ifj17_args_node_t *args = ifj17_args_node_new(arena, lineno);
 
   self->in_args++;
 
@@ -714,10 +623,16 @@ ifj17_args_node_t *call_args(ifj17_parser_t *self) {
         }
 
         ifj17_node_t *val = expr(self);
-        const char *str = ((ifj17_id_node_t *)node)->val;
-        ifj17_hash_set(args->hash, (char *)str, ifj17_node(val));
+        const char *str = node->type == IFJ17_NODE_ID
+                              ? ((ifj17_id_node_t *)node)->name->val
+                              : ifj17_string_node_value((ifj17_string_node_t *)node);
+        if (!args->hash)
+          args->hash = kh_init(node);
+        int ret;
+        khiter_t k = kh_put(node, args->hash, str, &ret);
+        kh_value(args->hash, k) = val;
       } else {
-        ifj17_vec_push(args->vec, ifj17_node(node));
+        ifj17_node_vec_push(arena, args->vec, node);
       }
     } else {
       return NULL;
@@ -750,7 +665,7 @@ static ifj17_node_t *call_expr(ifj17_parser_t *self, ifj17_node_t *left) {
   // '('
   if (accept(LPAREN)) {
     context("function call");
-    call = ifj17_call_node_new(left, line);
+    call = ifj17_call_node_new(arena, left, line);
 
     // args? ')'
     if (!is(RPAREN)) {
@@ -780,7 +695,7 @@ static ifj17_node_t *call_expr(ifj17_parser_t *self, ifj17_node_t *left) {
 
 static ifj17_node_t *dim_expr(ifj17_parser_t *self) {
   // dim already consumed
-  ifj17_vec_t *vec = ifj17_vec_new();
+  ifj17_node_vec_t *vec = ifj17_node_vec_new(arena);
   int let_line = lineno;
 
   do {
@@ -801,15 +716,15 @@ static ifj17_node_t *dim_expr(ifj17_parser_t *self) {
     }
 
     ifj17_node_t *bin = (ifj17_node_t *)ifj17_binary_op_node_new(
-        IFJ17_TOKEN_OP_ASSIGN, decl, val, line);
-    ifj17_vec_push(vec, ifj17_node(bin));
+        arena, IFJ17_TOKEN_OP_ASSIGN, decl, val, line);
+    ifj17_node_vec_push(arena, vec, bin);
   } while (accept(COMMA));
 
-  return (ifj17_node_t *)ifj17_dim_node_new(vec, let_line);
+  return (ifj17_node_t *)ifj17_dim_node_new(arena, vec, let_line);
 }
 
 /*
- *   logical_or_expr
+ *   fork_expr
  * | dim_expr
  * | call_expr '=' not_expr
  * | call_expr '+=' not_expr
@@ -830,7 +745,7 @@ static ifj17_node_t *assignment_expr(ifj17_parser_t *self) {
   }
 
   debug("assignment_expr");
-  if (!(node = logical_or_expr(self)))
+  if (!(node = fork_expr(self)))
     return NULL;
 
   // =
@@ -840,7 +755,8 @@ static ifj17_node_t *assignment_expr(ifj17_parser_t *self) {
     context("assignment");
     if (!(right = not_expr(self)))
       return NULL;
-    ifj17_binary_op_node_t *ret = ifj17_binary_op_node_new(op, node, right, line);
+    ifj17_binary_op_node_t *ret =
+        ifj17_binary_op_node_new(arena, op, node, right, line);
     return (ifj17_node_t *)ret;
   }
 
@@ -852,7 +768,7 @@ static ifj17_node_t *assignment_expr(ifj17_parser_t *self) {
     context("compound assignment");
     if (!(right = not_expr(self)))
       return NULL;
-    return (ifj17_node_t *)ifj17_binary_op_node_new(op, node, right, line);
+    return (ifj17_node_t *)ifj17_binary_op_node_new(arena, op, node, right, line);
   }
 
   return node;
@@ -870,8 +786,8 @@ static ifj17_node_t *not_expr(ifj17_parser_t *self) {
     ifj17_node_t *expr;
     if (!(expr = not_expr(self)))
       return NULL;
-    return (ifj17_node_t *)ifj17_unary_op_node_new(IFJ17_TOKEN_OP_LNOT, expr, 0,
-                                                   line);
+    return (ifj17_node_t *)ifj17_unary_op_node_new(arena, IFJ17_TOKEN_OP_LNOT, expr,
+                                                   0, line);
   }
   return assignment_expr(self);
 }
@@ -910,8 +826,8 @@ static ifj17_node_t *type_stmt(ifj17_parser_t *self) {
     return error("missing type name");
   }
 
-  const char *name = self->tok->value.as_string;
-  ifj17_type_node_t *type = ifj17_type_node_new(name, line);
+  ifj17_string_t *name = ident(self);
+  ifj17_type_node_t *type = ifj17_type_node_new(arena, name, line);
   next;
 
   // semicolon might have been inserted here
@@ -926,7 +842,7 @@ static ifj17_node_t *type_stmt(ifj17_parser_t *self) {
     // semicolon might have been inserted here
     accept(SEMICOLON);
 
-    ifj17_vec_push(type->fields, ifj17_node(decl));
+    ifj17_node_vec_push(arena, type->fields, decl);
   } while (!accept(END));
 
   return (ifj17_node_t *)type;
@@ -949,7 +865,7 @@ static ifj17_node_t *scope_stmt(ifj17_parser_t *self) {
 
   // block
   if (body = block(self)) {
-    return (ifj17_node_t *)ifj17_scope_node_new(body, line);
+    return (ifj17_node_t *)ifj17_scope_node_new(arena, body, line);
   }
 
   return NULL;
@@ -961,7 +877,7 @@ static ifj17_node_t *scope_stmt(ifj17_parser_t *self) {
 
 static ifj17_node_t *func_declare(ifj17_parser_t *self) {
   // declare already consumed
-  ifj17_vec_t *params;
+  ifj17_node_vec_t *params;
   ifj17_node_t *type = NULL;
   int line = lineno;
 
@@ -982,7 +898,7 @@ static ifj17_node_t *func_declare(ifj17_parser_t *self) {
     return error("missing function name");
   }
 
-  const char *name = self->tok->value.as_string;
+  ifj17_string_t *name = ident(self);
   next;
 
   // '('
@@ -997,7 +913,7 @@ static ifj17_node_t *func_declare(ifj17_parser_t *self) {
       return error("missing closing ')'");
     }
   } else {
-    params = ifj17_vec_new();
+    params = ifj17_node_vec_new(arena);
   }
 
   context("function declaration");
@@ -1014,7 +930,7 @@ static ifj17_node_t *func_declare(ifj17_parser_t *self) {
   // semicolon might have been inserted here
   accept(SEMICOLON);
 
-  return (ifj17_node_t *)ifj17_declare_node_new(name, type, params, line);
+  return (ifj17_node_t *)ifj17_declare_node_new(arena, name, type, params, line);
 }
 
 /*
@@ -1023,7 +939,7 @@ static ifj17_node_t *func_declare(ifj17_parser_t *self) {
 
 static ifj17_node_t *function_stmt(ifj17_parser_t *self) {
   ifj17_block_node_t *body;
-  ifj17_vec_t *params;
+  ifj17_node_vec_t *params;
   ifj17_node_t *type = NULL;
   int line = lineno;
   debug("function_stmt");
@@ -1039,7 +955,7 @@ static ifj17_node_t *function_stmt(ifj17_parser_t *self) {
     return error("missing function name");
   }
 
-  const char *name = self->tok->value.as_string;
+  ifj17_string_t *name = ident(self);
   next;
 
   // '('
@@ -1054,7 +970,7 @@ static ifj17_node_t *function_stmt(ifj17_parser_t *self) {
       return error("missing closing ')'");
     }
   } else {
-    params = ifj17_vec_new();
+    params = ifj17_node_vec_new(arena);
   }
 
   context("function");
@@ -1073,7 +989,8 @@ static ifj17_node_t *function_stmt(ifj17_parser_t *self) {
 
   // block
   if (body = block(self)) {
-    return (ifj17_node_t *)ifj17_function_node_new(name, type, body, params, line);
+    return (ifj17_node_t *)ifj17_function_node_new(arena, name, type, body, params,
+                                                   line);
   }
 
   return NULL;
@@ -1114,7 +1031,7 @@ static ifj17_node_t *if_stmt(ifj17_parser_t *self) {
     return NULL;
   }
 
-  ifj17_if_node_t *node = ifj17_if_node_new(cond, body, line);
+  ifj17_if_node_t *node = ifj17_if_node_new(arena, cond, body, line);
 
 // 'elseif' || 'else'
 loop:
@@ -1143,8 +1060,8 @@ loop:
       return NULL;
     }
 
-    ifj17_vec_push(node->else_ifs,
-                   ifj17_node((ifj17_node_t *)ifj17_if_node_new(cond, body, line)));
+    ifj17_if_node_t *else_if = ifj17_if_node_new(arena, cond, body, line);
+    ifj17_node_vec_push(arena, node->else_ifs, (ifj17_node_t *)else_if);
     goto loop;
   }
 
@@ -1191,7 +1108,7 @@ static ifj17_node_t *while_stmt(ifj17_parser_t *self) {
     return NULL;
   }
 
-  return (ifj17_node_t *)ifj17_while_node_new(cond, body, line);
+  return (ifj17_node_t *)ifj17_while_node_new(arena, cond, body, line);
 }
 
 /*
@@ -1217,7 +1134,7 @@ static ifj17_node_t *return_stmt(ifj17_parser_t *self) {
       return NULL;
   }
 
-  return (ifj17_node_t *)ifj17_return_node_new(node, line);
+  return (ifj17_node_t *)ifj17_return_node_new(arena, node, line);
 }
 
 /**
@@ -1237,17 +1154,18 @@ static ifj17_node_t *print_stmt(ifj17_parser_t *self) {
 
   // 'print' expr
   ifj17_node_t *param;
-  ifj17_vec_t *params = ifj17_vec_new();
+  ifj17_node_vec_t *params = ifj17_node_vec_new(arena);
 
+  // up to the end of the line, its last ';' included
   do {
     if (!(param = expr(self))) {
       break;
     }
 
-    ifj17_vec_push(params, ifj17_node(param));
-  } while (accept(SEMICOLON));
+    ifj17_node_vec_push(arena, params, param);
+  } while (accept(SEMICOLON) && lineno == line);
 
-  return (ifj17_node_t *)ifj17_print_node_new(params, line);
+  return (ifj17_node_t *)ifj17_print_node_new(arena, params, line);
 }
 
 /**
@@ -1272,7 +1190,7 @@ static ifj17_node_t *input_stmt(ifj17_parser_t *self) {
 
   accept(SEMICOLON);
 
-  return (ifj17_node_t *)ifj17_input_node_new(param, line);
+  return (ifj17_node_t *)ifj17_input_node_new(arena, param, line);
 }
 
 /*
@@ -1328,6 +1246,45 @@ static ifj17_node_t *stmt(ifj17_parser_t *self) {
   return expr(self);
 }
 
+/*
+ * Record the error of the statement which started at token `pos`
+ * and skip to the next statement boundary: past a ';', explicit
+ * or inserted at a newline, or up to the next line or the 'end',
+ * 'loop', 'else' or 'elseif' closing the enclosing block. Return
+ * 0 unless recovering, which stops at the end of the source.
+ */
+
+static int recover(ifj17_parser_t *self, unsigned int pos) {
+  if (!self->recover || !ifj17_diagnose(self)) {
+    return 0;
+  }
+
+  self->err = NULL;
+  debug("recover");
+
+  // nothing left to resynchronize on, unwind
+  if (is(EOS)) {
+    self->recover = 0;
+    return 0;
+  }
+
+  // always make progress
+  int line = lineno;
+  if (self->pos == pos) {
+    next;
+  }
+
+  while (!is(EOS) && !is(END) && !is(LOOP) && !is(ELSE) && !is(ELSEIF) &&
+         lineno == line) {
+    if (accept(SEMICOLON)) {
+      break;
+    }
+    next;
+  }
+
+  return 1;
+}
+
 /*
  * stmt* 'end'
  */
@@ -1335,7 +1292,7 @@ static ifj17_node_t *stmt(ifj17_parser_t *self) {
 static ifj17_block_node_t *block(ifj17_parser_t *self) {
   debug("block");
   ifj17_node_t *node;
-  ifj17_block_node_t *block = ifj17_block_node_new(lineno);
+  ifj17_block_node_t *block = ifj17_block_node_new(arena, lineno);
 
   do {
     // if `ELSEIF` or `ELSE` break to return block
@@ -1352,13 +1309,16 @@ static ifj17_block_node_t *block(ifj17_parser_t *self) {
       break;
     }
 
+    unsigned int pos = self->pos;
     if (!(node = stmt(self))) {
+      if (recover(self, pos))
+        continue;
       return NULL;
     }
 
     accept(SEMICOLON);
 
-    ifj17_vec_push(block->stmts, ifj17_node(node));
+    ifj17_node_vec_push(arena, block->stmts, node);
   } while (true);
 
   return block;
@@ -1371,19 +1331,20 @@ static ifj17_block_node_t *block(ifj17_parser_t *self) {
 static ifj17_block_node_t *program(ifj17_parser_t *self) {
   debug("program");
   ifj17_node_t *node;
-  ifj17_block_node_t *block = ifj17_block_node_new(lineno);
+  ifj17_block_node_t *block = ifj17_block_node_new(arena, lineno);
 
   next;
   while (!is(EOS)) {
+    unsigned int pos = self->pos;
     if (node = stmt(self)) {
       accept(SEMICOLON);
-      ifj17_vec_push(block->stmts, ifj17_node(node));
-    } else {
+      ifj17_node_vec_push(arena, block->stmts, node);
+    } else if (!recover(self, pos)) {
       return NULL;
     }
   }
 
-  return block;
+  return self->ndiagnostics ? NULL : block;
 }
 
 /*
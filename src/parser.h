@@ -9,22 +9,57 @@
 
 #include "ast.h"
 #include "lexer.h"
+#include "pipeline.h"
+#include "state.h"
+
+// Token ring size, a power of two
+#ifndef IFJ17_TOKEN_RING
+#define IFJ17_TOKEN_RING (4 * IFJ17_TOKEN_BLOCK)
+#endif
+
+/*
+ * Parse diagnostic, chained in the order found.
+ */
+
+typedef struct ifj17_diagnostic {
+  struct ifj17_diagnostic *next;
+  int lineno;
+  const char *type;
+  const char *ctx;
+  const char *msg;
+} ifj17_diagnostic_t;
 
 /*
- * Parser struct.
+ * Parser struct. Tokens are lexed in batches into a ring,
+ * `pos` is the current token and `end` the next to fill.
+ * With a `pipeline` the batches come from its lexer thread.
+ * When `recover` is set, errors are collected into
+ * `diagnostics` and parsing resumes at the next statement.
  */
 
 typedef struct {
   char *ctx;
   char *err;
   int in_args;
+  int recover;
+  int ndiagnostics;
+  ifj17_diagnostic_t *diagnostics;
+  ifj17_diagnostic_t *last;
   ifj17_token_t *tok;
   ifj17_lexer_t *lex;
+  ifj17_state_t *state;
+  ifj17_pipeline_t *pipeline;
+  unsigned int pos;
+  unsigned int end;
+  ifj17_token_t toks[IFJ17_TOKEN_RING];
 } ifj17_parser_t;
 
 // prototypes
 
-void ifj17_parser_init(ifj17_parser_t *self, ifj17_lexer_t *lex);
+void ifj17_parser_init(ifj17_parser_t *self, ifj17_lexer_t *lex,
+                       ifj17_state_t *state);
+
+ifj17_token_t *ifj17_parser_peek(ifj17_parser_t *self, int n);
 
 ifj17_block_node_t *ifj17_parse(ifj17_parser_t *self);
 
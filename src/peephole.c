@@ -0,0 +1,300 @@
+//
+// peephole.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#include "peephole.h"
+#include "internal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Peephole state: the function, the instructions found dead
+ * and the reads of each temporary by the live ones.
+ */
+
+typedef struct {
+  ifj17_ir_func_t *func;
+  char *dead;
+  int *reads;
+} peephole_t;
+
+/*
+ * Peephole rule, rewriting the function and returning its
+ * number of hits.
+ */
+
+typedef int (*rule_t)(peephole_t *self);
+
+/*
+ * Peephole rule names.
+ */
+
+const char *ifj17_peephole_rule_names[] = {
+#define r(rule, fn, name) name,
+    IFJ17_PEEPHOLE_RULE_LIST
+#undef r
+};
+
+/*
+ * Is `a` the same local or temporary as `b`?
+ */
+
+#define same(a, b) ((a).kind == (b).kind && (a).val.index == (b).val.index)
+
+/*
+ * Add `n` to the reads of `operand` when a temporary.
+ */
+
+#define count(operand, n)                                                           \
+  if (IFJ17_IR_TEMP == (operand).kind)                                              \
+    self->reads[(operand).val.index] += n;
+
+/*
+ * Iterate the live instructions of `block`, populating `i`.
+ */
+
+#define each_live(block, body)                                                      \
+  for (int i = (block)->first; i < (block)->first + (block)->len; ++i) {            \
+    if (!self->dead[i]) {                                                           \
+      body;                                                                         \
+    }                                                                               \
+  }
+
+/*
+ * Return the live instruction following `i` within `block`,
+ * or -1.
+ */
+
+static int next_live(peephole_t *self, ifj17_ir_block_t *block, int i) {
+  while (++i < block->first + block->len) {
+    if (!self->dead[i]) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Mark instruction `i` dead.
+ */
+
+static void kill(peephole_t *self, int i) {
+  ifj17_ir_instr_t *instr = &kv_A(self->func->code, i);
+  self->dead[i] = 1;
+  count(instr->a, -1);
+  count(instr->b, -1);
+}
+
+/*
+ * Count the reads of each temporary.
+ */
+
+static void count_reads(peephole_t *self) {
+  memset(self->reads, 0, kv_size(self->func->temps) * sizeof(int));
+  ifj17_ir_each(self->func, {
+    if (!self->dead[i]) {
+      count(instr->a, 1);
+      count(instr->b, 1);
+    }
+  });
+}
+
+/*
+ * `%t = ...; x = MOVE %t`, %t read nowhere else, computes
+ * `x = ...` directly: the stack-free form of a value pushed
+ * only to be popped.
+ */
+
+static int copy(peephole_t *self) {
+  ifj17_ir_func_t *func = self->func;
+  int hits = 0;
+
+  for (size_t b = 0; b < kv_size(func->blocks); ++b) {
+    ifj17_ir_block_t *block = &kv_A(func->blocks, b);
+    each_live(block, {
+      ifj17_ir_instr_t *instr = &kv_A(func->code, i);
+      ifj17_ir_instr_t *move;
+      int j = next_live(self, block, i);
+      if (-1 == j || IFJ17_IR_TEMP != instr->dst.kind) {
+        continue;
+      }
+
+      move = &kv_A(func->code, j);
+      if (IFJ17_IR_MOVE == move->op && same(move->a, instr->dst) &&
+          1 == self->reads[instr->dst.val.index] &&
+          move->dst.datatype == instr->dst.datatype) {
+        instr->dst = move->dst;
+        kill(self, j);
+        ++hits;
+      }
+    });
+  }
+
+  return hits;
+}
+
+/*
+ * `x = MOVE x` does nothing.
+ */
+
+static int self_move(peephole_t *self) {
+  int hits = 0;
+
+  ifj17_ir_each(self->func, {
+    if (!self->dead[i] && IFJ17_IR_MOVE == instr->op && same(instr->dst, instr->a)) {
+      kill(self, i);
+      ++hits;
+    }
+  });
+
+  return hits;
+}
+
+/*
+ * A jump to the label the code falls into anyway, past
+ * empty blocks only, does nothing.
+ */
+
+static int jump_next(peephole_t *self) {
+  ifj17_ir_func_t *func = self->func;
+  int hits = 0;
+
+  for (size_t b = 0; b < kv_size(func->blocks); ++b) {
+    ifj17_ir_block_t *block = &kv_A(func->blocks, b);
+    int last = -1;
+    each_live(block, { last = i; });
+    if (-1 == last) {
+      continue;
+    }
+
+    ifj17_ir_instr_t *instr = &kv_A(func->code, last);
+    if (IFJ17_IR_LABEL != instr->dst.kind) {
+      continue;
+    }
+
+    for (size_t c = b + 1; c < kv_size(func->blocks); ++c) {
+      ifj17_ir_block_t *next = &kv_A(func->blocks, c);
+      if (next->label == instr->dst.val.index) {
+        kill(self, last);
+        ++hits;
+        break;
+      }
+
+      int empty = 1;
+      each_live(next, { empty = 0; });
+      if (!empty) {
+        break;
+      }
+    }
+  }
+
+  return hits;
+}
+
+/*
+ * Temporaries no longer referenced are not defined: the
+ * others are renumbered densely.
+ */
+
+static int unused_temp(peephole_t *self) {
+  ifj17_ir_func_t *func = self->func;
+  int ntemps = kv_size(func->temps), n = 0;
+  int *index = self->reads;
+
+  memset(index, 0, ntemps * sizeof(int));
+  ifj17_ir_each(func, {
+    if (!self->dead[i]) {
+      count(instr->dst, 1);
+      count(instr->a, 1);
+      count(instr->b, 1);
+    }
+  });
+
+  for (int t = 0; t < ntemps; ++t) {
+    if (index[t]) {
+      kv_A(func->temps, n) = kv_A(func->temps, t);
+      index[t] = n++;
+    } else {
+      index[t] = -1;
+    }
+  }
+
+#define renumber(operand)                                                           \
+  if (IFJ17_IR_TEMP == (operand).kind)                                              \
+    (operand).val.index = index[(operand).val.index];
+
+  if (n < ntemps) {
+    ifj17_ir_each(func, {
+      if (!self->dead[i]) {
+        renumber(instr->dst);
+        renumber(instr->a);
+        renumber(instr->b);
+      }
+    });
+    kv_size(func->temps) = n;
+  }
+
+#undef renumber
+
+  count_reads(self);
+  return ntemps - n;
+}
+
+/*
+ * Peephole rules, in the order applied.
+ */
+
+static const rule_t rules[] = {
+#define r(rule, fn, name) fn,
+    IFJ17_PEEPHOLE_RULE_LIST
+#undef r
+};
+
+/*
+ * Rewrite redundant instruction patterns of `self` by the
+ * rules until none applies, adding the hits of each rule to
+ * `hits`. Return 0 on failure.
+ */
+
+int ifj17_peephole(ifj17_ir_func_t *self, int *hits) {
+  peephole_t peephole = {self};
+  int changed;
+
+  peephole.dead = calloc(kv_size(self->code) + 1, 1);
+  peephole.reads = calloc(kv_size(self->temps) + 1, sizeof(int));
+  if (unlikely(!peephole.dead || !peephole.reads)) {
+    free(peephole.dead);
+    free(peephole.reads);
+    return 0;
+  }
+
+  count_reads(&peephole);
+  do {
+    changed = 0;
+    for (int r = 0; r < IFJ17_PEEPHOLE_RULES; ++r) {
+      int n = rules[r](&peephole);
+      hits[r] += n;
+      changed |= n;
+    }
+  } while (changed);
+
+  ifj17_ir_compact(self, peephole.dead);
+  free(peephole.dead);
+  free(peephole.reads);
+  return 1;
+}
+
+/*
+ * Output the hits of each peephole rule to stderr.
+ */
+
+void ifj17_peephole_inspect(int *hits) {
+  fprintf(stderr, "peephole:");
+  for (int r = 0; r < IFJ17_PEEPHOLE_RULES; ++r) {
+    fprintf(stderr, "%s %s %d", r ? "," : "", ifj17_peephole_rule_names[r], hits[r]);
+  }
+  fprintf(stderr, "\n");
+}
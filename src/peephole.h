@@ -0,0 +1,45 @@
+//
+// peephole.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_PEEPHOLE_H
+#define IFJ17_PEEPHOLE_H
+
+#include "ir.h"
+
+/*
+ * Peephole rules, with the function applying each one and
+ * the name its hits are reported under. A rule is added by
+ * listing it here and defining its function in peephole.c.
+ */
+
+#define IFJ17_PEEPHOLE_RULE_LIST                                                    \
+  r(COPY, copy, "copy") r(SELF_MOVE, self_move, "self-move")                        \
+      r(JUMP_NEXT, jump_next, "jump-next") r(UNUSED_TEMP, unused_temp, "unused-temp")
+
+/*
+ * Peephole rules enum.
+ */
+
+typedef enum {
+#define r(rule, fn, name) IFJ17_PEEPHOLE_##rule,
+  IFJ17_PEEPHOLE_RULE_LIST
+#undef r
+  IFJ17_PEEPHOLE_RULES
+} ifj17_peephole_rule;
+
+/*
+ * Peephole rule names.
+ */
+
+extern const char *ifj17_peephole_rule_names[];
+
+// prototypes
+
+int ifj17_peephole(ifj17_ir_func_t *self, int *hits);
+
+void ifj17_peephole_inspect(int *hits);
+
+#endif /* IFJ17_PEEPHOLE_H */
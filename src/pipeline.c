@@ -0,0 +1,160 @@
+//
+// pipeline.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "pipeline.h"
+#include "internal.h"
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Ring index mask.
+ */
+
+#define MASK (IFJ17_PIPELINE_DEPTH - 1)
+
+/*
+ * Atomic accessors, publishing block contents with `head`
+ * and returning freed blocks with `tail`.
+ */
+
+#define load(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define store(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+/*
+ * Whether `type` ends the token stream. Lexing goes on past
+ * ILLEGAL tokens so a recovering parser sees the rest.
+ */
+
+#define last_token(type) (IFJ17_TOKEN_EOS == (type))
+
+/*
+ * Read `clock` in seconds.
+ */
+
+static double seconds(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * Lexer thread, scanning blocks until the end of the
+ * stream or until the parser asks it to stop.
+ */
+
+static void *produce(void *data) {
+  ifj17_pipeline_t *self = data;
+  unsigned int head = self->head;
+
+  while (!load(&self->stop)) {
+    // wait for the parser to free a block
+    if (head - load(&self->tail) == IFJ17_PIPELINE_DEPTH) {
+      double start = seconds(CLOCK_MONOTONIC);
+      while (head - load(&self->tail) == IFJ17_PIPELINE_DEPTH && !load(&self->stop))
+        sched_yield();
+      self->lex_wait += seconds(CLOCK_MONOTONIC) - start;
+      continue;
+    }
+
+    ifj17_token_block_t *block = &self->blocks[head & MASK];
+    block->len = ifj17_lex(self->lex, block->toks, IFJ17_TOKEN_BLOCK);
+    store(&self->head, ++head);
+
+    if (last_token(block->toks[block->len - 1].type)) {
+      break;
+    }
+  }
+
+  self->lex_busy = seconds(CLOCK_THREAD_CPUTIME_ID);
+  return NULL;
+}
+
+/*
+ * Start lexing `lex` on a separate thread. Return 0 on failure.
+ */
+
+int ifj17_pipeline_start(ifj17_pipeline_t *self, ifj17_lexer_t *lex) {
+  self->lex = lex;
+  self->stop = 0;
+  self->head = 0;
+  self->tail = 0;
+  self->pos = 0;
+  self->done = 0;
+  self->lex_busy = 0;
+  self->lex_wait = 0;
+  self->parse_wait = 0;
+  self->parse_busy = seconds(CLOCK_THREAD_CPUTIME_ID);
+
+  return 0 == pthread_create(&self->thread, NULL, produce, self);
+}
+
+/*
+ * Read up to `n` tokens into `toks` like ifj17_lex, blocking until
+ * the lexer thread has scanned them. Once the stream has ended
+ * its last token is returned again.
+ */
+
+int ifj17_pipeline_read(ifj17_pipeline_t *self, ifj17_token_t *toks, int n) {
+  unsigned int tail = self->tail;
+
+  if (unlikely(self->done)) {
+    toks[0] = self->last;
+    return 1;
+  }
+
+  // wait for the lexer to fill a block
+  if (tail == load(&self->head)) {
+    double start = seconds(CLOCK_MONOTONIC);
+    while (tail == load(&self->head))
+      sched_yield();
+    self->parse_wait += seconds(CLOCK_MONOTONIC) - start;
+  }
+
+  ifj17_token_block_t *block = &self->blocks[tail & MASK];
+  int len = block->len - self->pos;
+  if (len > n) {
+    len = n;
+  }
+
+  memcpy(toks, block->toks + self->pos, len * sizeof(ifj17_token_t));
+  self->pos += len;
+
+  // give the block back
+  if (self->pos == block->len) {
+    self->last = block->toks[block->len - 1];
+    self->done = last_token(self->last.type);
+    self->pos = 0;
+    store(&self->tail, tail + 1);
+  }
+
+  return len;
+}
+
+/*
+ * Stop and join the lexer thread. The lexer may only be
+ * inspected again once this returns.
+ */
+
+void ifj17_pipeline_stop(ifj17_pipeline_t *self) {
+  store(&self->stop, 1);
+  pthread_join(self->thread, NULL);
+  self->parse_busy = seconds(CLOCK_THREAD_CPUTIME_ID) - self->parse_busy;
+}
+
+/*
+ * Output per-stage busy and wait times to stderr.
+ */
+
+void ifj17_pipeline_inspect(ifj17_pipeline_t *self) {
+  fprintf(stderr, "lexer: %.3f ms busy, %.3f ms waiting for the parser\n",
+          self->lex_busy * 1e3, self->lex_wait * 1e3);
+  fprintf(stderr, "parser: %.3f ms busy, %.3f ms waiting for the lexer\n",
+          self->parse_busy * 1e3, self->parse_wait * 1e3);
+}
@@ -0,0 +1,65 @@
+//
+// pipeline.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_PIPELINE_H
+#define IFJ17_PIPELINE_H
+
+#include "lexer.h"
+#include <pthread.h>
+
+// Token blocks in flight, a power of two
+#ifndef IFJ17_PIPELINE_DEPTH
+#define IFJ17_PIPELINE_DEPTH 16
+#endif
+
+/*
+ * Token block, `len` tokens scanned in one batch.
+ */
+
+typedef struct {
+  int len;
+  ifj17_token_t toks[IFJ17_TOKEN_BLOCK];
+} ifj17_token_block_t;
+
+/*
+ * Lexer/parser pipeline.
+ *
+ * A lexer thread fills token blocks into a single-producer,
+ * single-consumer ring; the parser drains them. `head` is
+ * only written by the lexer, `tail` and `pos` only by the
+ * parser. Busy times are thread CPU seconds, wait times
+ * the wall seconds spent blocked on the other stage.
+ */
+
+typedef struct {
+  ifj17_lexer_t *lex;
+  pthread_t thread;
+  int stop;
+  // lexer side
+  unsigned int head __attribute__((aligned(64)));
+  // parser side
+  unsigned int tail __attribute__((aligned(64)));
+  int pos;
+  int done;
+  ifj17_token_t last;
+  double lex_busy;
+  double lex_wait;
+  double parse_busy;
+  double parse_wait;
+  ifj17_token_block_t blocks[IFJ17_PIPELINE_DEPTH];
+} ifj17_pipeline_t;
+
+// prototypes
+
+int ifj17_pipeline_start(ifj17_pipeline_t *self, ifj17_lexer_t *lex);
+
+int ifj17_pipeline_read(ifj17_pipeline_t *self, ifj17_token_t *toks, int n);
+
+void ifj17_pipeline_stop(ifj17_pipeline_t *self);
+
+void ifj17_pipeline_inspect(ifj17_pipeline_t *self);
+
+#endif /* IFJ17_PIPELINE_H */
@@ -6,7 +6,6 @@
 
 #include "ast.h"
 #include "prettyprint.h"
-#include "vec.h"
 #include "visitor.h"
 #include <stdio.h>
 
@@ -97,11 +96,11 @@ static const char *inspect(const char *str) {
  */
 
 static void visit_block(ifj17_visitor_t *self, ifj17_block_node_t *node) {
-  ifj17_vec_each(node->stmts, {
+  ifj17_node_vec_each(node->stmts, {
     if (i)
       print_func("\n");
     INDENT;
-    visit((ifj17_node_t *)val->value.as_pointer);
+    visit(val);
     if (!indents)
       print_func("\n");
   });
@@ -128,7 +127,7 @@ static void visit_double(ifj17_visitor_t *self, ifj17_double_node_t *node) {
  */
 
 static void visit_id(ifj17_visitor_t *self, ifj17_id_node_t *node) {
-  print_func("(id %s)", node->val);
+  print_func("(id %s)", node->name->val);
 }
 
 /*
@@ -138,10 +137,10 @@ static void visit_id(ifj17_visitor_t *self, ifj17_id_node_t *node) {
 static void visit_decl(ifj17_visitor_t *self, ifj17_decl_node_t *node) {
   print_func("(decl");
   indents++;
-  ifj17_vec_each(node->vec, {
+  ifj17_node_vec_each(node->vec, {
     print_func("\n");
     INDENT;
-    visit((ifj17_node_t *)val->value.as_pointer);
+    visit(val);
   });
 
   if (node->type) {
@@ -163,8 +162,8 @@ static void visit_dim(ifj17_visitor_t *self, ifj17_dim_node_t *node) {
   print_func("(dim");
   indents++;
 
-  ifj17_vec_each(node->vec, {
-    ifj17_binary_op_node_t *bin = (ifj17_binary_op_node_t *)val->value.as_pointer;
+  ifj17_node_vec_each(node->vec, {
+    ifj17_binary_op_node_t *bin = (ifj17_binary_op_node_t *)val;
 
     print_func("\n");
     INDENT;
@@ -187,7 +186,7 @@ static void visit_dim(ifj17_visitor_t *self, ifj17_dim_node_t *node) {
  */
 
 static void visit_string(ifj17_visitor_t *self, ifj17_string_node_t *node) {
-  print_func("(string '%s')", inspect(node->val));
+  print_func("(string '%s')", inspect(ifj17_string_node_value(node)));
 }
 
 /*
@@ -231,9 +230,9 @@ static void visit_binary_op(ifj17_visitor_t *self, ifj17_binary_op_node_t *node)
 static void visit_array(ifj17_visitor_t *self, ifj17_array_node_t *node) {
   print_func("(array\n");
   ++indents;
-  ifj17_vec_each(node->vals, {
+  ifj17_node_vec_each(node->vals, {
     INDENT;
-    visit((ifj17_node_t *)val->value.as_pointer);
+    visit(val);
     if (i != len - 1)
       print_func("\n");
   });
@@ -248,11 +247,11 @@ static void visit_array(ifj17_visitor_t *self, ifj17_array_node_t *node) {
 static void visit_hash(ifj17_visitor_t *self, ifj17_hash_node_t *node) {
   print_func("(hash\n");
   ++indents;
-  ifj17_vec_each(node->pairs, {
+  ifj17_node_vec_each(node->pairs, {
     INDENT;
-    visit(((ifj17_hash_pair_node_t *)val->value.as_pointer)->key);
+    visit(((ifj17_hash_pair_node_t *)val)->key);
     print_func(": ");
-    visit(((ifj17_hash_pair_node_t *)val->value.as_pointer)->val);
+    visit(((ifj17_hash_pair_node_t *)val)->val);
     print_func("\n");
   });
   --indents;
@@ -300,19 +299,24 @@ static void visit_call(ifj17_visitor_t *self, ifj17_call_node_t *node) {
   ++indents;
   INDENT;
   visit((ifj17_node_t *)node->expr);
-  if (ifj17_vec_length(node->args->vec)) {
+  if (ifj17_node_vec_length(node->args->vec)) {
     print_func("\n");
     INDENT;
-    ifj17_vec_each(node->args->vec, {
-      visit((ifj17_node_t *)val->value.as_pointer);
+    ifj17_node_vec_each(node->args->vec, {
+      visit(val);
       if (i != len - 1)
         print_func(" ");
     });
 
-    ifj17_hash_each(node->args->hash, {
-      print_func(" %s: ", slot);
-      visit((ifj17_node_t *)val->value.as_pointer);
-    });
+    if (node->args->hash) {
+      khash_t(node) *hash = node->args->hash;
+      for (khiter_t k = kh_begin(hash); k < kh_end(hash); ++k) {
+        if (!kh_exist(hash, k))
+          continue;
+        print_func(" %s: ", kh_key(hash, k));
+        visit(kh_value(hash, k));
+      }
+    }
   }
   --indents;
   print_func(")");
@@ -336,17 +340,17 @@ static void visit_declare(ifj17_visitor_t *self, ifj17_declare_node_t *node) {
   print_func("\n");
   ++indents;
   INDENT;
-  print_func("(function %s -> ", node->name);
+  print_func("(function %s -> ", node->name->val);
 
   if (node->type) {
     visit(node->type);
   }
 
-  ifj17_vec_each(node->params, {
+  ifj17_node_vec_each(node->params, {
     print_func("\n");
     ++indents;
     INDENT;
-    visit((ifj17_node_t *)val->value.as_pointer);
+    visit(val);
     --indents;
   });
   --indents;
@@ -358,17 +362,17 @@ static void visit_declare(ifj17_visitor_t *self, ifj17_declare_node_t *node) {
  */
 
 static void visit_function(ifj17_visitor_t *self, ifj17_function_node_t *node) {
-  print_func("(function %s -> ", node->name);
+  print_func("(function %s -> ", node->name->val);
   ++indents;
 
   if (node->type) {
     visit(node->type);
   }
 
-  ifj17_vec_each(node->params, {
+  ifj17_node_vec_each(node->params, {
     print_func("\n");
     INDENT;
-    visit((ifj17_node_t *)val->value.as_pointer);
+    visit(val);
   });
   --indents;
   print_func("\n");
@@ -385,10 +389,10 @@ static void visit_function(ifj17_visitor_t *self, ifj17_function_node_t *node) {
 static void visit_print(ifj17_visitor_t *self, ifj17_print_node_t *node) {
   print_func("(print");
   ++indents;
-  ifj17_vec_each(node->params, {
+  ifj17_node_vec_each(node->params, {
     print_func("\n");
     INDENT;
-    visit((ifj17_node_t *)val->value.as_pointer);
+    visit(val);
   });
   --indents;
   print_func(")");
@@ -411,12 +415,12 @@ static void visit_input(ifj17_visitor_t *self, ifj17_input_node_t *node) {
  */
 
 static void visit_type(ifj17_visitor_t *self, ifj17_type_node_t *node) {
-  print_func("(type %s", node->name);
+  print_func("(type %s", node->name->val);
   ++indents;
-  ifj17_vec_each(node->fields, {
+  ifj17_node_vec_each(node->fields, {
     print_func("\n");
     INDENT;
-    visit((ifj17_node_t *)val->value.as_pointer);
+    visit(val);
   });
   --indents;
   print_func(")");
@@ -468,8 +472,8 @@ static void visit_if(ifj17_visitor_t *self, ifj17_if_node_t *node) {
   print_func(")");
 
   // else ifs
-  ifj17_vec_each(node->else_ifs, {
-    ifj17_if_node_t *else_if = (ifj17_if_node_t *)val->value.as_pointer;
+  ifj17_node_vec_each(node->else_ifs, {
+    ifj17_if_node_t *else_if = (ifj17_if_node_t *)val;
     print_func("\n");
     INDENT;
     print_func("(else if ");
@@ -0,0 +1,759 @@
+//
+// semantic.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#include "semantic.h"
+#include "internal.h"
+#include "token.h"
+#include "visitor.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * The analysis of visitor `self`.
+ */
+
+#define sem ((ifj17_semantic_t *)self->data)
+
+/*
+ * Is `type` a number?
+ */
+
+#define numeric(type)                                                               \
+  (IFJ17_DATATYPE_INTEGER == (type) || IFJ17_DATATYPE_DOUBLE == (type))
+
+/*
+ * Can a `from` value be stored in a `to` variable? Numbers
+ * convert to each other, unknown types are checked at run time.
+ */
+
+#define assignable(to, from)                                                        \
+  (IFJ17_DATATYPE_UNKNOWN == (to) || IFJ17_DATATYPE_UNKNOWN == (from) ||            \
+   (to) == (from) || (numeric(to) && numeric(from)))
+
+/*
+ * Datatype names.
+ */
+
+static const char *datatype_names[] = {"unknown", "integer", "double", "string",
+                                       "boolean"};
+
+/*
+ * Params cursor, walking the names of a function's params.
+ */
+
+typedef struct {
+  ifj17_node_vec_t *params;
+  int i;
+  int j;
+} params_t;
+
+/*
+ * Return the datatype named by the `type` node, e.g. "(id integer)".
+ */
+
+ifj17_datatype ifj17_datatype_of(ifj17_node_t *type) {
+  if (!type || IFJ17_NODE_ID != type->type) {
+    return IFJ17_DATATYPE_UNKNOWN;
+  }
+
+  const char *name = ((ifj17_id_node_t *)type)->name->val;
+  if (!strcmp("integer", name))
+    return IFJ17_DATATYPE_INTEGER;
+  if (!strcmp("double", name))
+    return IFJ17_DATATYPE_DOUBLE;
+  if (!strcmp("string", name))
+    return IFJ17_DATATYPE_STRING;
+  if (!strcmp("boolean", name))
+    return IFJ17_DATATYPE_BOOLEAN;
+  return IFJ17_DATATYPE_UNKNOWN;
+}
+
+/*
+ * Record error `code` at `lineno` unless one was already,
+ * formatting its message into the arena.
+ */
+
+static void error(ifj17_visitor_t *self, ifj17_semantic_error code, int lineno,
+                  const char *fmt, ...) {
+  char buf[128];
+  va_list ap;
+
+  if (sem->error) {
+    return;
+  }
+
+  va_start(ap, fmt);
+  vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+
+  sem->error = code;
+  sem->lineno = lineno;
+  sem->ctx = sem->func ? sem->func->name->val : "scope";
+  if (unlikely(!(sem->msg = ifj17_arena_strdup(&sem->state->arena, buf)))) {
+    sem->error = IFJ17_SEMANTIC_INTERNAL;
+    sem->msg = "out of memory";
+  }
+}
+
+/*
+ * Return the declaration of param `node`, with or without a default.
+ */
+
+static ifj17_decl_node_t *param_decl(ifj17_node_t *node) {
+  if (IFJ17_NODE_BINARY_OP == node->type) {
+    node = ((ifj17_binary_op_node_t *)node)->left;
+  }
+  return (ifj17_decl_node_t *)node;
+}
+
+/*
+ * Step `it` to the next param, populating its `type` and
+ * whether it is `optional`. Return 0 past the last one.
+ */
+
+static int next_param(params_t *it, ifj17_datatype *type, int *optional) {
+  while (it->params && it->i < ifj17_node_vec_length(it->params)) {
+    ifj17_node_t *node = ifj17_node_vec_at(it->params, it->i);
+    ifj17_decl_node_t *decl = param_decl(node);
+
+    if (it->j < ifj17_node_vec_length(decl->vec)) {
+      it->j++;
+      *type = ifj17_datatype_of(decl->type);
+      *optional = IFJ17_NODE_BINARY_OP == node->type &&
+                  ((ifj17_binary_op_node_t *)node)->right;
+      return 1;
+    }
+
+    it->i++;
+    it->j = 0;
+  }
+
+  return 0;
+}
+
+/*
+ * Return the params of function `sym`.
+ */
+
+static ifj17_node_vec_t *params_of(ifj17_symbol_t *sym) {
+  if (IFJ17_NODE_FUNCTION == sym->decl->type) {
+    return ((ifj17_function_node_t *)sym->decl)->params;
+  }
+  return ((ifj17_declare_node_t *)sym->decl)->params;
+}
+
+/*
+ * Do the params `a` and `b` take the same types?
+ */
+
+static int same_params(ifj17_node_vec_t *a, ifj17_node_vec_t *b) {
+  params_t x = {a, 0, 0}, y = {b, 0, 0};
+  ifj17_datatype tx, ty;
+  int ox, oy, more;
+
+  while ((more = next_param(&x, &tx, &ox)) == next_param(&y, &ty, &oy) && more) {
+    if (tx != ty) {
+      return 0;
+    }
+  }
+
+  return !more && !next_param(&y, &ty, &oy);
+}
+
+/*
+ * Return the datatype of `op` applied to `left` and `right`.
+ * Mixed integer and double arithmetic is double, as is any
+ * division but '\' of integers; '+' of strings is a string.
+ */
+
+static ifj17_datatype binary_datatype(ifj17_token op, ifj17_datatype left,
+                                      ifj17_datatype right) {
+  switch (op) {
+  case IFJ17_TOKEN_OP_PLUS:
+    if (IFJ17_DATATYPE_STRING == left && IFJ17_DATATYPE_STRING == right)
+      return IFJ17_DATATYPE_STRING;
+    // fall through
+  case IFJ17_TOKEN_OP_MINUS:
+  case IFJ17_TOKEN_OP_MUL:
+    if (!numeric(left) || !numeric(right))
+      return IFJ17_DATATYPE_UNKNOWN;
+    return left == right ? left : IFJ17_DATATYPE_DOUBLE;
+  case IFJ17_TOKEN_OP_DIV:
+    if (!numeric(left) || !numeric(right))
+      return IFJ17_DATATYPE_UNKNOWN;
+    return IFJ17_DATATYPE_DOUBLE;
+  case IFJ17_TOKEN_OP_IDIV:
+    if (IFJ17_DATATYPE_INTEGER != left || IFJ17_DATATYPE_INTEGER != right)
+      return IFJ17_DATATYPE_UNKNOWN;
+    return IFJ17_DATATYPE_INTEGER;
+  case IFJ17_TOKEN_OP_EQ:
+  case IFJ17_TOKEN_OP_NEQ:
+  case IFJ17_TOKEN_OP_LT:
+  case IFJ17_TOKEN_OP_GT:
+  case IFJ17_TOKEN_OP_LTE:
+  case IFJ17_TOKEN_OP_GTE:
+  case IFJ17_TOKEN_OP_AND:
+  case IFJ17_TOKEN_OP_OR:
+  case IFJ17_TOKEN_OP_BIT_AND:
+  case IFJ17_TOKEN_OP_BIT_OR:
+    return IFJ17_DATATYPE_BOOLEAN;
+  case IFJ17_TOKEN_OP_ASSIGN:
+    return left;
+  default:
+    return IFJ17_DATATYPE_UNKNOWN;
+  }
+}
+
+/*
+ * Check the operands of binary `node` once typed: arithmetic
+ * takes numbers, integers for '\' and strings for '+', and
+ * relations compare numbers or values of the same type.
+ */
+
+static void check_operands(ifj17_visitor_t *self, ifj17_binary_op_node_t *node) {
+  ifj17_datatype left = node->left->datatype, right = node->right->datatype;
+
+  if (IFJ17_DATATYPE_UNKNOWN == left || IFJ17_DATATYPE_UNKNOWN == right) {
+    return;
+  }
+
+  switch (node->op) {
+  case IFJ17_TOKEN_OP_PLUS:
+  case IFJ17_TOKEN_OP_MINUS:
+  case IFJ17_TOKEN_OP_MUL:
+  case IFJ17_TOKEN_OP_DIV:
+  case IFJ17_TOKEN_OP_IDIV:
+    if (IFJ17_DATATYPE_UNKNOWN == node->base.datatype) {
+      break;
+    }
+    return;
+  case IFJ17_TOKEN_OP_ASSIGN:
+  case IFJ17_TOKEN_OP_EQ:
+  case IFJ17_TOKEN_OP_NEQ:
+  case IFJ17_TOKEN_OP_LT:
+  case IFJ17_TOKEN_OP_GT:
+  case IFJ17_TOKEN_OP_LTE:
+  case IFJ17_TOKEN_OP_GTE:
+    if (left != right && !(numeric(left) && numeric(right))) {
+      break;
+    }
+    return;
+  default:
+    return;
+  }
+
+  error(self, IFJ17_SEMANTIC_TYPE, node->base.lineno,
+        "invalid operands to '%s', %s and %s", ifj17_token_type_string(node->op),
+        datatype_names[left], datatype_names[right]);
+}
+
+/*
+ * Declare variable `id` of `type` in the current scope,
+ * in the next slot of the function.
+ */
+
+static void declare(ifj17_visitor_t *self, ifj17_id_node_t *id,
+                    ifj17_datatype type) {
+  ifj17_symbol_t *sym = ifj17_symtab_lookup(&sem->symtab, id->name);
+
+  if (sym && (IFJ17_SYMBOL_FUNCTION == sym->kind ||
+              sym->depth == sem->symtab.scope->depth)) {
+    error(self, IFJ17_SEMANTIC_UNDEFINED, id->base.lineno, "redefinition of '%s'",
+          id->name->val);
+    return;
+  }
+
+  sym = ifj17_symtab_define(&sem->symtab, id->name, IFJ17_SYMBOL_VARIABLE,
+                            (ifj17_node_t *)id);
+  if (unlikely(!sym)) {
+    error(self, IFJ17_SEMANTIC_INTERNAL, id->base.lineno, "out of memory");
+    return;
+  }
+
+  sym->datatype = type;
+  sym->slot = sem->nslots++;
+  sym->defined = 1;
+  id->slot = sym->slot;
+  id->base.datatype = type;
+}
+
+/*
+ * Check `value` can be stored in a variable of `type`.
+ */
+
+static void check_assign(ifj17_visitor_t *self, ifj17_datatype type,
+                         ifj17_node_t *value) {
+  if (!assignable(type, value->datatype)) {
+    error(self, IFJ17_SEMANTIC_TYPE, value->lineno, "cannot assign %s to %s",
+          datatype_names[value->datatype], datatype_names[type]);
+  }
+}
+
+/*
+ * Visit block `node`.
+ */
+
+static void visit_block(ifj17_visitor_t *self, ifj17_block_node_t *node) {
+  ifj17_node_vec_each(node->stmts, {
+    if (sem->error) {
+      return;
+    }
+    visit(val);
+  });
+}
+
+/*
+ * Visit int `node`.
+ */
+
+static void visit_int(ifj17_visitor_t *self, ifj17_int_node_t *node) {
+  node->base.datatype = IFJ17_DATATYPE_INTEGER;
+}
+
+/*
+ * Visit double `node`.
+ */
+
+static void visit_double(ifj17_visitor_t *self, ifj17_double_node_t *node) {
+  node->base.datatype = IFJ17_DATATYPE_DOUBLE;
+}
+
+/*
+ * Visit string `node`.
+ */
+
+static void visit_string(ifj17_visitor_t *self, ifj17_string_node_t *node) {
+  node->base.datatype = IFJ17_DATATYPE_STRING;
+}
+
+/*
+ * Visit id `node`, resolving it to its variable.
+ */
+
+static void visit_id(ifj17_visitor_t *self, ifj17_id_node_t *node) {
+  ifj17_symbol_t *sym = ifj17_symtab_lookup(&sem->symtab, node->name);
+
+  if (!sym) {
+    error(self, IFJ17_SEMANTIC_UNDEFINED, node->base.lineno,
+          "undefined variable '%s'", node->name->val);
+  } else if (IFJ17_SYMBOL_FUNCTION == sym->kind) {
+    error(self, IFJ17_SEMANTIC_UNDEFINED, node->base.lineno,
+          "function '%s' used as a variable", node->name->val);
+  } else {
+    node->slot = sym->slot;
+    node->base.datatype = sym->datatype;
+  }
+}
+
+/*
+ * Visit decl `node`, declaring its names.
+ */
+
+static void visit_decl(ifj17_visitor_t *self, ifj17_decl_node_t *node) {
+  ifj17_datatype type = ifj17_datatype_of(node->type);
+
+  ifj17_node_vec_each(node->vec, { declare(self, (ifj17_id_node_t *)val, type); });
+}
+
+/*
+ * Visit dim `node`, typing initial values before their
+ * names come into scope.
+ */
+
+static void visit_dim(ifj17_visitor_t *self, ifj17_dim_node_t *node) {
+  ifj17_node_vec_each(node->vec, {
+    ifj17_binary_op_node_t *init = (ifj17_binary_op_node_t *)val;
+    if (IFJ17_NODE_BINARY_OP != val->type) {
+      visit(val);
+    } else if (init->right) {
+      visit(init->right);
+      visit(init->left);
+      check_assign(self, init->left->datatype, init->right);
+    } else {
+      visit(init->left);
+    }
+  });
+}
+
+/*
+ * Visit unary op `node`.
+ */
+
+static void visit_unary_op(ifj17_visitor_t *self, ifj17_unary_op_node_t *node) {
+  if (!node->expr) {
+    return;
+  }
+
+  visit(node->expr);
+  if (IFJ17_TOKEN_OP_LNOT == node->op || IFJ17_TOKEN_OP_NOT == node->op) {
+    node->base.datatype = IFJ17_DATATYPE_BOOLEAN;
+  } else if (numeric(node->expr->datatype)) {
+    node->base.datatype = node->expr->datatype;
+  } else if (IFJ17_DATATYPE_UNKNOWN != node->expr->datatype) {
+    error(self, IFJ17_SEMANTIC_TYPE, node->base.lineno,
+          "invalid operand to '%s', %s", ifj17_token_type_string(node->op),
+          datatype_names[node->expr->datatype]);
+  }
+}
+
+/*
+ * Visit binary op `node`. '=' assigns as a statement and
+ * compares within conditions.
+ */
+
+static void visit_binary_op(ifj17_visitor_t *self, ifj17_binary_op_node_t *node) {
+  if (!node->left) {
+    return;
+  }
+
+  visit(node->left);
+  if (!node->right) {
+    node->base.datatype = node->left->datatype;
+    return;
+  }
+  visit(node->right);
+
+  node->base.datatype =
+      binary_datatype(node->op, node->left->datatype, node->right->datatype);
+
+  if (IFJ17_TOKEN_OP_ASSIGN == node->op && !sem->cond) {
+    check_assign(self, node->left->datatype, node->right);
+  } else {
+    check_operands(self, node);
+  }
+}
+
+/*
+ * Visit call `node`, resolving the function, checking its
+ * arguments and typing it by the function's result.
+ */
+
+static void visit_call(ifj17_visitor_t *self, ifj17_call_node_t *node) {
+  ifj17_node_vec_t *args = node->args->vec;
+  ifj17_node_vec_each(args, { visit(val); });
+
+  if (IFJ17_NODE_ID != node->expr->type) {
+    error(self, IFJ17_SEMANTIC_OTHER, node->base.lineno, "call of a non-function");
+    return;
+  }
+
+  ifj17_id_node_t *id = (ifj17_id_node_t *)node->expr;
+  ifj17_symbol_t *sym = ifj17_symtab_lookup(&sem->symtab, id->name);
+  if (!sym || IFJ17_SYMBOL_FUNCTION != sym->kind) {
+    error(self, IFJ17_SEMANTIC_UNDEFINED, node->base.lineno,
+          "undefined function '%s'", id->name->val);
+    return;
+  }
+
+  // arguments
+  params_t it = {params_of(sym), 0, 0};
+  ifj17_datatype type;
+  int nargs = ifj17_node_vec_length(args), n = 0, required = 0, optional;
+  while (next_param(&it, &type, &optional)) {
+    if (!optional) {
+      required = n + 1;
+    }
+    if (n < nargs && !assignable(type, ifj17_node_vec_at(args, n)->datatype)) {
+      error(self, IFJ17_SEMANTIC_TYPE, node->base.lineno,
+            "argument %d of '%s' is %s, not %s", n + 1, id->name->val,
+            datatype_names[ifj17_node_vec_at(args, n)->datatype],
+            datatype_names[type]);
+    }
+    ++n;
+  }
+
+  if (nargs < required || nargs > n) {
+    error(self, IFJ17_SEMANTIC_TYPE, node->base.lineno,
+          "'%s' takes %d arguments, not %d", id->name->val, n, nargs);
+  }
+
+  node->base.datatype = sym->datatype;
+  node->callee = sym->decl;
+}
+
+/*
+ * Visit scope `node`, with variables of its own.
+ */
+
+static void visit_scope(ifj17_visitor_t *self, ifj17_scope_node_t *node) {
+  ifj17_scope_t scope;
+
+  sem->nslots = 0;
+  ifj17_symtab_push(&sem->symtab, &scope);
+  visit((ifj17_node_t *)node->block);
+  ifj17_symtab_pop(&sem->symtab);
+  node->nslots = sem->nslots;
+}
+
+/*
+ * Visit declare `node`, registered up front.
+ */
+
+static void visit_declare(ifj17_visitor_t *self, ifj17_declare_node_t *node) {
+  if (sem->symtab.scope->parent) {
+    error(self, IFJ17_SEMANTIC_OTHER, node->base.lineno,
+          "declaration of '%s' within a block", node->name->val);
+  }
+}
+
+/*
+ * Visit function `node`, with its params and variables of its own.
+ */
+
+static void visit_function(ifj17_visitor_t *self, ifj17_function_node_t *node) {
+  ifj17_scope_t scope;
+
+  if (sem->symtab.scope->parent) {
+    error(self, IFJ17_SEMANTIC_OTHER, node->base.lineno,
+          "definition of '%s' within a block", node->name->val);
+    return;
+  }
+
+  sem->func = ifj17_symtab_lookup(&sem->symtab, node->name);
+  sem->nslots = 0;
+  ifj17_symtab_push(&sem->symtab, &scope);
+
+  ifj17_node_vec_each(node->params, {
+    if (IFJ17_NODE_BINARY_OP == val->type) {
+      ifj17_binary_op_node_t *param = (ifj17_binary_op_node_t *)val;
+      if (param->right) {
+        visit(param->right);
+      }
+    }
+    visit((ifj17_node_t *)param_decl(val));
+  });
+  visit((ifj17_node_t *)node->block);
+
+  ifj17_symtab_pop(&sem->symtab);
+  node->nslots = sem->nslots;
+  sem->func = NULL;
+}
+
+/*
+ * Visit condition `node`, where '=' compares.
+ */
+
+static void visit_cond(ifj17_visitor_t *self, ifj17_node_t *node) {
+  sem->cond = 1;
+  visit(node);
+  sem->cond = 0;
+}
+
+/*
+ * Visit the body `block` of an if or loop, in a scope of its
+ * own: its variables are declared on its path only.
+ */
+
+static void visit_body(ifj17_visitor_t *self, ifj17_block_node_t *block) {
+  ifj17_scope_t scope;
+
+  ifj17_symtab_push(&sem->symtab, &scope);
+  visit((ifj17_node_t *)block);
+  ifj17_symtab_pop(&sem->symtab);
+}
+
+/*
+ * Visit `while` node.
+ */
+
+static void visit_while(ifj17_visitor_t *self, ifj17_while_node_t *node) {
+  visit_cond(self, node->expr);
+  visit_body(self, node->block);
+}
+
+/*
+ * Visit `return` node, checking it against the function's result.
+ */
+
+static void visit_return(ifj17_visitor_t *self, ifj17_return_node_t *node) {
+  if (node->expr) {
+    visit(node->expr);
+  }
+
+  if (!sem->func) {
+    error(self, IFJ17_SEMANTIC_OTHER, node->base.lineno,
+          "return outside of a function");
+  } else if (node->expr && !assignable(sem->func->datatype, node->expr->datatype)) {
+    error(self, IFJ17_SEMANTIC_TYPE, node->base.lineno, "cannot return %s as %s",
+          datatype_names[node->expr->datatype], datatype_names[sem->func->datatype]);
+  }
+}
+
+/*
+ * Visit if `node`.
+ */
+
+static void visit_if(ifj17_visitor_t *self, ifj17_if_node_t *node) {
+  visit_cond(self, node->expr);
+  visit_body(self, node->block);
+
+  ifj17_node_vec_each(node->else_ifs, { visit(val); });
+
+  if (node->else_block) {
+    visit_body(self, node->else_block);
+  }
+}
+
+/*
+ * Visit print `node`.
+ */
+
+static void visit_print(ifj17_visitor_t *self, ifj17_print_node_t *node) {
+  ifj17_node_vec_each(node->params, { visit(val); });
+}
+
+/*
+ * Visit input `node`.
+ */
+
+static void visit_input(ifj17_visitor_t *self, ifj17_input_node_t *node) {
+  visit(node->param);
+}
+
+/*
+ * Register the top-level function `node`, declared or defined,
+ * so calls can precede definitions.
+ */
+
+static void register_function(ifj17_visitor_t *self, ifj17_node_t *node) {
+  ifj17_string_t *name;
+  ifj17_node_t *type;
+  ifj17_node_vec_t *params;
+  int defined = IFJ17_NODE_FUNCTION == node->type;
+
+  if (defined) {
+    ifj17_function_node_t *func = (ifj17_function_node_t *)node;
+    name = func->name, type = func->type, params = func->params;
+  } else {
+    ifj17_declare_node_t *decl = (ifj17_declare_node_t *)node;
+    name = decl->name, type = decl->type, params = decl->params;
+  }
+
+  ifj17_symbol_t *sym = ifj17_symtab_lookup(&sem->symtab, name);
+
+  // first declaration or definition
+  if (!sym) {
+    sym = ifj17_symtab_define(&sem->symtab, name, IFJ17_SYMBOL_FUNCTION, node);
+    if (unlikely(!sym)) {
+      error(self, IFJ17_SEMANTIC_INTERNAL, node->lineno, "out of memory");
+      return;
+    }
+    sym->datatype = ifj17_datatype_of(type);
+    sym->defined = defined;
+    return;
+  }
+
+  if (!defined || sym->defined) {
+    error(self, IFJ17_SEMANTIC_UNDEFINED, node->lineno, "redefinition of '%s'",
+          name->val);
+    return;
+  }
+
+  // definition of a declared function
+  if (sym->datatype != ifj17_datatype_of(type) ||
+      !same_params(params_of(sym), params)) {
+    error(self, IFJ17_SEMANTIC_UNDEFINED, node->lineno,
+          "definition of '%s' differs from its declaration", name->val);
+    return;
+  }
+
+  sym->decl = node;
+  sym->defined = 1;
+}
+
+/*
+ * Analyze the program `node`: resolve every name to its
+ * declaration in the innermost block declaring it, if and
+ * loop bodies included, number the locals of each function
+ * and scope, annotate expressions with their static types
+ * and check them. Return 0 on error, kept in `self`.
+ */
+
+int ifj17_analyze(ifj17_semantic_t *context, ifj17_node_t *node) {
+  ifj17_visitor_t visitor = {.data = (void *)context,
+                             .visit_if = visit_if,
+                             .visit_id = visit_id,
+                             .visit_int = visit_int,
+                             .visit_call = visit_call,
+                             .visit_while = visit_while,
+                             .visit_block = visit_block,
+                             .visit_dim = visit_dim,
+                             .visit_decl = visit_decl,
+                             .visit_double = visit_double,
+                             .visit_string = visit_string,
+                             .visit_return = visit_return,
+                             .visit_declare = visit_declare,
+                             .visit_function = visit_function,
+                             .visit_scope = visit_scope,
+                             .visit_print = visit_print,
+                             .visit_input = visit_input,
+                             .visit_unary_op = visit_unary_op,
+                             .visit_binary_op = visit_binary_op};
+  ifj17_visitor_t *self = &visitor;
+  ifj17_scope_t global;
+
+  if (unlikely(!ifj17_symtab_init(&sem->symtab, &sem->state->arena))) {
+    sem->error = IFJ17_SEMANTIC_INTERNAL;
+    sem->msg = "out of memory";
+    return 0;
+  }
+
+  ifj17_symtab_push(&sem->symtab, &global);
+
+  if (IFJ17_NODE_BLOCK == node->type) {
+    ifj17_node_vec_each(((ifj17_block_node_t *)node)->stmts, {
+      if (IFJ17_NODE_FUNCTION == val->type || IFJ17_NODE_DECLARE == val->type) {
+        register_function(self, val);
+      }
+    });
+  }
+
+  visit(node);
+
+  // declared functions are defined
+  for (ifj17_symbol_t *sym = global.symbols; sym; sym = sym->next) {
+    if (!sym->defined) {
+      error(self, IFJ17_SEMANTIC_UNDEFINED, sym->decl->lineno,
+            "function '%s' is declared but not defined", sym->name->val);
+    }
+  }
+
+  ifj17_symtab_pop(&sem->symtab);
+  ifj17_symtab_free(&sem->symtab);
+  return !sem->error;
+}
+
+/*
+ * Initialize the analysis of a program parsed with `state`.
+ */
+
+void ifj17_semantic_init(ifj17_semantic_t *self, ifj17_state_t *state) {
+  self->state = state;
+  self->func = NULL;
+  self->nslots = 0;
+  self->cond = 0;
+  self->error = IFJ17_SEMANTIC_OK;
+  self->lineno = 0;
+  self->ctx = "scope";
+  self->msg = NULL;
+}
+
+/*
+ * Report the semantic error of the program from `filename`.
+ */
+
+void ifj17_semantic_report(ifj17_semantic_t *self, const char *filename) {
+  const char *type = IFJ17_SEMANTIC_TYPE == self->error ? "type" : "semantic";
+
+  if (IFJ17_SEMANTIC_INTERNAL == self->error) {
+    fprintf(stderr, "%s\n", self->msg);
+    return;
+  }
+
+  fprintf(stderr, "ifj17(%s:%d). %s error in %s, %s.\n", filename, self->lineno,
+          type, self->ctx, self->msg);
+}
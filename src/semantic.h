@@ -0,0 +1,56 @@
+//
+// semantic.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_SEMANTIC_H
+#define IFJ17_SEMANTIC_H
+
+#include "ast.h"
+#include "state.h"
+#include "symtab.h"
+
+/*
+ * Semantic errors, by the exit status they are reported with.
+ */
+
+typedef enum {
+  IFJ17_SEMANTIC_OK = 0,
+  IFJ17_SEMANTIC_UNDEFINED = 3,
+  IFJ17_SEMANTIC_TYPE = 4,
+  IFJ17_SEMANTIC_OTHER = 6,
+  IFJ17_SEMANTIC_INTERNAL = 99,
+} ifj17_semantic_error;
+
+/*
+ * Semantic analysis.
+ *
+ * Resolves names through the symbol table, numbers the
+ * locals of each function and scope, types expressions and
+ * keeps the first error: its status, line, context and message.
+ */
+
+typedef struct {
+  ifj17_state_t *state;
+  ifj17_symtab_t symtab;
+  ifj17_symbol_t *func;
+  int nslots;
+  int cond;
+  ifj17_semantic_error error;
+  int lineno;
+  const char *ctx;
+  const char *msg;
+} ifj17_semantic_t;
+
+// prototypes
+
+ifj17_datatype ifj17_datatype_of(ifj17_node_t *type);
+
+void ifj17_semantic_init(ifj17_semantic_t *self, ifj17_state_t *state);
+
+int ifj17_analyze(ifj17_semantic_t *self, ifj17_node_t *node);
+
+void ifj17_semantic_report(ifj17_semantic_t *self, const char *filename);
+
+#endif /* IFJ17_SEMANTIC_H */
@@ -0,0 +1,177 @@
+//
+// simd.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#include "simd.h"
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define IFJ17_SIMD_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * Scalar fallback.
+ */
+
+static const char *scalar_blanks(const char *str) {
+  while (' ' == *str || '\t' == *str)
+    ++str;
+  return str;
+}
+
+static const char *scalar_ident(const char *str) {
+  while (isalpha(*str) || isdigit(*str) || '_' == *str)
+    ++str;
+  return str;
+}
+
+static const char *scalar_digits(const char *str) {
+  while (isdigit(*str))
+    ++str;
+  return str;
+}
+
+static const char *scalar_line(const char *str) {
+  while ('\n' != *str && *str)
+    ++str;
+  return str;
+}
+
+static const char *scalar_quote(const char *str) {
+  while ('\'' != *str && *str)
+    ++str;
+  return str;
+}
+
+static const ifj17_simd_t scalar = {"scalar",      scalar_blanks, scalar_ident,
+                                    scalar_digits, scalar_line,   scalar_quote};
+
+#ifdef IFJ17_SIMD_X86
+
+/*
+ * Define `isa`_`name`, returning the first byte of `str` flagged by
+ * the `stop` bitmask. Loads are aligned to `width`, so they never
+ * cross into a page the nul terminator does not live on; bytes of
+ * the first block preceding `str` are masked out.
+ */
+
+#define span(isa, name, width, vec, load, stop)                                     \
+  static target_##isa const char *isa##_##name(const char *str) {                   \
+    const char *p = (const char *)((uintptr_t)str & ~(uintptr_t)(width - 1));       \
+    uint32_t m = stop(load((const vec *)p)) & ~0u << (str - p);                     \
+    while (!m) {                                                                    \
+      p += width;                                                                   \
+      m = stop(load((const vec *)p));                                               \
+    }                                                                               \
+    return p + __builtin_ctz(m);                                                    \
+  }
+
+/*
+ * Define the five `isa` spans and their table.
+ */
+
+#define spans(isa, width, vec, load)                                                \
+  span(isa, blanks, width, vec, load, isa##_stop_blanks)                            \
+  span(isa, ident, width, vec, load, isa##_stop_ident)                              \
+  span(isa, digits, width, vec, load, isa##_stop_digits)                            \
+  span(isa, line, width, vec, load, isa##_stop_line)                                \
+  span(isa, quote, width, vec, load, isa##_stop_quote)                              \
+  static const ifj17_simd_t isa##_simd = {#isa,          isa##_blanks,              \
+                                          isa##_ident,   isa##_digits,              \
+                                          isa##_line,    isa##_quote};
+
+/*
+ * SSE2, 16 bytes at a time.
+ */
+
+#define target_sse2 __attribute__((target("sse2")))
+
+#define sse2_eq(v, c) _mm_cmpeq_epi8(v, _mm_set1_epi8(c))
+#define sse2_or _mm_or_si128
+#define sse2_range(v, lo, hi)                                                       \
+  _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8((lo)-1)),                           \
+                _mm_cmpgt_epi8(_mm_set1_epi8((hi) + 1), v))
+#define sse2_mask(v) ((uint32_t)_mm_movemask_epi8(v))
+#define sse2_not(v) (~sse2_mask(v) & 0xffff)
+
+#define sse2_stop_blanks(v) sse2_not(sse2_or(sse2_eq(v, ' '), sse2_eq(v, '\t')))
+#define sse2_stop_digits(v) sse2_not(sse2_range(v, '0', '9'))
+#define sse2_stop_line(v) sse2_mask(sse2_or(sse2_eq(v, '\n'), sse2_eq(v, 0)))
+#define sse2_stop_quote(v) sse2_mask(sse2_or(sse2_eq(v, '\''), sse2_eq(v, 0)))
+#define sse2_stop_ident(v)                                                          \
+  sse2_not(sse2_or(sse2_or(sse2_range(sse2_or(v, _mm_set1_epi8(0x20)), 'a', 'z'),   \
+                           sse2_range(v, '0', '9')),                                \
+                   sse2_eq(v, '_')))
+
+spans(sse2, 16, __m128i, _mm_load_si128)
+
+/*
+ * AVX2, 32 bytes at a time.
+ */
+
+#define target_avx2 __attribute__((target("avx2")))
+
+#define avx2_eq(v, c) _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c))
+#define avx2_or _mm256_or_si256
+#define avx2_range(v, lo, hi)                                                       \
+  _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8((lo)-1)),                  \
+                   _mm256_cmpgt_epi8(_mm256_set1_epi8((hi) + 1), v))
+#define avx2_mask(v) ((uint32_t)_mm256_movemask_epi8(v))
+#define avx2_not(v) (~avx2_mask(v))
+
+#define avx2_stop_blanks(v) avx2_not(avx2_or(avx2_eq(v, ' '), avx2_eq(v, '\t')))
+#define avx2_stop_digits(v) avx2_not(avx2_range(v, '0', '9'))
+#define avx2_stop_line(v) avx2_mask(avx2_or(avx2_eq(v, '\n'), avx2_eq(v, 0)))
+#define avx2_stop_quote(v) avx2_mask(avx2_or(avx2_eq(v, '\''), avx2_eq(v, 0)))
+#define avx2_stop_ident(v)                                                          \
+  avx2_not(                                                                         \
+      avx2_or(avx2_or(avx2_range(avx2_or(v, _mm256_set1_epi8(0x20)), 'a', 'z'),     \
+                      avx2_range(v, '0', '9')),                                     \
+              avx2_eq(v, '_')))
+
+spans(avx2, 32, __m256i, _mm256_load_si256)
+
+#endif
+
+/*
+ * Return the fast paths for `level`, or NULL
+ * when the CPU does not support it.
+ */
+
+const ifj17_simd_t *ifj17_simd(ifj17_simd_level level) {
+  switch (level) {
+  case IFJ17_SIMD_SCALAR:
+    return &scalar;
+#ifdef IFJ17_SIMD_X86
+  case IFJ17_SIMD_SSE2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2") ? &sse2_simd : NULL;
+  case IFJ17_SIMD_AVX2:
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? &avx2_simd : NULL;
+#endif
+  default:
+    return NULL;
+  }
+}
+
+/*
+ * Return the best fast paths the CPU supports.
+ */
+
+const ifj17_simd_t *ifj17_simd_best() {
+  const ifj17_simd_t *simd;
+
+  for (int level = IFJ17_SIMD_AVX2; level > IFJ17_SIMD_SCALAR; --level) {
+    if ((simd = ifj17_simd(level))) {
+      return simd;
+    }
+  }
+
+  return &scalar;
+}
@@ -0,0 +1,46 @@
+//
+// simd.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_SIMD_H
+#define IFJ17_SIMD_H
+
+/*
+ * Instruction set levels, best last.
+ */
+
+typedef enum {
+  IFJ17_SIMD_SCALAR,
+  IFJ17_SIMD_SSE2,
+  IFJ17_SIMD_AVX2,
+} ifj17_simd_level;
+
+/*
+ * Lexer fast paths. Each returns the end of the run
+ * starting at `str`, and never reads past the aligned
+ * block holding the source's nul terminator.
+ */
+
+typedef struct {
+  const char *name;
+  // first byte other than ' ' or '\t'
+  const char *(*blanks)(const char *str);
+  // first byte other than [A-Za-z0-9_]
+  const char *(*ident)(const char *str);
+  // first byte other than [0-9]
+  const char *(*digits)(const char *str);
+  // first '\n' or nul
+  const char *(*line)(const char *str);
+  // first '\'' or nul
+  const char *(*quote)(const char *str);
+} ifj17_simd_t;
+
+// prototypes
+
+const ifj17_simd_t *ifj17_simd(ifj17_simd_level level);
+
+const ifj17_simd_t *ifj17_simd_best();
+
+#endif /* IFJ17_SIMD_H */
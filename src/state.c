@@ -5,11 +5,40 @@
 //
 
 #include "state.h"
+#include <stdio.h>
 
 /*
  * Initialize ifj17 state:
  *
  *   - initialize string vector
+ *   - initialize compilation arena
  */
 
-void ifj17_state_init(ifj17_state_t *self) { self->strs = kh_init(str); }
+void ifj17_state_init(ifj17_state_t *self) {
+  self->strs = kh_init(str);
+  self->nidents = 0;
+  self->nidents_unique = 0;
+  self->nstrings = 0;
+  ifj17_arena_init(&self->arena);
+}
+
+/*
+ * Release ifj17 state, including every node,
+ * vector and string allocated by the compilation.
+ */
+
+void ifj17_state_free(ifj17_state_t *self) {
+  kh_destroy(str, self->strs);
+  ifj17_arena_release(&self->arena);
+}
+
+/*
+ * Output interning statistics to stderr.
+ */
+
+void ifj17_state_inspect(ifj17_state_t *self) {
+  fprintf(stderr, "identifiers: %zu unique of %zu\n", self->nidents_unique,
+          self->nidents);
+  fprintf(stderr, "strings: %u interned, %zu literals\n", kh_size(self->strs),
+          self->nstrings);
+}
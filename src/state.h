@@ -7,16 +7,28 @@
 #ifndef IFJ17_STATE_H
 #define IFJ17_STATE_H
 
+#include "arena.h"
 #include "khash.h"
 
-// TODO: move
+/*
+ * Interned string, unique per compilation for its bytes,
+ * so strings compare by pointer and hash only once.
+ */
 
 typedef struct {
   int len;
-  char *val;
+  unsigned int hash;
+  int ident;
+  char val[];
 } ifj17_string_t;
 
-KHASH_MAP_INIT_STR(str, ifj17_string_t *);
+#define ifj17_string_hash(self) ((self)->hash)
+
+#define ifj17_string_equal(a, b)                                                    \
+  ((a)->hash == (b)->hash && (a)->len == (b)->len &&                                \
+   !memcmp((a)->val, (b)->val, (a)->len))
+
+KHASH_INIT(str, ifj17_string_t *, char, 0, ifj17_string_hash, ifj17_string_equal);
 
 /*
  * IFJ17 state.
@@ -24,14 +36,26 @@ KHASH_MAP_INIT_STR(str, ifj17_string_t *);
 
 typedef struct {
   khash_t(str) * strs;
+  size_t nidents;
+  size_t nidents_unique;
+  size_t nstrings;
+  ifj17_arena_t arena;
 } ifj17_state_t;
 
 // prototypes
 
 void ifj17_state_init(ifj17_state_t *self);
 
+void ifj17_state_free(ifj17_state_t *self);
+
+void ifj17_state_inspect(ifj17_state_t *self);
+
 // TODO: move
 
-ifj17_string_t *ifj17_string(ifj17_state_t *state, char *val);
+ifj17_string_t *ifj17_string(ifj17_state_t *state, const char *val);
+
+ifj17_string_t *ifj17_string_intern(ifj17_state_t *state, const char *str, int len);
+
+ifj17_string_t *ifj17_identifier(ifj17_state_t *state, const char *str, int len);
 
 #endif /* IFJ17_STATE_H */
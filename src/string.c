@@ -4,36 +4,109 @@
 // Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
 //
 
+#include "internal.h"
 #include "state.h"
+#include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 
 /*
- * Return a new ifj17_string_t for the given `val`,
- * allocating space in the strings hash unless present,
- * or NULL on failure.
+ * Intern the string being built in `self`, returning the
+ * existing copy and giving `self` back to the arena when
+ * already present, or NULL on failure.
  */
 
-ifj17_string_t *ifj17_string(ifj17_state_t *state, char *val) {
-  khiter_t k = kh_get(str, state->strs, val);
+static ifj17_string_t *intern(ifj17_state_t *state, ifj17_string_t *self) {
+  int ret;
+
+  // FNV-1a, as sequential names cluster with x31
+  unsigned int hash = 2166136261u;
+  for (int i = 0; i < self->len; ++i) {
+    hash = (hash ^ (unsigned char)self->val[i]) * 16777619u;
+  }
+
+  self->hash = hash;
+  self->ident = 0;
+  self->val[self->len] = 0;
+
+  khiter_t k = kh_put(str, state->strs, self, &ret);
+  if (unlikely(ret < 0)) {
+    return NULL;
+  }
 
   // exists
-  int exists = kh_size(state->strs) && kh_exist(state->strs, k);
-  if (exists) {
-    return kh_value(state->strs, k);
+  if (!ret) {
+    ifj17_arena_pop(&state->arena, self);
+    return kh_key(state->strs, k);
   }
 
-  // alloc
-  int ret;
-  ifj17_string_t *self = calloc(1, sizeof(ifj17_string_t));
-  self->len = strlen(val);
-  self->val = malloc(self->len + 1);
-  if (!self->val) {
+  return self;
+}
+
+/*
+ * Allocate room for a string of `len` bytes.
+ */
+
+static ifj17_string_t *string_alloc(ifj17_state_t *state, int len) {
+  ifj17_string_t *self =
+      ifj17_arena_alloc(&state->arena, sizeof(ifj17_string_t) + len + 1);
+  if (unlikely(!self)) {
     return NULL;
   }
-  memcpy(self->val, val, self->len);
-  self->val[self->len] = 0;
-  k = kh_put(str, state->strs, val, &ret);
 
-  return kh_value(state->strs, k) = self;
+  self->len = len;
+  return self;
+}
+
+/*
+ * Return the interned string for the `len` bytes of `str`,
+ * or NULL on failure.
+ */
+
+ifj17_string_t *ifj17_string_intern(ifj17_state_t *state, const char *str, int len) {
+  ifj17_string_t *self = string_alloc(state, len);
+  if (unlikely(!self)) {
+    return NULL;
+  }
+
+  memcpy(self->val, str, len);
+  state->nstrings++;
+  return intern(state, self);
+}
+
+/*
+ * Return the interned, lower-cased identifier for the
+ * `len` bytes of `str`, or NULL on failure.
+ */
+
+ifj17_string_t *ifj17_identifier(ifj17_state_t *state, const char *str, int len) {
+  ifj17_string_t *self = string_alloc(state, len);
+  if (unlikely(!self)) {
+    return NULL;
+  }
+
+  for (int i = 0; i < len; ++i) {
+    self->val[i] = tolower(str[i]);
+  }
+
+  if (unlikely(!(self = intern(state, self)))) {
+    return NULL;
+  }
+
+  state->nidents++;
+  if (!self->ident) {
+    self->ident = 1;
+    state->nidents_unique++;
+  }
+
+  return self;
+}
+
+/*
+ * Return the interned string for the given `val`,
+ * or NULL on failure.
+ */
+
+ifj17_string_t *ifj17_string(ifj17_state_t *state, const char *val) {
+  return ifj17_string_intern(state, val, strlen(val));
 }
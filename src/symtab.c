@@ -0,0 +1,146 @@
+//
+// symtab.c
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#include "symtab.h"
+#include "internal.h"
+#include <stdlib.h>
+
+/*
+ * Return the bucket of `name` in `buckets`, or the empty
+ * bucket it belongs in.
+ */
+
+static ifj17_symtab_bucket_t *find(ifj17_symtab_bucket_t *buckets, int nbuckets,
+                                   ifj17_string_t *name) {
+  unsigned int mask = nbuckets - 1;
+  unsigned int i = ifj17_string_hash(name) & mask;
+
+  while (buckets[i].name && buckets[i].name != name) {
+    i = (i + 1) & mask;
+  }
+
+  return &buckets[i];
+}
+
+/*
+ * Double the buckets, dropping names no longer in scope.
+ * Return 0 on failure.
+ */
+
+static int grow(ifj17_symtab_t *self) {
+  int nbuckets = self->nbuckets * 2;
+  ifj17_symtab_bucket_t *buckets = calloc(nbuckets, sizeof(ifj17_symtab_bucket_t));
+  if (unlikely(!buckets)) {
+    return 0;
+  }
+
+  self->nnames = 0;
+  for (int i = 0; i < self->nbuckets; ++i) {
+    if (self->buckets[i].sym) {
+      *find(buckets, nbuckets, self->buckets[i].name) = self->buckets[i];
+      self->nnames++;
+    }
+  }
+
+  free(self->buckets);
+  self->buckets = buckets;
+  self->nbuckets = nbuckets;
+  return 1;
+}
+
+/*
+ * Initialize the symbol table with symbols allocated
+ * from `arena`. Return 0 on failure.
+ */
+
+int ifj17_symtab_init(ifj17_symtab_t *self, ifj17_arena_t *arena) {
+  self->arena = arena;
+  self->scope = NULL;
+  self->nbuckets = IFJ17_SYMTAB_SIZE;
+  self->nnames = 0;
+  self->nsymbols = 0;
+  self->buckets = calloc(self->nbuckets, sizeof(ifj17_symtab_bucket_t));
+  return NULL != self->buckets;
+}
+
+/*
+ * Free the buckets; the symbols live as long as the arena.
+ */
+
+void ifj17_symtab_free(ifj17_symtab_t *self) {
+  free(self->buckets);
+  self->buckets = NULL;
+}
+
+/*
+ * Enter `scope`, nested in the current one.
+ */
+
+void ifj17_symtab_push(ifj17_symtab_t *self, ifj17_scope_t *scope) {
+  scope->parent = self->scope;
+  scope->symbols = NULL;
+  scope->depth = self->scope ? self->scope->depth + 1 : 0;
+  self->scope = scope;
+}
+
+/*
+ * Leave the current scope, uncovering the symbols its own shadowed.
+ */
+
+void ifj17_symtab_pop(ifj17_symtab_t *self) {
+  for (ifj17_symbol_t *sym = self->scope->symbols; sym; sym = sym->next) {
+    find(self->buckets, self->nbuckets, sym->name)->sym = sym->shadowed;
+  }
+  self->scope = self->scope->parent;
+}
+
+/*
+ * Return the innermost symbol of `name` in scope, or NULL.
+ */
+
+ifj17_symbol_t *ifj17_symtab_lookup(ifj17_symtab_t *self, ifj17_string_t *name) {
+  return find(self->buckets, self->nbuckets, name)->sym;
+}
+
+/*
+ * Define `name` of `kind`, declared by `decl`, in the current
+ * scope, shadowing any outer symbol of that name. Return the
+ * symbol or NULL on failure.
+ */
+
+ifj17_symbol_t *ifj17_symtab_define(ifj17_symtab_t *self, ifj17_string_t *name,
+                                    ifj17_symbol_kind kind, ifj17_node_t *decl) {
+  // keep the load under 3/4
+  if (4 * (self->nnames + 1) > 3 * self->nbuckets && unlikely(!grow(self))) {
+    return NULL;
+  }
+
+  ifj17_symbol_t *sym = ifj17_arena_alloc(self->arena, sizeof(ifj17_symbol_t));
+  if (unlikely(!sym)) {
+    return NULL;
+  }
+
+  ifj17_symtab_bucket_t *bucket = find(self->buckets, self->nbuckets, name);
+  if (!bucket->name) {
+    bucket->name = name;
+    self->nnames++;
+  }
+
+  sym->name = name;
+  sym->kind = kind;
+  sym->datatype = IFJ17_DATATYPE_UNKNOWN;
+  sym->depth = self->scope->depth;
+  sym->slot = -1;
+  sym->defined = 0;
+  sym->decl = decl;
+  sym->shadowed = bucket->sym;
+  sym->next = self->scope->symbols;
+  self->scope->symbols = sym;
+  bucket->sym = sym;
+  self->nsymbols++;
+
+  return sym;
+}
@@ -0,0 +1,99 @@
+//
+// symtab.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_SYMTAB_H
+#define IFJ17_SYMTAB_H
+
+#include "ast.h"
+#include "state.h"
+
+// Initial bucket count, a power of two
+#ifndef IFJ17_SYMTAB_SIZE
+#define IFJ17_SYMTAB_SIZE 64
+#endif
+
+/*
+ * Symbol kinds.
+ */
+
+typedef enum { IFJ17_SYMBOL_VARIABLE, IFJ17_SYMBOL_FUNCTION } ifj17_symbol_kind;
+
+/*
+ * IFJ17 symbol.
+ *
+ * `decl` is the declaring node: the id of a variable, or the
+ * declare or function node of a function. Variables have a
+ * `slot` dense within their function; `shadowed` is the symbol
+ * of the same name in an enclosing scope, `next` the previous
+ * symbol of the same scope.
+ */
+
+typedef struct ifj17_symbol {
+  ifj17_string_t *name;
+  ifj17_symbol_kind kind;
+  ifj17_datatype datatype;
+  int depth;
+  int slot;
+  int defined;
+  ifj17_node_t *decl;
+  struct ifj17_symbol *shadowed;
+  struct ifj17_symbol *next;
+} ifj17_symbol_t;
+
+/*
+ * IFJ17 scope, linked to its enclosing scope.
+ */
+
+typedef struct ifj17_scope {
+  struct ifj17_scope *parent;
+  ifj17_symbol_t *symbols;
+  int depth;
+} ifj17_scope_t;
+
+/*
+ * Symbol table bucket, the innermost visible symbol of `name`.
+ */
+
+typedef struct {
+  ifj17_string_t *name;
+  ifj17_symbol_t *sym;
+} ifj17_symtab_bucket_t;
+
+/*
+ * IFJ17 symbol table.
+ *
+ * A single open-addressed table over the interned names,
+ * probed with their precomputed hashes, holding the innermost
+ * symbol of each name. Entering a scope costs nothing, leaving
+ * it unlinks only its own symbols, so a pass over a program is
+ * linear in its declarations however deep they nest.
+ */
+
+typedef struct {
+  ifj17_arena_t *arena;
+  ifj17_scope_t *scope;
+  ifj17_symtab_bucket_t *buckets;
+  int nbuckets;
+  int nnames;
+  int nsymbols;
+} ifj17_symtab_t;
+
+// prototypes
+
+int ifj17_symtab_init(ifj17_symtab_t *self, ifj17_arena_t *arena);
+
+void ifj17_symtab_free(ifj17_symtab_t *self);
+
+void ifj17_symtab_push(ifj17_symtab_t *self, ifj17_scope_t *scope);
+
+void ifj17_symtab_pop(ifj17_symtab_t *self);
+
+ifj17_symbol_t *ifj17_symtab_lookup(ifj17_symtab_t *self, ifj17_string_t *name);
+
+ifj17_symbol_t *ifj17_symtab_define(ifj17_symtab_t *self, ifj17_string_t *name,
+                                    ifj17_symbol_kind kind, ifj17_node_t *decl);
+
+#endif /* IFJ17_SYMTAB_H */
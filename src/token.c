@@ -8,11 +8,11 @@
 #include <stdio.h>
 
 /*
- * Inspect the given `tok`, outputting debugging
- * information to stdout.
+ * Inspect the given `tok` of `source`, outputting
+ * debugging information to stdout.
  */
 
-void ifj17_token_inspect(ifj17_token_t *tok) {
+void ifj17_token_inspect(ifj17_token_t *tok, const char *source) {
   printf("\e[90m%s\e[0m", ifj17_token_type_string(tok->type));
   switch (tok->type) // TODO: Delete debug function
   {
@@ -23,10 +23,10 @@ void ifj17_token_inspect(ifj17_token_t *tok) {
     printf(" \e[36m%f\e[0m", tok->value.as_double);
     break;
   case IFJ17_TOKEN_STRING:
-    printf(" \e[32m'%s'\e[0m", tok->value.as_string);
+    printf(" \e[32m'%.*s'\e[0m", tok->len, source + tok->offset);
     break;
   case IFJ17_TOKEN_ID:
-    printf(" %s", tok->value.as_string);
+    printf(" %.*s", tok->len, source + tok->offset);
     break;
   }
   printf("\n");
@@ -58,6 +58,7 @@
   t(OP_DECR, "--") \
   t(OP_MUL, "*") \
   t(OP_DIV, "/") \
+  t(OP_IDIV, "\\") \
   t(OP_MOD, "%") \
   t(OP_POW, "**") \
   t(OP_GT, ">") \
@@ -103,16 +104,21 @@ IFJ17_TOKEN_LIST
 };
 
 /*
- * Token struct.
+ * Token struct, compact so token arrays stay cache friendly.
+ * Identifiers and strings refer to `len` bytes of the source
+ * at `offset`, `lineno` is the line the lexer was on. An
+ * ILLEGAL token carries the lexer's error message.
  */
 
 typedef struct {
-  int len;
   ifj17_token type;
-  struct {
-    char *as_string;
+  int lineno;
+  int offset;
+  int len;
+  union {
     double as_double;
     int as_int;
+    const char *as_error;
   } value;
 } ifj17_token_t;
 
@@ -130,6 +136,6 @@ ifj17_token_type_string(ifj17_token type) {
 // protos
 
 void
-ifj17_token_inspect(ifj17_token_t *tok);
+ifj17_token_inspect(ifj17_token_t *tok, const char *source);
 
 #endif /* IFJ17_TOKEN_H */
@@ -4,11 +4,14 @@
 // Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
 //
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "utils.h"
-#include <assert.h>
+#include "internal.h"
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 /*
@@ -29,11 +32,16 @@ size_t file_size(FILE *stream) {
 
 char *file_read(const char *filename) {
   FILE *fh = fopen(filename, "r");
+  if (!fh) {
+    return NULL;
+  }
+
   size_t len = file_size(fh);
 
   char *buf = malloc(len + 1);
 
   if (!buf) {
+    fclose(fh);
     return NULL;
   }
 
@@ -45,23 +53,124 @@ char *file_read(const char *filename) {
 }
 
 /*
- * Read `stream` until EOF.
+ * Read `stream` until EOF into a nul-terminated buffer of
+ * initially `size` bytes, doubling it as needed. The byte
+ * count is stored in `len`, as the input may contain nuls.
+ */
+
+static char *read_stream(FILE *stream, size_t *len, size_t size) {
+  char *buf = malloc(size + 1);
+  if (unlikely(!buf)) {
+    return NULL;
+  }
+
+  *len = 0;
+  for (;;) {
+    if (*len == size) {
+      char *tmp = realloc(buf, (size *= 2) + 1);
+      if (unlikely(!tmp)) {
+        free(buf);
+        return NULL;
+      }
+      buf = tmp;
+    }
+
+    size_t n = fread(buf + *len, 1, size - *len, stream);
+    if (!n) {
+      break;
+    }
+
+    *len += n;
+  }
+
+  if (unlikely(ferror(stream))) {
+    free(buf);
+    return NULL;
+  }
+
+  buf[*len] = 0;
+  return buf;
+}
+
+/*
+ * Read `stream` until EOF, storing the byte count
+ * in `len` unless NULL. Return NULL on failure.
+ */
+
+char *read_until_eof(FILE *stream, size_t *len) {
+  size_t n;
+  char *buf = read_stream(stream, &n, BUFSIZ);
+  if (len) {
+    *len = n;
+  }
+  return buf;
+}
+
+/*
+ * Open the source `filename` and return its nul-terminated
+ * contents, or NULL with errno set.
+ *
+ * Regular files are mapped read-only when the last page has room
+ * past the end of file, as the kernel zero-fills it and the lexer
+ * gets its sentinel for free. Pipes and page-aligned files are
+ * read into memory instead.
+ */
+
+const char *ifj17_source_open(ifj17_source_t *self, const char *filename) {
+  struct stat st;
+  size_t pagesize = sysconf(_SC_PAGESIZE);
+
+  self->data = NULL;
+  self->len = 0;
+  self->mapped = 0;
+
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+
+  if (unlikely(fstat(fd, &st) < 0)) {
+    close(fd);
+    return NULL;
+  }
+
+  if (S_ISREG(st.st_mode) && st.st_size % pagesize) {
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      posix_madvise(data, st.st_size, POSIX_MADV_SEQUENTIAL);
+      self->data = data;
+      self->len = st.st_size;
+      self->mapped = 1;
+      close(fd);
+      return self->data;
+    }
+  }
+
+  FILE *stream = fdopen(fd, "r");
+  if (unlikely(!stream)) {
+    close(fd);
+    return NULL;
+  }
+
+  // one spare byte so a regular file hits EOF without growing
+  size_t size = S_ISREG(st.st_mode) ? st.st_size + 1 : BUFSIZ;
+  self->data = read_stream(stream, &self->len, size);
+  fclose(stream);
+  return self->data;
+}
+
+/*
+ * Unmap or free the source buffer.
  */
 
-char *read_until_eof(FILE *stream) {
-  // alloc
-  off_t len = 0;
-  char buf[1024];
-  char *str = malloc(1);
-  assert(str);
-
-  // read
-  while (!feof(stream) && !ferror(stream)) {
-    size_t n = fread(buf, 1, 1024, stream);
-    len += strlen(buf);
-    str = realloc(str, len);
-    strncat(str, buf, n);
+void ifj17_source_close(ifj17_source_t *self) {
+  if (self->mapped) {
+    munmap(self->data, self->len);
+  } else {
+    free(self->data);
   }
 
-  return str;
+  self->data = NULL;
+  self->len = 0;
+  self->mapped = 0;
 }
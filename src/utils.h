@@ -10,10 +10,25 @@
 #include <stdio.h>
 #include <sys/stat.h>
 
+/*
+ * Source buffer, nul-terminated and either mapped
+ * straight from the page cache or read into memory.
+ */
+
+typedef struct {
+  char *data;
+  size_t len;
+  int mapped;
+} ifj17_source_t;
+
 size_t file_size(FILE *handle);
 
 char *file_read(const char *filename);
 
-char *read_until_eof(FILE *stream);
+char *read_until_eof(FILE *stream, size_t *len);
+
+const char *ifj17_source_open(ifj17_source_t *self, const char *filename);
+
+void ifj17_source_close(ifj17_source_t *self);
 
 #endif
@@ -0,0 +1,136 @@
+//
+// value.h
+//
+// Copyright (c) 2017 Hurzhii Artem, Demicev Alexandr, Denisov Artem, Chufarov Evgeny
+//
+
+#ifndef IFJ17_VALUE_H
+#define IFJ17_VALUE_H
+
+#include "object.h"
+#include "state.h"
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * IFJ17 value.
+ *
+ * A NaN-boxed 64 bits: a double is its own bits, NaNs made
+ * the one canonical NaN, and every other value hides in the
+ * payload of the quiet NaNs above it. With the sign bit set
+ * the payload is a string's address; clear, bits 32-33 tag
+ * nil, bool or int and the low 32 bits hold the bool or int.
+ * Values never allocate nor own anything, so they copy,
+ * compare and discard by assignment.
+ *
+ * A string is either interned, living as long as its state
+ * or interpreter, or a handle into the interpreter's runtime
+ * heap. Compacting the heap moves its strings and rewrites
+ * only the values in the frames and on the data stack; any
+ * other copy of a heap handle, or pointer into the string,
+ * dangles once a string is built, so none is kept across it.
+ */
+
+typedef uint64_t ifj17_value_t;
+
+/*
+ * Quiet NaN bits, sign bit and canonical NaN.
+ */
+
+#define IFJ17_VALUE_QNAN ((uint64_t)0x7ffc000000000000)
+#define IFJ17_VALUE_SIGN ((uint64_t)0x8000000000000000)
+#define IFJ17_VALUE_NAN ((uint64_t)0x7ff8000000000000)
+
+/*
+ * Tags of the inline values.
+ */
+
+#define IFJ17_VALUE_NIL 1
+#define IFJ17_VALUE_BOOL 2
+#define IFJ17_VALUE_INT 3
+
+/*
+ * Box the inline `payload` under `tag`.
+ */
+
+#define ifj17_value_box(tag, payload)                                               \
+  (IFJ17_VALUE_QNAN | (uint64_t)(tag) << 32 | (uint32_t)(payload))
+
+/*
+ * Boxing macros.
+ */
+
+#define ifj17_nil ifj17_value_box(IFJ17_VALUE_NIL, 0)
+#define ifj17_value_bool(b) ifj17_value_box(IFJ17_VALUE_BOOL, !!(b))
+#define ifj17_value_int(n) ifj17_value_box(IFJ17_VALUE_INT, n)
+#define ifj17_value_string(str)                                                     \
+  (IFJ17_VALUE_SIGN | IFJ17_VALUE_QNAN | (uint64_t)(uintptr_t)(str))
+
+/*
+ * Check if `val` is the given type.
+ */
+
+#define ifj17_value_is_double(val) (IFJ17_VALUE_QNAN != ((val)&IFJ17_VALUE_QNAN))
+#define ifj17_value_is_string(val)                                                  \
+  ((IFJ17_VALUE_SIGN | IFJ17_VALUE_QNAN) ==                                         \
+   ((val) & (IFJ17_VALUE_SIGN | IFJ17_VALUE_QNAN)))
+#define ifj17_value_is(val, tag)                                                    \
+  (((val) & ~(uint64_t)0xffffffff) == ifj17_value_box(IFJ17_VALUE_##tag, 0))
+#define ifj17_value_is_nil(val) ((val) == ifj17_nil)
+#define ifj17_value_is_bool(val) ifj17_value_is(val, BOOL)
+#define ifj17_value_is_int(val) ifj17_value_is(val, INT)
+
+/*
+ * Unboxing macros.
+ */
+
+#define ifj17_value_as_bool(val) ((int)((val)&1))
+#define ifj17_value_as_int(val) ((int)(uint32_t)(val))
+#define ifj17_value_as_string(val)                                                  \
+  ((ifj17_string_t *)(uintptr_t)((val) & ~(IFJ17_VALUE_SIGN | IFJ17_VALUE_QNAN)))
+
+/*
+ * Box the double `d`.
+ */
+
+static inline ifj17_value_t ifj17_value_double(double d) {
+  ifj17_value_t val;
+  if (d != d) {
+    return IFJ17_VALUE_NAN;
+  }
+  memcpy(&val, &d, sizeof(d));
+  return val;
+}
+
+/*
+ * Unbox the double `val`.
+ */
+
+static inline double ifj17_value_as_double(ifj17_value_t val) {
+  double d;
+  memcpy(&d, &val, sizeof(d));
+  return d;
+}
+
+/*
+ * Return the object type of `val`, IFJ17_TYPE_NULL for nil.
+ */
+
+static inline ifj17_object ifj17_value_type(ifj17_value_t val) {
+  if (ifj17_value_is_double(val)) {
+    return IFJ17_TYPE_DOUBLE;
+  }
+  if (ifj17_value_is_string(val)) {
+    return IFJ17_TYPE_STRING;
+  }
+  switch ((val >> 32) & 3) {
+  case IFJ17_VALUE_BOOL:
+    return IFJ17_TYPE_BOOL;
+  case IFJ17_VALUE_INT:
+    return IFJ17_TYPE_INT;
+  default:
+    return IFJ17_TYPE_NULL;
+  }
+}
+
+#endif /* IFJ17_VALUE_H */
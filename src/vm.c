@@ -5,97 +5,1266 @@
 //
 
 #include "vm.h"
-#include "disasm.h"
 #include "internal.h"
-#include "object.h"
-#include "opcodes.h"
+#include <ctype.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
 
-ifj17_object_t *ifj17_eval(ifj17_vm_t *vm) {
-  ifj17_dump(vm);
-  printf("\n");
-  ifj17_instruction_t *ip = vm->main->ip;
-  ifj17_instruction_t i;
-  int registers[32] = {0};
+/*
+ * Fail with `err` and `message`, returning 0.
+ */
 
-  for (;;) {
-    switch (OP(i = *ip++)) {
-    // LOADK
-    case IFJ17_OP_LOADK:
-      printf("loadk %d\n", K(B(i)));
-      R((A(i))) = K(B(i));
-      break;
-
-    // LOADB
-    case IFJ17_OP_LOADB:
-      printf("loadb %d %d %d\n", A(i), K(B(i)), C(i));
-      R(A(i)) = K(B(i));
-      if (C(i))
-        ip++;
-      break;
-
-    // ADD
-    case IFJ17_OP_ADD:
-      R(A(i)) = RK(B(i)) + RK(C(i));
-      break;
+#define fail(err, message) (self->error = IFJ17_VM_##err, self->msg = message, 0)
 
-    // SUB
-    case IFJ17_OP_SUB:
-      R(A(i)) = RK(B(i)) - RK(C(i));
-      break;
+/*
+ * Int arithmetic, wrapping around on overflow.
+ */
+
+#define wrap(a, op, b) ((int)((unsigned int)(a)op(unsigned int)(b)))
+
+/*
+ * Slot value of a variable not defined, a quiet NaN no value
+ * is boxed as. A defined variable is nil until assigned.
+ */
+
+#define UNDEFINED ifj17_value_box(0, 0)
+
+/*
+ * Object type of `val`.
+ */
+
+#define type(val) ifj17_value_type(val)
+
+/*
+ * Number of slots in the frames `names` index, none before
+ * loading.
+ */
+
+#define slots(names) ((names) ? (int)kh_size(names) : 0)
+
+/*
+ * Type names, by object type.
+ */
+
+static const char *type_names[] = {
+    [IFJ17_TYPE_NULL] = "",
+    [IFJ17_TYPE_BOOL] = "bool",
+    [IFJ17_TYPE_INT] = "int",
+    [IFJ17_TYPE_DOUBLE] = "float",
+    [IFJ17_TYPE_STRING] = "string",
+};
+
+/*
+ * Is `str` the `word`, case aside?
+ */
+
+static int same_word(const char *str, const char *word) {
+  while (*word && tolower((unsigned char)*str) == tolower((unsigned char)*word)) {
+    ++str, ++word;
+  }
+  return !*str && !*word;
+}
+
+/*
+ * Initialize an interpreter with no program, reading stdin
+ * and writing stdout.
+ */
+
+void ifj17_vm_init(ifj17_vm_t *self) {
+  memset(self, 0, sizeof(ifj17_vm_t));
+  kv_init(self->code);
+  kv_init(self->frames);
+  kv_init(self->stack);
+  kv_init(self->calls);
+  kv_init(self->buf);
+  ifj17_state_init(&self->strings);
+  self->in = stdin;
+  self->out = stdout;
+  self->resolve = 1;
+  self->fuse = 1;
+}
+
+/*
+ * Decode the IFJcode17 string `str` in place, its \ddd escapes
+ * resolved. Return its length, or -1 on a malformed escape.
+ */
+
+static int decode(char *str) {
+  char *out = str, *start = str;
+
+  while (*str) {
+    if ('\\' == *str) {
+      if (!isdigit(str[1]) || !isdigit(str[2]) || !isdigit(str[3])) {
+        return -1;
+      }
+      *out++ = (str[1] - '0') * 100 + (str[2] - '0') * 10 + str[3] - '0';
+      str += 4;
+    } else {
+      *out++ = *str++;
+    }
+  }
+
+  return out - start;
+}
+
+/*
+ * Set `val` to the string of the `len` bytes of `str`,
+ * interned, for constants and type names. Return 0 on
+ * failure.
+ */
+
+static int string(ifj17_vm_t *self, const char *str, int len, ifj17_value_t *val) {
+  ifj17_string_t *interned = ifj17_string_intern(&self->strings, str, len);
+  if (unlikely(!interned)) {
+    return fail(INTERNAL, "out of memory");
+  }
+  *val = ifj17_value_string(interned);
+  return 1;
+}
+
+/*
+ * Parse the constant `value` of `type` into `val`. Return 0
+ * on failure.
+ */
+
+static int constant(ifj17_vm_t *self, const char *type, char *value,
+                    ifj17_value_t *val) {
+  char *end;
+  int len;
+
+  if (same_word(type, "int")) {
+    long n = strtol(value, &end, 10);
+    *val = ifj17_value_int((int)n);
+    return *value && !*end;
+  }
+  if (same_word(type, "float")) {
+    double n = strtod(value, &end);
+    *val = ifj17_value_double(n);
+    return *value && !*end;
+  }
+  if (same_word(type, "bool")) {
+    *val = ifj17_value_bool('t' == *value);
+    return !strcmp(value, "true") || !strcmp(value, "false");
+  }
+  if (same_word(type, "string")) {
+    return -1 != (len = decode(value)) && string(self, value, len, val);
+  }
+  return 0;
+}
+
+/*
+ * Set `index` to the slot of `name` within the frames
+ * `names` indexes, assigning it the next free one when new.
+ * Return 0 on failure.
+ */
+
+static int intern(ifj17_vm_t *self, khash_t(index) * names, char *name, int *index) {
+  int ret;
+  khiter_t k = kh_put(index, names, name, &ret);
+
+  if (unlikely(ret < 0)) {
+    return fail(INTERNAL, "out of memory");
+  }
+  if (ret) {
+    kh_value(names, k) = kh_size(names) - 1;
+  }
+  *index = kh_value(names, k);
+  return 1;
+}
+
+/*
+ * Parse `tok` into `arg`, an operand of `kind` as listed by
+ * IFJ17_OP_LIST. Return 0 on failure.
+ */
+
+static int operand(ifj17_vm_t *self, char *tok, char kind, ifj17_vm_operand_t *arg) {
+  static const char *frames[] = {"GF", "LF", "TF"};
+  char *at = strchr(tok, '@');
+
+  switch (kind) {
+  case 'l':
+    arg->kind = IFJ17_VM_LABEL;
+    arg->val.name = tok;
+    return 1;
+  case 't':
+    arg->kind = IFJ17_VM_TYPE_NAME;
+    for (int type = IFJ17_TYPE_BOOL; type <= IFJ17_TYPE_STRING; ++type) {
+      if (type_names[type] && same_word(tok, type_names[type])) {
+        arg->type = type;
+        return 1;
+      }
+    }
+    return fail(SYNTAX, "invalid type");
+  }
+
+  if (!at) {
+    return fail(SYNTAX, "invalid operand");
+  }
+  *at = 0;
+
+  for (int frame = IFJ17_VM_GF; frame <= IFJ17_VM_TF; ++frame) {
+    if (!strcmp(tok, frames[frame])) {
+      arg->kind = IFJ17_VM_VAR;
+      arg->frame = frame;
+      arg->val.name = at + 1;
+      if (!*arg->val.name) {
+        return fail(SYNTAX, "invalid variable");
+      }
+      return intern(self, IFJ17_VM_GF == frame ? self->globals : self->locals,
+                    arg->val.name, &arg->index);
+    }
+  }
+
+  if ('s' != kind) {
+    return fail(SYNTAX, "variable expected");
+  }
+
+  arg->kind = IFJ17_VM_CONST;
+  if (!constant(self, tok, at + 1, &arg->val.constant)) {
+    return self->error ? 0 : fail(SYNTAX, "invalid constant");
+  }
+  return 1;
+}
+
+/*
+ * Superinstructions, by the opcodes they fuse.
+ */
+
+static const struct {
+  ifj17_op_t op, first, second;
+} supers[] = {
+#define s(op, first, second) {IFJ17_OP_##op, IFJ17_OP_##first, IFJ17_OP_##second},
+    IFJ17_SUPER_LIST
+#undef s
+};
+
+/*
+ * Drop the loaded LABEL instructions, a label going to the
+ * instruction that followed it, then fuse each adjacent pair
+ * of instructions IFJ17_SUPER_LIST lists, the second kept
+ * in place for the jumps to it. Return 0 on failure.
+ */
+
+static int fuse(ifj17_vm_t *self) {
+  size_t n = kv_size(self->code), m = 0;
+  int *index = malloc((n + 1) * sizeof(int));
+
+  if (unlikely(!index)) {
+    return fail(INTERNAL, "out of memory");
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    index[i] = m;
+    if (IFJ17_OP_LABEL != kv_A(self->code, i).op) {
+      kv_A(self->code, m++) = kv_A(self->code, i);
+    }
+  }
+  index[n] = m;
+  kv_size(self->code) = m;
+
+  // retarget the jumps and the labels looked up by name
+  for (size_t i = 0; i < m; ++i) {
+    ifj17_vm_operand_t *arg = &kv_A(self->code, i).args[0];
+    if (IFJ17_VM_LABEL == arg->kind) {
+      arg->index = index[arg->index];
+    }
+  }
+  for (khiter_t k = kh_begin(self->labels); k != kh_end(self->labels); ++k) {
+    if (kh_exist(self->labels, k)) {
+      kh_value(self->labels, k) = index[kh_value(self->labels, k)];
+    }
+  }
+  free(index);
+
+  for (size_t i = 0; i + 1 < m; ++i) {
+    ifj17_vm_instr_t *instr = &kv_A(self->code, i);
+    for (int j = 0; j < IFJ17_SUPERS; ++j) {
+      if (supers[j].first == instr->op && supers[j].second == instr[1].op) {
+        instr->op = supers[j].op;
+        ++i;
+        break;
+      }
+    }
+  }
+
+  return 1;
+}
+
+/*
+ * Load `len` bytes of IFJcode17 `source`, one instruction
+ * per line, resolving its labels and variables, and fuse it
+ * unless told not to. Return 0 on failure.
+ */
+
+int ifj17_vm_load(ifj17_vm_t *self, const char *source, size_t len) {
+  char *line, *end, *toks[5];
+  int lineno = 0, header = 0, ret;
+
+  self->labels = kh_init(index);
+  self->globals = kh_init(index);
+  self->locals = kh_init(index);
+  self->source = malloc(len + 1);
+  if (unlikely(!self->labels || !self->globals || !self->locals || !self->source)) {
+    return fail(INTERNAL, "out of memory");
+  }
+  memcpy(self->source, source, len);
+  self->source[len] = 0;
+
+  for (line = self->source; line; line = end) {
+    int ntoks = 0;
+    self->lineno = ++lineno;
+    if ((end = strchr(line, '\n'))) {
+      *end++ = 0;
+    }
+
+    // split on whitespace up to a comment
+    for (char *p = line; *p && '#' != *p && ntoks < 5;) {
+      if (isspace((unsigned char)*p)) {
+        ++p;
+        continue;
+      }
+      toks[ntoks++] = p;
+      while (*p && '#' != *p && !isspace((unsigned char)*p))
+        ++p;
+      if ('#' == *p) {
+        *p = 0;
+        break;
+      }
+      if (*p)
+        *p++ = 0;
+    }
+
+    if (!ntoks) {
+      continue;
+    }
+
+    if (!header) {
+      if (1 != ntoks || !same_word(toks[0], ".IFJcode17")) {
+        return fail(SYNTAX, "missing .IFJcode17 header");
+      }
+      header = 1;
+      continue;
+    }
+
+    ifj17_vm_instr_t instr = {IFJ17_OPS, lineno};
+    for (int op = 0; op < IFJ17_BASE_OPS; ++op) {
+      if (same_word(toks[0], ifj17_op_strings[op])) {
+        instr.op = op;
+        break;
+      }
+    }
+    if (IFJ17_OPS == instr.op) {
+      return fail(SYNTAX, "unknown opcode");
+    }
+
+    const char *kinds = ifj17_op_operands[instr.op];
+    if (ntoks - 1 != (int)strlen(kinds)) {
+      return fail(SYNTAX, "wrong number of operands");
+    }
+    for (int i = 0; kinds[i]; ++i) {
+      if (!operand(self, toks[i + 1], kinds[i], &instr.args[i])) {
+        return 0;
+      }
+    }
+
+    if (IFJ17_OP_LABEL == instr.op) {
+      khiter_t k = kh_put(index, self->labels, instr.args[0].val.name, &ret);
+      if (!ret) {
+        return fail(SEMANTIC, "label redefined");
+      }
+      kh_value(self->labels, k) = kv_size(self->code);
+    }
+
+    kv_push(ifj17_vm_instr_t, self->code, instr);
+  }
+
+  if (!header) {
+    self->lineno = 1;
+    return fail(SYNTAX, "missing .IFJcode17 header");
+  }
+
+  // jumps go to defined labels only, by index
+  for (size_t i = 0; i < kv_size(self->code); ++i) {
+    ifj17_vm_instr_t *instr = &kv_A(self->code, i);
+    if (IFJ17_VM_LABEL == instr->args[0].kind) {
+      khiter_t k = kh_get(index, self->labels, instr->args[0].val.name);
+      if (kh_end(self->labels) == k) {
+        self->lineno = instr->lineno;
+        return fail(SEMANTIC, "undefined label");
+      }
+      instr->args[0].index = kh_value(self->labels, k);
+    }
+  }
+
+  self->lineno = 0;
+  return !self->fuse || fuse(self);
+}
+
+/*
+ * Return a new frame of `size` slots, none defined, or NULL.
+ */
+
+static ifj17_value_t *new_frame(int size) {
+  ifj17_value_t *frame = malloc((size ? size : 1) * sizeof(ifj17_value_t));
+  for (int i = 0; frame && i < size; ++i) {
+    frame[i] = UNDEFINED;
+  }
+  return frame;
+}
+
+/*
+ * Return the frame variable `arg` lives in, or NULL.
+ */
+
+static ifj17_value_t *frame(ifj17_vm_t *self, ifj17_vm_operand_t *arg) {
+  ifj17_value_t *frame = self->gf;
+
+  if (IFJ17_VM_LF == arg->frame) {
+    frame = kv_size(self->frames) ? kv_A(self->frames, kv_size(self->frames) - 1)
+                                  : NULL;
+  } else if (IFJ17_VM_TF == arg->frame) {
+    frame = self->tf;
+  }
+
+  if (!frame) {
+    fail(FRAME, "frame not defined");
+  }
+  return frame;
+}
+
+/*
+ * Return the index of the slot of variable `arg`, looked up
+ * by name unless resolving.
+ */
+
+static inline int locate(ifj17_vm_t *self, ifj17_vm_operand_t *arg) {
+  if (self->resolve) {
+    return arg->index;
+  }
+
+  khash_t(index) *names = IFJ17_VM_GF == arg->frame ? self->globals : self->locals;
+  return kh_value(names, kh_get(index, names, arg->val.name));
+}
+
+/*
+ * Return the slot holding variable `arg`, or NULL.
+ */
+
+static ifj17_value_t *slot(ifj17_vm_t *self, ifj17_vm_operand_t *arg) {
+  ifj17_value_t *vars = frame(self, arg);
+  if (!vars) {
+    return NULL;
+  }
+
+  ifj17_value_t *var = &vars[locate(self, arg)];
+  if (UNDEFINED == *var) {
+    fail(UNDEFINED, "undefined variable");
+    return NULL;
+  }
+  return var;
+}
+
+/*
+ * Set `val` to the value of symbol `arg`. Return 0 on
+ * failure.
+ */
+
+static int value(ifj17_vm_t *self, ifj17_vm_operand_t *arg, ifj17_value_t *val) {
+  ifj17_value_t *var;
+
+  if (IFJ17_VM_CONST == arg->kind) {
+    *val = arg->val.constant;
+    return 1;
+  }
+
+  if (!(var = slot(self, arg))) {
+    return 0;
+  }
+  if (ifj17_value_is_nil(*var)) {
+    return fail(MISSING, "uninitialized variable");
+  }
+  *val = *var;
+  return 1;
+}
+
+/*
+ * Assign `val` to variable `arg`. Return 0 on failure.
+ */
+
+static int set(ifj17_vm_t *self, ifj17_vm_operand_t *arg, ifj17_value_t val) {
+  ifj17_value_t *dst = slot(self, arg);
+  if (dst) {
+    *dst = val;
+  }
+  return !!dst;
+}
+
+/*
+ * Return the string buffer, room made for `len` bytes.
+ */
+
+static char *reserve(ifj17_vm_t *self, size_t len) {
+  if (kv_max(self->buf) < len) {
+    kv_resize(char, self->buf, len);
+  }
+  return self->buf.a;
+}
+
+/*
+ * Heap bytes a string of `len` bytes takes: its bytes and NUL,
+ * no fewer than a forwarding address takes, after the header,
+ * 8-byte aligned.
+ */
+
+#define heap_room(len)                                                              \
+  ((size_t)(len) + 1 < sizeof(void *) ? sizeof(void *) : (size_t)(len) + 1)
+#define heap_bytes(len) ((sizeof(ifj17_string_t) + heap_room(len) + 7) & ~(size_t)7)
+
+/*
+ * Does `str` live in the heap?
+ */
+
+#define in_heap(self, str)                                                          \
+  ((char *)(str) >= (self)->heap && (char *)(str) < (self)->heap + (self)->heap_len)
 
-    // DIV
-    case IFJ17_OP_DIV:
-      R(A(i)) = RK(B(i)) / RK(C(i));
-      break;
+/*
+ * Point `val` at the copy in `to` of the heap string it
+ * holds, copying the string to `to` at `*len` first unless
+ * already there, its old length -1 and address forwarding.
+ */
 
-    // MUL
+static void forward(ifj17_vm_t *self, ifj17_value_t *val, char *to, size_t *len) {
+  ifj17_string_t *str, *copy;
+
+  if (!ifj17_value_is_string(*val) || !in_heap(self, ifj17_value_as_string(*val))) {
+    return;
+  }
+
+  str = ifj17_value_as_string(*val);
+  if (-1 == str->len) {
+    memcpy(&copy, str->val, sizeof(copy));
+  } else {
+    copy = (ifj17_string_t *)(to + *len);
+    memcpy(copy, str, sizeof(ifj17_string_t) + str->len + 1);
+    *len += heap_bytes(str->len);
+    str->len = -1;
+    memcpy(str->val, &copy, sizeof(copy));
+  }
+  *val = ifj17_value_string(copy);
+}
+
+/*
+ * Move the heap strings the frames and the data stack hold
+ * to a new heap of `size` bytes, at least `heap_len`, and
+ * free the old one. Return 0 on failure.
+ */
+
+static int compact(ifj17_vm_t *self, size_t size) {
+  int nglobals = slots(self->globals), nlocals = slots(self->locals);
+  char *to = malloc(size);
+  size_t len = 0;
+
+  if (unlikely(!to)) {
+    return fail(INTERNAL, "out of memory");
+  }
+
+#define each(vals, n)                                                               \
+  for (size_t i = 0; (vals) && i < (size_t)(n); ++i)                                \
+    forward(self, &(vals)[i], to, &len);
+
+  each(self->gf, nglobals);
+  each(self->tf, nlocals);
+  for (size_t f = 0; f < kv_size(self->frames); ++f) {
+    each(kv_A(self->frames, f), nlocals);
+  }
+  each(self->stack.a, kv_size(self->stack));
+
+#undef each
+
+  free(self->heap);
+  self->heap = to;
+  self->heap_len = len;
+  self->heap_size = size;
+  ++self->compactions;
+  return 1;
+}
+
+/*
+ * Set `val` to a new heap string of the `len` bytes of `str`,
+ * which must not point into the heap. A full heap is
+ * compacted, then resized to twice the live strings and the
+ * new one, no smaller than IFJ17_VM_HEAP_SIZE, should it be
+ * under that or over four times it. Return 0 on failure.
+ */
+
+static int build(ifj17_vm_t *self, const char *str, int len, ifj17_value_t *val) {
+  size_t size = heap_bytes(len), target;
+  ifj17_string_t *built;
+
+  if (self->heap_len + size > self->heap_size) {
+    if (self->heap && !compact(self, self->heap_size)) {
+      return 0;
+    }
+    target = 2 * (self->heap_len + size);
+    target = target < IFJ17_VM_HEAP_SIZE ? IFJ17_VM_HEAP_SIZE : target;
+    if ((self->heap_size < target || self->heap_size > 4 * target) &&
+        !compact(self, target)) {
+      return 0;
+    }
+  }
+
+  built = (ifj17_string_t *)(self->heap + self->heap_len);
+  self->heap_len += size;
+  built->len = len;
+  built->hash = 0;
+  built->ident = 0;
+  memcpy(built->val, str, len);
+  built->val[len] = 0;
+  *val = ifj17_value_string(built);
+  return 1;
+}
+
+/*
+ * Set `val` to the string `a` followed by `b`. Return 0 on
+ * failure.
+ */
+
+static int concat(ifj17_vm_t *self, ifj17_string_t *a, ifj17_string_t *b,
+                  ifj17_value_t *val) {
+  char *buf = reserve(self, a->len + b->len + 1);
+
+  if (unlikely(!buf)) {
+    return fail(INTERNAL, "out of memory");
+  }
+  memcpy(buf, a->val, a->len);
+  memcpy(buf + a->len, b->val, b->len);
+  return build(self, buf, a->len + b->len, val);
+}
+
+/*
+ * Compare `a` and `b` of the same type.
+ */
+
+static int compare(ifj17_value_t a, ifj17_value_t b) {
+  switch (type(a)) {
+  case IFJ17_TYPE_DOUBLE: {
+    double x = ifj17_value_as_double(a), y = ifj17_value_as_double(b);
+    return (x > y) - (x < y);
+  }
+  case IFJ17_TYPE_STRING: {
+    // by content, the same string aside
+    ifj17_string_t *x = ifj17_value_as_string(a), *y = ifj17_value_as_string(b);
+    int n;
+    if (x == y) {
+      return 0;
+    }
+    n = memcmp(x->val, y->val, x->len < y->len ? x->len : y->len);
+    return n ? n : (x->len > y->len) - (x->len < y->len);
+  }
+  default: {
+    int x = ifj17_value_as_int(a), y = ifj17_value_as_int(b);
+    return (x > y) - (x < y);
+  }
+  }
+}
+
+/*
+ * Set `val` to the result of arithmetic `op` on `a` and `b`.
+ * Return 0 on failure.
+ */
+
+static int arithmetic(ifj17_vm_t *self, ifj17_op_t op, ifj17_value_t a,
+                      ifj17_value_t b, ifj17_value_t *val) {
+  if (ifj17_value_is_int(a) && ifj17_value_is_int(b)) {
+    int x = ifj17_value_as_int(a), y = ifj17_value_as_int(b);
+    switch (op) {
+    case IFJ17_OP_ADD:
+      *val = ifj17_value_int(wrap(x, +, y));
+      return 1;
+    case IFJ17_OP_SUB:
+      *val = ifj17_value_int(wrap(x, -, y));
+      return 1;
     case IFJ17_OP_MUL:
-      R(A(i)) = RK(B(i)) * RK(C(i));
-      break;
-
-    // MOD
-    case IFJ17_OP_MOD:
-      R(A(i)) = RK(B(i)) % RK(C(i));
-      break;
-
-    // NEGATE
-    case IFJ17_OP_NEGATE:
-      R(A(i)) = -R(B(i));
-      break;
-
-    // LT
-    case IFJ17_OP_LT:
-      printf("lt %d %d\n", RK(B(i)), RK(C(i)));
-      if (RK(B(i)) < RK(C(i)))
-        ip++;
-      break;
-
-    // LTE
-    case IFJ17_OP_LTE:
-      printf("lte %d %d\n", RK(B(i)), RK(C(i)));
-      if (RK(B(i)) <= RK(C(i)))
-        ip++;
-      break;
-
-    // JMP
-    case IFJ17_OP_JMP:
-      printf("jmp %d\n", B(i));
-      ip += B(i);
-      break;
-
-    // HALT
-    case IFJ17_OP_HALT:
-      goto end;
-    }
-  }
-
-end:
-  return ifj17_int_new(R(0));
-}
-
-void ifj17_vm_free(ifj17_vm_t *vm) {
-  free(vm->main->constants);
-  free(vm->main->code);
-  free(vm->main);
-  free(vm);
+      *val = ifj17_value_int(wrap(x, *, y));
+      return 1;
+    default:
+      if (!y) {
+        return fail(ZERO, "division by zero");
+      }
+      *val = ifj17_value_int(-1 == y ? wrap(0, -, x) : x / y);
+      return 1;
+    }
+  }
+
+  if (!ifj17_value_is_double(a) || !ifj17_value_is_double(b)) {
+    return fail(TYPE, "arithmetic on mismatched operands");
+  }
+
+  double x = ifj17_value_as_double(a), y = ifj17_value_as_double(b);
+  switch (op) {
+  case IFJ17_OP_ADD:
+    *val = ifj17_value_double(x + y);
+    return 1;
+  case IFJ17_OP_SUB:
+    *val = ifj17_value_double(x - y);
+    return 1;
+  case IFJ17_OP_MUL:
+    *val = ifj17_value_double(x * y);
+    return 1;
+  default:
+    if (0 == y) {
+      return fail(ZERO, "division by zero");
+    }
+    *val = ifj17_value_double(x / y);
+    return 1;
+  }
+}
+
+/*
+ * Read a line from `in` into the string buffer, its newline
+ * dropped and the buffer NUL-terminated. Return its length,
+ * or -1 on failure.
+ */
+
+static int read_line(ifj17_vm_t *self) {
+  int c;
+
+  kv_size(self->buf) = 0;
+  while (EOF != (c = fgetc(self->in)) && '\n' != c) {
+    kv_push(char, self->buf, c);
+  }
+  kv_push(char, self->buf, 0);
+  return self->buf.a ? (int)kv_size(self->buf) - 1 : -1;
+}
+
+/*
+ * Set `val` to a value of `type` read from `in`, the type's
+ * default when the line does not hold one. Return 0 on
+ * failure.
+ */
+
+static int read_value(ifj17_vm_t *self, int type, ifj17_value_t *val) {
+  int len = read_line(self);
+  char *str = self->buf.a, *end;
+
+  if (unlikely(len < 0)) {
+    return fail(INTERNAL, "out of memory");
+  }
+
+  switch (type) {
+  case IFJ17_TYPE_STRING:
+    return build(self, str, len, val);
+  case IFJ17_TYPE_INT: {
+    long n = strtol(str, &end, 10);
+    *val = ifj17_value_int(*str && !*end ? (int)n : 0);
+    return 1;
+  }
+  case IFJ17_TYPE_DOUBLE: {
+    double n = strtod(str, &end);
+    *val = ifj17_value_double(*str && !*end ? n : 0);
+    return 1;
+  }
+  default:
+    *val = ifj17_value_bool(same_word(str, "true"));
+    return 1;
+  }
+}
+
+/*
+ * Write `val` to `out` as WRITE prints it.
+ */
+
+static void write_value(FILE *out, ifj17_value_t val) {
+  ifj17_string_t *str;
+
+  switch (type(val)) {
+  case IFJ17_TYPE_INT:
+    fprintf(out, "%d", ifj17_value_as_int(val));
+    break;
+  case IFJ17_TYPE_DOUBLE:
+    fprintf(out, "%g", ifj17_value_as_double(val));
+    break;
+  case IFJ17_TYPE_BOOL:
+    fputs(ifj17_value_as_bool(val) ? "true" : "false", out);
+    break;
+  default:
+    str = ifj17_value_as_string(val);
+    fwrite(str->val, 1, str->len, out);
+  }
+}
+
+/*
+ * Are `a` and `b` of object type `type`?
+ */
+
+#define typed(a, b, t) (IFJ17_TYPE_##t == type(a) && IFJ17_TYPE_##t == type(b))
+
+/*
+ * Jump to label `arg`, looked up by name unless resolving.
+ */
+
+#define jump(arg)                                                                   \
+  ip = self->resolve                                                                \
+           ? (arg)->index                                                           \
+           : kh_value(self->labels, kh_get(index, self->labels, (arg)->val.name))
+
+/*
+ * Check `cond`, failing with `err` and `message` otherwise.
+ */
+
+#define check(cond, err, message)                                                   \
+  if (!(cond)) {                                                                    \
+    fail(err, message);                                                             \
+    goto error;                                                                     \
+  }
+
+/*
+ * Count the dispatch to `op` into `profile`.
+ */
+
+static inline void profile(ifj17_vm_profile_t *profile, int op) {
+  ++profile->count[op];
+  if (profile->last) {
+    int *next = &profile->next[profile->last - 1];
+    profile->misses[IFJ17_VM_SWITCH][op] += profile->last != op + 1;
+    profile->misses[IFJ17_VM_THREADED][op] += *next != op + 1;
+    ++profile->pairs[profile->last - 1][op];
+    *next = op + 1;
+  }
+  profile->last = op + 1;
+}
+
+/*
+ * Move on to the next instruction.
+ */
+
+#define advance()                                                                   \
+  instr = &kv_A(self->code, ip++);                                                  \
+  dst = &instr->args[0];                                                            \
+  x = &instr->args[1];                                                              \
+  y = &instr->args[2];
+
+/*
+ * Fetch the next instruction to dispatch, done past the last
+ * one.
+ */
+
+#define fetch()                                                                     \
+  if (ip >= n)                                                                      \
+    goto done;                                                                      \
+  advance();                                                                        \
+  ++self->steps;                                                                    \
+  if (unlikely(self->profile != NULL))                                              \
+    profile(self->profile, instr->op);
+
+/*
+ * Dispatch threaded through the addresses of the handlers
+ * where the compiler takes them, by switch otherwise, both
+ * laid out by IFJ17_OP_LIST and IFJ17_SUPER_LIST. Either
+ * way a handler is labeled for superinstructions to go to.
+ */
+
+#if defined(__GNUC__) && !defined(IFJ17_SWITCH_DISPATCH)
+#define THREADED
+#define handler(op) do_##op:
+#define dispatch()                                                                  \
+  fetch();                                                                          \
+  goto *handlers[instr->op]
+const ifj17_vm_dispatch ifj17_vm_dispatch_kind = IFJ17_VM_THREADED;
+#else
+#define handler(op)                                                                 \
+  case IFJ17_OP_##op:                                                               \
+  do_##op:
+#define dispatch() continue
+const ifj17_vm_dispatch ifj17_vm_dispatch_kind = IFJ17_VM_SWITCH;
+#endif
+
+/*
+ * Instructions superinstructions start with, run by their
+ * own handlers and the fused ones.
+ */
+
+#define exec_MOVE()                                                                 \
+  if (!value(self, x, &a) || !set(self, dst, a))                                    \
+    goto error;
+
+#define exec_DEFVAR()                                                               \
+  if (!(vars = frame(self, dst)))                                                   \
+    goto error;                                                                     \
+  var = &vars[locate(self, dst)];                                                   \
+  check(UNDEFINED == *var, SEMANTIC, "variable redefined");                         \
+  *var = ifj17_nil;
+
+#define exec_PUSHS()                                                                \
+  if (!value(self, dst, &a))                                                        \
+    goto error;                                                                     \
+  kv_push(ifj17_value_t, self->stack, a);
+
+#define exec_compare(op)                                                            \
+  if (!value(self, x, &a) || !value(self, y, &b))                                   \
+    goto error;                                                                     \
+  check(type(a) == type(b), TYPE, "comparison of mismatched operands");             \
+  ret = compare(a, b);                                                              \
+  ret = IFJ17_OP_LT == (op) ? ret < 0 : IFJ17_OP_GT == (op) ? ret > 0 : !ret;       \
+  if (!set(self, dst, ifj17_value_bool(ret)))                                       \
+    goto error;
+
+#define exec_LT() exec_compare(IFJ17_OP_LT)
+#define exec_GT() exec_compare(IFJ17_OP_GT)
+
+/*
+ * Run the loaded program from its first instruction until it
+ * falls off its end. Return 0 on failure, the error kept.
+ */
+
+int ifj17_eval(ifj17_vm_t *self) {
+  int ip = 0, n = kv_size(self->code), nlocals = slots(self->locals), ret;
+  ifj17_vm_instr_t *instr;
+  ifj17_vm_operand_t *dst, *x, *y;
+  ifj17_value_t a, b, *var, *vars;
+  ifj17_string_t *str;
+  const char *name;
+  double d;
+  char chr, *buf;
+
+  if (!self->gf && unlikely(!(self->gf = new_frame(slots(self->globals))))) {
+    return fail(INTERNAL, "out of memory");
+  }
+
+#ifdef THREADED
+  static void *handlers[] = {
+#define o(op, operands) &&do_##op,
+      IFJ17_OP_LIST
+#undef o
+#define s(op, first, second) &&do_##op,
+      IFJ17_SUPER_LIST
+#undef s
+  };
+  dispatch();
+#else
+  for (;;) {
+    fetch();
+    switch (instr->op) {
+#endif
+    handler(MOVE)
+      exec_MOVE();
+      dispatch();
+
+    handler(CREATEFRAME)
+      free(self->tf);
+      self->tf = new_frame(nlocals);
+      check(self->tf, INTERNAL, "out of memory");
+      dispatch();
+
+    handler(PUSHFRAME)
+      check(self->tf, FRAME, "frame not defined");
+      kv_push(ifj17_value_t *, self->frames, self->tf);
+      self->tf = NULL;
+      dispatch();
+
+    handler(POPFRAME)
+      check(kv_size(self->frames), FRAME, "frame not defined");
+      free(self->tf);
+      self->tf = kv_pop(self->frames);
+      dispatch();
+
+    handler(DEFVAR)
+      exec_DEFVAR();
+      dispatch();
+
+    handler(CALL)
+      kv_push(int, self->calls, ip);
+      jump(dst);
+      dispatch();
+
+    handler(RETURN)
+      check(kv_size(self->calls), MISSING, "return outside a call");
+      ip = kv_pop(self->calls);
+      dispatch();
+
+    handler(PUSHS)
+      exec_PUSHS();
+      dispatch();
+
+    handler(POPS)
+      check(kv_size(self->stack), MISSING, "empty data stack");
+      if (!set(self, dst, kv_pop(self->stack)))
+        goto error;
+      dispatch();
+
+    handler(CLEARS)
+      kv_size(self->stack) = 0;
+      dispatch();
+
+    handler(ADD)
+    handler(SUB)
+    handler(MUL)
+    handler(DIV)
+      if (!value(self, x, &a) || !value(self, y, &b) ||
+          !arithmetic(self, instr->op, a, b, &a) || !set(self, dst, a))
+        goto error;
+      dispatch();
+
+    handler(LT)
+    handler(GT)
+    handler(EQ)
+      exec_compare(instr->op);
+      dispatch();
+
+    handler(AND)
+    handler(OR)
+      if (!value(self, x, &a) || !value(self, y, &b))
+        goto error;
+      check(typed(a, b, BOOL), TYPE, "logic on non-bool operands");
+      ret = IFJ17_OP_AND == instr->op
+                ? ifj17_value_as_bool(a) && ifj17_value_as_bool(b)
+                : ifj17_value_as_bool(a) || ifj17_value_as_bool(b);
+      if (!set(self, dst, ifj17_value_bool(ret)))
+        goto error;
+      dispatch();
+
+    handler(NOT)
+      if (!value(self, x, &a))
+        goto error;
+      check(ifj17_value_is_bool(a), TYPE, "logic on non-bool operands");
+      if (!set(self, dst, ifj17_value_bool(!ifj17_value_as_bool(a))))
+        goto error;
+      dispatch();
+
+    handler(INT2FLOAT)
+      if (!value(self, x, &a))
+        goto error;
+      check(ifj17_value_is_int(a), TYPE, "int expected");
+      if (!set(self, dst, ifj17_value_double(ifj17_value_as_int(a))))
+        goto error;
+      dispatch();
+
+    handler(FLOAT2INT)
+    handler(FLOAT2R2EINT)
+    handler(FLOAT2R2OINT)
+      if (!value(self, x, &a))
+        goto error;
+      check(ifj17_value_is_double(a), TYPE, "float expected");
+      d = ifj17_value_as_double(a);
+      d = IFJ17_OP_FLOAT2INT == instr->op      ? trunc(d)
+          : IFJ17_OP_FLOAT2R2EINT == instr->op ? nearbyint(d)
+                                               : round(d);
+      check(d >= INT_MIN && d <= INT_MAX, TYPE, "float out of int range");
+      if (!set(self, dst, ifj17_value_int((int)d)))
+        goto error;
+      dispatch();
+
+    handler(INT2CHAR)
+      if (!value(self, x, &a))
+        goto error;
+      check(ifj17_value_is_int(a), TYPE, "int expected");
+      check(ifj17_value_as_int(a) >= 0 && ifj17_value_as_int(a) < 256, STRING,
+            "character code out of range");
+      chr = ifj17_value_as_int(a);
+      if (!build(self, &chr, 1, &a) || !set(self, dst, a))
+        goto error;
+      dispatch();
+
+    handler(STRI2INT)
+    handler(GETCHAR)
+      if (!value(self, x, &a) || !value(self, y, &b))
+        goto error;
+      check(ifj17_value_is_string(a) && ifj17_value_is_int(b), TYPE,
+            "string and int expected");
+      str = ifj17_value_as_string(a);
+      ret = ifj17_value_as_int(b);
+      check(ret >= 0 && ret < str->len, STRING, "index out of range");
+      chr = str->val[ret];
+      if (IFJ17_OP_STRI2INT == instr->op) {
+        a = ifj17_value_int((unsigned char)chr);
+      } else if (!build(self, &chr, 1, &a)) {
+        goto error;
+      }
+      if (!set(self, dst, a))
+        goto error;
+      dispatch();
+
+    handler(SETCHAR)
+      if (!(var = slot(self, dst)) || !value(self, x, &a) || !value(self, y, &b))
+        goto error;
+      check(!ifj17_value_is_nil(*var), MISSING, "uninitialized variable");
+      check(ifj17_value_is_string(*var) && ifj17_value_is_int(a) &&
+                ifj17_value_is_string(b),
+            TYPE, "string, int and string expected");
+      str = ifj17_value_as_string(*var);
+      ret = ifj17_value_as_int(a);
+      check(ret >= 0 && ret < str->len && ifj17_value_as_string(b)->len, STRING,
+            "index out of range");
+      // strings may be shared, so the change is a new one
+      check(buf = reserve(self, str->len + 1), INTERNAL, "out of memory");
+      memcpy(buf, str->val, str->len);
+      buf[ret] = ifj17_value_as_string(b)->val[0];
+      if (!build(self, buf, str->len, &a))
+        goto error;
+      *var = a;
+      dispatch();
+
+    handler(READ)
+      fflush(self->out);
+      if (!read_value(self, x->type, &a) || !set(self, dst, a))
+        goto error;
+      dispatch();
+
+    handler(WRITE)
+      if (!value(self, dst, &a))
+        goto error;
+      write_value(self->out, a);
+      dispatch();
+
+    handler(CONCAT)
+      if (!value(self, x, &a) || !value(self, y, &b))
+        goto error;
+      check(typed(a, b, STRING), TYPE, "string expected");
+      if (!concat(self, ifj17_value_as_string(a), ifj17_value_as_string(b), &a) ||
+          !set(self, dst, a))
+        goto error;
+      dispatch();
+
+    handler(STRLEN)
+      if (!value(self, x, &a))
+        goto error;
+      check(ifj17_value_is_string(a), TYPE, "string expected");
+      if (!set(self, dst, ifj17_value_int(ifj17_value_as_string(a)->len)))
+        goto error;
+      dispatch();
+
+    handler(TYPE)
+      // the one instruction reading uninitialized variables, nil
+      a = x->val.constant;
+      if (IFJ17_VM_VAR == x->kind) {
+        if (!(var = slot(self, x)))
+          goto error;
+        a = *var;
+      }
+      name = type_names[type(a)];
+      if (!string(self, name, strlen(name), &a) || !set(self, dst, a))
+        goto error;
+      dispatch();
+
+    handler(LABEL)
+      dispatch();
+
+    handler(JUMP)
+      jump(dst);
+      dispatch();
+
+    handler(JUMPIFEQ)
+    handler(JUMPIFNEQ)
+      if (!value(self, x, &a) || !value(self, y, &b))
+        goto error;
+      check(type(a) == type(b), TYPE, "comparison of mismatched operands");
+      if (!compare(a, b) == (IFJ17_OP_JUMPIFEQ == instr->op)) {
+        jump(dst);
+      }
+      dispatch();
+
+    handler(BREAK)
+      fprintf(stderr, "break at line %d, instruction %d, %ld executed\n",
+              instr->lineno, ip - 1, self->steps);
+      dispatch();
+
+    handler(DPRINT)
+      if (!value(self, dst, &a))
+        goto error;
+      write_value(stderr, a);
+      dispatch();
+
+    // run the first instruction, then the second's handler
+#define s(op, first, second)                                                        \
+  handler(op) exec_##first();                                                       \
+  advance();                                                                        \
+  goto do_##second;
+    IFJ17_SUPER_LIST
+#undef s
+
+#ifndef THREADED
+    default:
+      check(0, INTERNAL, "invalid opcode");
+    }
+  }
+#endif
+
+done:
+  fflush(self->out);
+  return 1;
+
+error:
+  fflush(self->out);
+  self->lineno = instr->lineno;
+  return 0;
+}
+
+/*
+ * Report the interpreter error to stderr.
+ */
+
+void ifj17_vm_report(ifj17_vm_t *self, const char *filename) {
+  fprintf(stderr, "ifj17(%s). runtime error at IFJcode17 line %d, %s.\n", filename,
+          self->lineno, self->msg);
+}
+
+/*
+ * Output the instructions and slots loaded, the instructions
+ * executed and their profile when kept to stderr.
+ */
+
+void ifj17_vm_inspect(ifj17_vm_t *self) {
+  ifj17_vm_profile_t *profile = self->profile;
+
+  fprintf(stderr, "vm: %zu instructions, %d global and %d local slots, ",
+          kv_size(self->code), slots(self->globals), slots(self->locals));
+  fprintf(stderr, "%u strings, %zu of %zu heap bytes after %d compactions, ",
+          kh_size(self->strings.strs), self->heap_len, self->heap_size,
+          self->compactions);
+  fprintf(stderr, "%ld %s dispatches\n", self->steps,
+          IFJ17_VM_THREADED == ifj17_vm_dispatch_kind ? "threaded" : "switch");
+
+  if (profile) {
+    fprintf(stderr, "  %-14s %10s %10s %10s\n", "opcode", "dispatched", "switch",
+            "threaded");
+    for (int op = 0; op < IFJ17_OPS; ++op) {
+      if (profile->count[op]) {
+        fprintf(stderr, "  %-14s %10ld %10ld %10ld\n", ifj17_op_strings[op],
+                profile->count[op], profile->misses[IFJ17_VM_SWITCH][op],
+                profile->misses[IFJ17_VM_THREADED][op]);
+      }
+    }
+  }
+}
+
+/*
+ * Free the program and the interpreter state.
+ */
+
+void ifj17_vm_free(ifj17_vm_t *self) {
+  while (kv_size(self->frames)) {
+    free(kv_pop(self->frames));
+  }
+
+  free(self->gf);
+  free(self->tf);
+  if (self->labels) {
+    kh_destroy(index, self->labels);
+  }
+  if (self->globals) {
+    kh_destroy(index, self->globals);
+  }
+  if (self->locals) {
+    kh_destroy(index, self->locals);
+  }
+  kv_destroy(self->code);
+  kv_destroy(self->frames);
+  kv_destroy(self->stack);
+  kv_destroy(self->calls);
+  kv_destroy(self->buf);
+  free(self->heap);
+  ifj17_state_free(&self->strings);
+  free(self->source);
 }
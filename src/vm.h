@@ -7,100 +7,184 @@
 #ifndef IFJ17_VM_H
 #define IFJ17_VM_H
 
-#include "ast.h"
-#include <stdint.h>
+#include "khash.h"
+#include "kvec.h"
+#include "opcodes.h"
+#include "value.h"
+#include <stdio.h>
+
+// Smallest string heap size
+#ifndef IFJ17_VM_HEAP_SIZE
+#define IFJ17_VM_HEAP_SIZE (64 * 1024)
+#endif
 
 /*
- * Instruction.
+ * Interpreter errors, by the exit status they are reported with.
  */
 
-typedef uint32_t ifj17_instruction_t;
+typedef enum {
+  IFJ17_VM_OK = 0,
+  IFJ17_VM_SYNTAX = 51,
+  IFJ17_VM_SEMANTIC = 52,
+  IFJ17_VM_TYPE = 53,
+  IFJ17_VM_UNDEFINED = 54,
+  IFJ17_VM_FRAME = 55,
+  IFJ17_VM_MISSING = 56,
+  IFJ17_VM_ZERO = 57,
+  IFJ17_VM_STRING = 58,
+  IFJ17_VM_INTERNAL = 99,
+} ifj17_vm_error;
 
 /*
- * IFJ17 activation record.
+ * Operand kinds.
  */
 
-typedef struct {
-  ifj17_instruction_t *ip;
-  ifj17_instruction_t *code; // TODO: pointer to single malloc()?
-  int nconstants;
-  int *constants;
-} ifj17_activation_t;
+typedef enum {
+  IFJ17_VM_NONE,
+  IFJ17_VM_VAR,
+  IFJ17_VM_CONST,
+  IFJ17_VM_LABEL,
+  IFJ17_VM_TYPE_NAME,
+} ifj17_vm_kind;
 
 /*
- * IFJ17 VM.
+ * Frames.
  */
 
-typedef struct {
-  ifj17_activation_t *main;
-  ifj17_instruction_t *jump;
-} ifj17_vm_t;
+typedef enum { IFJ17_VM_GF, IFJ17_VM_LF, IFJ17_VM_TF } ifj17_vm_frame;
 
 /*
- *   8    8   8   8
- * +----------------+
- * | op | a | b | c |
- * +----------------+
+ * Operand: the `frame` and `name` of a variable, a constant,
+ * a label `name` or the object `type` READ converts to.
+ * Loading resolves a variable to its `index` within the
+ * frame and a label to the `index` of its instruction.
  */
 
-#define ABC(op, a, b, c) (IFJ17_OP_##op << 24 | (a) << 16 | (b) << 8 | (c))
+typedef struct {
+  unsigned char kind;
+  unsigned char frame;
+  unsigned char type;
+  int index;
+  union {
+    char *name;
+    ifj17_value_t constant;
+  } val;
+} ifj17_vm_operand_t;
 
 /*
- *   8    8    16
- * +----------------+
- * | op | a |   b   |
- * +----------------+
+ * Instruction and the source line it was loaded from.
  */
 
-#define AB(op, a, b) (IFJ17_OP_##op << 24 | (a) << 16 | (b) << 8)
+typedef struct {
+  ifj17_op_t op;
+  int lineno;
+  ifj17_vm_operand_t args[3];
+} ifj17_vm_instr_t;
 
 /*
- * Opcode.
+ * Dispatch kinds: a switch over the opcode, one indirect
+ * branch shared by all instructions, or threaded through a
+ * table of handler addresses, an indirect branch ending
+ * each handler.
  */
 
-#define OP(i) ((i) >> 24 & 0xff)
+typedef enum { IFJ17_VM_SWITCH, IFJ17_VM_THREADED } ifj17_vm_dispatch;
 
 /*
- * Operand A.
+ * Dispatch profile, counting by opcode the instructions
+ * executed and the dispatches to them each kind would
+ * mispredict, were each indirect branch predicted to go where
+ * it went last, and by pair of opcodes the times the second
+ * followed the first. `last` and `next` hold opcodes plus
+ * one, 0 before any, so a zeroed profile is empty.
  */
 
-#define A(i) ((i) >> 16 & 0xff)
+typedef struct {
+  long count[IFJ17_OPS];
+  long misses[2][IFJ17_OPS];
+  long pairs[IFJ17_OPS][IFJ17_OPS];
+  int last;
+  int next[IFJ17_OPS];
+} ifj17_vm_profile_t;
 
-/*
- * Operand B.
- */
+// name index hash
 
-#define B(i) ((i) >> 8 & 0xff)
+KHASH_MAP_INIT_STR(index, int);
 
 /*
- * Operand C.
+ * IFJcode17 interpreter.
+ *
+ * A program is loaded from text into `code`, keeping the
+ * source its names point into. `labels` indexes the
+ * instructions by label, `globals` the GF slots by name and
+ * `locals` the LF and TF slots, all local frames sharing
+ * one layout. A frame is an array of value slots, nil once
+ * defined until assigned. The string constants and type
+ * names are interned into `strings`, living as long as the
+ * interpreter. Strings made at run time are built in `buf`,
+ * then copied into the `heap`, its first `heap_len` of
+ * `heap_size` bytes taken. A full heap is compacted: the
+ * strings the frames and the data stack hold move to a new
+ * one, counted in `compactions`, and the rest are dropped.
+ * Strings compare by content, whichever kind they are.
+ * Unless `resolve` is cleared, execution goes by the
+ * indexes alone and never hashes a name. Unless `fuse` is
+ * cleared, loading also drops the labels and fuses pairs of
+ * instructions into superinstructions, so the same program
+ * takes fewer `steps`, the dispatches counted, and into
+ * `profile` when set. READ and WRITE go through `in` and
+ * `out`. The first error stops the program and is kept with
+ * its line and message.
  */
 
-#define C(i) ((i)&0xff)
+typedef struct {
+  char *source;
+  kvec_t(ifj17_vm_instr_t) code;
+  khash_t(index) * labels;
+  khash_t(index) * globals;
+  khash_t(index) * locals;
+  int resolve;
+  int fuse;
+  // state
+  ifj17_value_t *gf;
+  ifj17_value_t *tf;
+  kvec_t(ifj17_value_t *) frames;
+  kvec_t(ifj17_value_t) stack;
+  ifj17_state_t strings;
+  kvec_t(char) buf;
+  char *heap;
+  size_t heap_len;
+  size_t heap_size;
+  int compactions;
+  kvec_t(int) calls;
+  FILE *in;
+  FILE *out;
+  long steps;
+  ifj17_vm_profile_t *profile;
+  // error
+  ifj17_vm_error error;
+  int lineno;
+  const char *msg;
+} ifj17_vm_t;
 
 /*
- * Register n.
+ * Dispatch kind ifj17_eval was built with.
  */
 
-#define R(n) registers[n]
+extern const ifj17_vm_dispatch ifj17_vm_dispatch_kind;
 
-/*
- * Constant n.
- */
+// protoypes
 
-#define K(n) vm->main->constants[(n)-32]
+void ifj17_vm_init(ifj17_vm_t *self);
 
-/*
- * Register or constant.
- */
+int ifj17_vm_load(ifj17_vm_t *self, const char *source, size_t len);
 
-// TODO: MSB
-#define RK(n) ((n) < 32 ? R(n) : K(n))
+int ifj17_eval(ifj17_vm_t *self);
 
-// protoypes
+void ifj17_vm_report(ifj17_vm_t *self, const char *filename);
 
-ifj17_object_t *ifj17_eval(ifj17_vm_t *vm);
+void ifj17_vm_inspect(ifj17_vm_t *self);
 
-void ifj17_vm_free(ifj17_vm_t *vm);
+void ifj17_vm_free(ifj17_vm_t *self);
 
 #endif /* IFJ17_VM_H */
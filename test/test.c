@@ -1,18 +1,32 @@
+#include "arena.h"
+#include "ast.h"
 #include "codegen.h"
+#include "emitter.h"
 #include "errors.h"
+#include "fold.h"
 #include "hash.h"
+#include "ir.h"
 #include "khash.h"
 #include "lexer.h"
+#include "lower.h"
 #include "object.h"
 #include "parser.h"
+#include "peephole.h"
+#include "pipeline.h"
 #include "prettyprint.h"
+#include "semantic.h"
+#include "simd.h"
 #include "state.h"
+#include "symtab.h"
 #include "utils.h"
+#include "value.h"
 #include "vec.h"
 #include "vm.h"
 #include <assert.h>
+#include <limits.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
@@ -77,6 +91,61 @@ static void unit_test_value_is() {
 
   ifj17_object_t two = {.type = IFJ17_TYPE_NULL};
   assert(ifj17_is_null(&two));
+
+  // strings own a copy
+  char buf[] = "three";
+  ifj17_object_t *three = ifj17_string_new(buf);
+  buf[0] = 'T';
+  assert(ifj17_is_string(three));
+  assert(!strcmp("three", three->value.as_pointer));
+  ifj17_object_free(three);
+}
+
+/*
+ * Test NaN-boxed values.
+ */
+
+static void unit_test_value() {
+  ifj17_state_t state;
+  ifj17_string_t *str;
+  ifj17_value_t val;
+  double nan = 0.0 / 0.0;
+
+  val = ifj17_value_int(-42);
+  assert(IFJ17_TYPE_INT == ifj17_value_type(val));
+  assert(ifj17_value_is_int(val) && !ifj17_value_is_double(val));
+  assert(-42 == ifj17_value_as_int(val));
+  assert(INT_MIN == ifj17_value_as_int(ifj17_value_int(INT_MIN)));
+
+  val = ifj17_value_bool(5);
+  assert(IFJ17_TYPE_BOOL == ifj17_value_type(val));
+  assert(ifj17_value_is_bool(val) && !ifj17_value_is_int(val));
+  assert(1 == ifj17_value_as_bool(val));
+  assert(ifj17_value_bool(1) != ifj17_value_int(1));
+
+  assert(IFJ17_TYPE_NULL == ifj17_value_type(ifj17_nil));
+  assert(ifj17_value_is_nil(ifj17_nil) && !ifj17_value_is_bool(ifj17_nil));
+
+  // doubles are their own bits, NaNs kept clear of the boxes
+  double doubles[] = {0.0, -0.0, 1.5, -1e308, 1.0 / 0.0, -1.0 / 0.0};
+  for (int i = 0; i < 6; ++i) {
+    val = ifj17_value_double(doubles[i]);
+    assert(IFJ17_TYPE_DOUBLE == ifj17_value_type(val));
+    assert(!memcmp(&doubles[i], &val, sizeof(val)));
+  }
+  val = ifj17_value_double(-nan);
+  assert(IFJ17_TYPE_DOUBLE == ifj17_value_type(val));
+  assert(ifj17_value_as_double(val) != ifj17_value_as_double(val));
+
+  // strings point to their interned copy
+  ifj17_state_init(&state);
+  str = ifj17_string(&state, "hello");
+  val = ifj17_value_string(str);
+  assert(IFJ17_TYPE_STRING == ifj17_value_type(val));
+  assert(ifj17_value_is_string(val) && !ifj17_value_is_double(val));
+  assert(str == ifj17_value_as_string(val));
+  assert(val == ifj17_value_string(ifj17_string_intern(&state, "hello!", 5)));
+  ifj17_state_free(&state);
 }
 
 /*
@@ -339,6 +408,409 @@ static void unit_test_string() {
   assert(strcmp("foo", str->val) == 0);
 
   assert(kh_size(state.strs) == 2);
+
+  // identifiers fold case, sharing the literal's handle
+  ifj17_string_t *id = ifj17_identifier(&state, "FOO", 3);
+  assert(id == str);
+  assert(id == ifj17_identifier(&state, "Foo bar", 3));
+  assert(ifj17_string_intern(&state, "FOO", 3) != id);
+  assert(state.nidents == 2);
+  assert(state.nidents_unique == 1);
+  assert(kh_size(state.strs) == 3);
+
+  ifj17_state_free(&state);
+}
+
+/*
+ * Test keyword recognition.
+ */
+
+static void unit_test_keywords() {
+  ifj17_lexer_t lex;
+  const char *keywords[] = {"if",    "or",     "as",     "do",      "for",
+                            "end",   "dim",    "and",    "not",     "else",
+                            "type",  "then",   "loop",   "while",   "scope",
+                            "print", "input",  "elseif", "return",  "declare",
+                            "function"};
+
+  ifj17_lexer_init(&lex, "IF Or aS dO FOR end Dim AND not ELSE type Then LOOP "
+                         "While SCOPE print Input ElseIf RETURN declare Function",
+                   "keywords");
+  for (int i = 0; i < sizeof(keywords) / sizeof(keywords[0]); ++i) {
+    assert(ifj17_scan(&lex));
+    assert(strcmp(keywords[i], ifj17_token_type_string(lex.tok.type)) == 0);
+    assert(lex.tok.len == strlen(keywords[i]));
+  }
+  assert(!ifj17_scan(&lex));
+
+  ifj17_lexer_init(&lex, "i if_ fo en0 elsif functions Loop2 _do", "ids");
+  while (ifj17_scan(&lex)) {
+    assert(lex.tok.type == IFJ17_TOKEN_ID);
+  }
+  assert(lex.tok.type == IFJ17_TOKEN_EOS);
+}
+
+/*
+ * Test string escapes are validated: \xhh takes two hex
+ * digits and \ddd is at most 255.
+ */
+
+static void unit_test_string_escapes() {
+  ifj17_lexer_t lex;
+  const char *bad[] = {"!\"\\256\"", "!\"a\\999b\"", "!\"\\x4g\""};
+
+  ifj17_lexer_init(&lex, "!\"\\255\\7\\x4A\\1234\" !\"\\0\"", "escapes");
+  assert(ifj17_scan(&lex) && IFJ17_TOKEN_STRING == lex.tok.type);
+  assert(ifj17_scan(&lex) && IFJ17_TOKEN_STRING == lex.tok.type);
+  assert(!ifj17_scan(&lex) && !lex.error);
+
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+    ifj17_lexer_init(&lex, bad[i], "escapes");
+    assert(!ifj17_scan(&lex) && lex.error);
+  }
+}
+
+/*
+ * Generate `size` bytes of token soup into `buf`, nul-terminated.
+ */
+
+static void generate_source(char *buf, size_t size) {
+  const char *parts[] = {
+      " ",       "\t",     "  \t  ",    "\n",          "\r\n",          "x",
+      "Ident_9", "_a1",    "LOOP",      "elseif",      "FunctionName", "0",
+      "42",      "1_000",  "3.25e2",    "7E-1",        "0x1F",         "123456789",
+      "'line\n", "'/",     "/' blk '/", "/' a\nb '/", "!\"str\\n\"",    "!\"\\x41\"",
+      "+",       "<>",     "<=",        "(",           ",",            "\xc3\xa9",
+      "Zyx",     "azAZ09", "@",         "[",           "`",            "{:",
+  };
+  size_t n = sizeof(parts) / sizeof(parts[0]), len = 0;
+
+  srand(17);
+  while (len < size - 64) {
+    const char *part = parts[rand() % n];
+    int times = 1 + rand() % 3;
+    while (times--) {
+      len += sprintf(buf + len, "%s", part);
+    }
+
+    // long runs crossing vector boundaries
+    if (rand() % 16 == 0) {
+      int run = rand() % 70;
+      char c = " a7"[rand() % 3];
+      memset(buf + len, c, run);
+      len += run;
+    }
+  }
+
+  // a comment running into the terminator
+  strcpy(buf + len, "' trailing");
+}
+
+/*
+ * Generate up to `size` bytes of valid declarations
+ * and prints into `buf`, nul-terminated.
+ */
+
+static void generate_program(char *buf, size_t size) {
+  const char *line = "dim x_%d as double = 3.5e%d ' comment\nprint !\"%d\";\n";
+  size_t len = 0;
+  for (int i = 0; len < size - 128; ++i) {
+    len += sprintf(buf + len, line, i, i % 10, i);
+  }
+}
+
+/*
+ * Test SIMD fast paths produce the scalar token stream.
+ */
+
+static void unit_test_simd_differential() {
+  static char source[1 << 16], buf[(1 << 16) + 64];
+  generate_source(source, sizeof(source));
+
+  for (int level = IFJ17_SIMD_SSE2; level <= IFJ17_SIMD_AVX2; ++level) {
+    const ifj17_simd_t *simd = ifj17_simd(level);
+    if (!simd) {
+      continue;
+    }
+
+    // every alignment of the source start
+    for (int align = 0; align < 32; ++align) {
+      char *str = buf + align;
+      strcpy(str, source);
+
+      ifj17_lexer_t a, b;
+      ifj17_lexer_init(&a, str, "scalar");
+      ifj17_lexer_init(&b, str, simd->name);
+      a.simd = ifj17_simd(IFJ17_SIMD_SCALAR);
+      b.simd = simd;
+
+      int ra, rb;
+      do {
+        ra = ifj17_scan(&a);
+        rb = ifj17_scan(&b);
+        assert(ra == rb);
+        assert(a.tok.type == b.tok.type);
+        assert(a.offset == b.offset);
+        assert(a.lineno == b.lineno);
+        assert(a.error == b.error);
+        if (a.tok.type == IFJ17_TOKEN_INT)
+          assert(a.tok.value.as_int == b.tok.value.as_int);
+        if (a.tok.type == IFJ17_TOKEN_DOUBLE)
+          assert(a.tok.value.as_double == b.tok.value.as_double);
+        if (a.tok.type == IFJ17_TOKEN_ID || a.tok.type == IFJ17_TOKEN_STRING) {
+          assert(a.tok.offset == b.tok.offset);
+          assert(a.tok.len == b.tok.len);
+        }
+        if (!ra && a.tok.type == IFJ17_TOKEN_ILLEGAL) {
+          // resume past the illegal character
+          ra = rb = 1;
+        }
+      } while (ra);
+    }
+  }
+}
+
+/*
+ * Test batch lexing and parser lookahead match ifj17_scan.
+ */
+
+static void unit_test_lex_batch() {
+  static char source[1 << 16];
+  generate_program(source, sizeof(source));
+
+  ifj17_lexer_t a, b;
+  size_t len;
+  ifj17_lexer_init(&a, source, "scan");
+  ifj17_lexer_init(&b, source, "batch");
+  ifj17_token_t *toks = ifj17_lex_all(&b, &len);
+  assert(toks && len > IFJ17_TOKEN_BLOCK);
+
+  for (size_t i = 0; i < len; ++i) {
+    int more = ifj17_scan(&a);
+    assert(a.tok.type == toks[i].type);
+    assert(a.tok.lineno == toks[i].lineno);
+    assert(a.tok.offset == toks[i].offset);
+    assert(a.tok.len == toks[i].len);
+    assert(!!more == (i + 1 < len));
+  }
+
+  // lookahead across ring refills
+  ifj17_state_t state;
+  ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&b, source, "peek");
+  ifj17_parser_init(parser, &b, &state);
+
+  for (size_t i = 0; i + 1 < len; i += 7) {
+    for (int n = 1; n < 64 && i + n < len; n += 13) {
+      ifj17_token_t *tok = ifj17_parser_peek(parser, n);
+      assert(tok->offset == toks[i + n - 1].offset);
+      assert(tok->type == toks[i + n - 1].type);
+    }
+    for (int n = 0; n < 7; ++n) {
+      ifj17_parser_peek(parser, 1);
+      ++parser->pos;
+    }
+  }
+  assert(!ifj17_parser_peek(parser, IFJ17_TOKEN_RING));
+
+  ifj17_state_free(&state);
+  free(parser);
+  free(toks);
+}
+
+/*
+ * Test the lexer thread hands over the ifj17_lex token stream.
+ */
+
+static void unit_test_pipeline() {
+  static char source[1 << 18];
+  size_t len;
+  generate_program(source, sizeof(source));
+
+  ifj17_lexer_t a, b;
+  ifj17_lexer_init(&a, source, "batch");
+  ifj17_lexer_init(&b, source, "pipeline");
+  ifj17_token_t *toks = ifj17_lex_all(&a, &len);
+  ifj17_pipeline_t *pipe = malloc(sizeof(ifj17_pipeline_t));
+  assert(toks && pipe);
+  assert(ifj17_pipeline_start(pipe, &b));
+
+  // odd read sizes straddle blocks
+  ifj17_token_t buf[IFJ17_TOKEN_BLOCK];
+  size_t i = 0;
+  while (i < len) {
+    int n = ifj17_pipeline_read(pipe, buf, 1 + i % 1500 % IFJ17_TOKEN_BLOCK);
+    for (int j = 0; j < n; ++j, ++i) {
+      assert(buf[j].type == toks[i].type);
+      assert(buf[j].offset == toks[i].offset);
+      assert(buf[j].lineno == toks[i].lineno);
+    }
+  }
+  assert(i == len);
+
+  // the last token repeats
+  assert(1 == ifj17_pipeline_read(pipe, buf, 8));
+  assert(buf[0].type == IFJ17_TOKEN_EOS);
+
+  ifj17_pipeline_stop(pipe);
+  assert(b.offset == a.offset);
+  free(pipe);
+  free(toks);
+}
+
+/*
+ * Test the parser recovers at statement boundaries,
+ * collecting one diagnostic per broken statement.
+ */
+
+static void unit_test_recovery() {
+  const char *source = "scope\n"
+                       "dim a as integer\n"
+                       "a = a +;\n"
+                       "print a; @\n"
+                       "if a then\n"
+                       "  a = )\n"
+                       "else\n"
+                       "  a = a * * 2\n"
+                       "end if\n"
+                       "do while a\n"
+                       "  a = a -;\n"
+                       "loop\n"
+                       "end scope\n";
+  int lines[] = {3, 4, 6, 8, 11};
+  const char *types[] = {"parse", "syntax", "parse", "parse", "parse"};
+
+  ifj17_state_t state;
+  ifj17_lexer_t lex;
+  ifj17_parser_t *parser = malloc(sizeof(ifj17_parser_t));
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lex, source, "recovery");
+  ifj17_parser_init(parser, &lex, &state);
+  parser->recover = 1;
+
+  assert(!ifj17_parse(parser));
+  assert(parser->ndiagnostics == 5);
+  ifj17_diagnostic_t *diag = parser->diagnostics;
+  for (int i = 0; i < 5; ++i, diag = diag->next) {
+    assert(diag->lineno == lines[i]);
+    assert(!strcmp(diag->type, types[i]));
+  }
+  assert(!diag);
+
+  // nothing to recover from
+  ifj17_lexer_init(&lex, "scope\ndim a as integer\na = a + 1\nend scope\n", "ok");
+  ifj17_parser_init(parser, &lex, &state);
+  parser->recover = 1;
+  assert(ifj17_parse(parser));
+  assert(!parser->diagnostics);
+
+  ifj17_state_free(&state);
+  free(parser);
+}
+
+/*
+ * Test arena.
+ */
+
+static void unit_test_arena() {
+  ifj17_arena_t arena;
+  ifj17_arena_init(&arena);
+
+  int *a = ifj17_arena_alloc(&arena, sizeof(int));
+  int *b = ifj17_arena_alloc(&arena, sizeof(int));
+  *a = 1;
+  *b = 2;
+  assert(a != b);
+  assert(*a == 1 && *b == 2);
+  assert(arena.nallocs == 2);
+  assert(arena.nchunks == 1);
+
+  // chunk chaining
+  char *big = ifj17_arena_alloc(&arena, IFJ17_ARENA_CHUNK_SIZE * 2);
+  assert(big);
+  assert(arena.nchunks == 2);
+  assert(*a == 1);
+
+  // grow in place
+  int *vals = ifj17_arena_alloc(&arena, 2 * sizeof(int));
+  vals[0] = 1;
+  vals[1] = 2;
+  int *grown = ifj17_arena_grow(&arena, vals, 2 * sizeof(int), 64 * sizeof(int));
+  assert(grown[0] == 1 && grown[1] == 2);
+
+  // grow by copy
+  ifj17_arena_alloc(&arena, 8);
+  int *copied = ifj17_arena_grow(&arena, grown, 64 * sizeof(int), 128 * sizeof(int));
+  assert(copied != grown);
+  assert(copied[0] == 1 && copied[1] == 2);
+
+  const char *str = ifj17_arena_strndup(&arena, "foo bar", 3);
+  assert(strcmp("foo", str) == 0);
+
+  ifj17_node_vec_t *vec = ifj17_node_vec_new(&arena);
+  ifj17_node_t *nodes[100];
+  for (int i = 0; i < 100; ++i) {
+    nodes[i] = (ifj17_node_t *)ifj17_int_node_new(&arena, i, 1);
+    ifj17_node_vec_push(&arena, vec, nodes[i]);
+  }
+  assert(ifj17_node_vec_length(vec) == 100);
+  assert(ifj17_node_vec_at(vec, 99) == nodes[99]);
+
+  int k = 0;
+  ifj17_node_vec_each(vec, { assert(((ifj17_int_node_t *)val)->val == k++); });
+  assert(k == 100);
+
+  ifj17_arena_release(&arena);
+  assert(arena.head == NULL);
+  assert(arena.nallocs == 0);
+}
+
+/*
+ * Test emitter formats like printf and grows past its first buffer.
+ */
+
+static void unit_test_emitter() {
+  ifj17_emitter_t out;
+  char buf[64], expected[64];
+  double doubles[] = {0, -0.0, 1.5, -2, 1e6, 123456.0, 0.1, 1e-7, 3e20};
+
+  ifj17_emitter_init(&out);
+  ifj17_emit_int_literal(&out, -2147483647 - 1);
+  ifj17_emit_str(&out, " ");
+  ifj17_emit_var(&out, "GF", "foo", 3);
+  ifj17_emit_str(&out, " ");
+  ifj17_emit_label(&out, "END_IF", 42);
+  assert(ifj17_emitter_copy(&out, buf, sizeof(buf)) == strlen(buf));
+  assert(strcmp("int@-2147483648 GF@foo END_IF_42", buf) == 0);
+  ifj17_emitter_free(&out);
+
+  for (int i = 0; i < sizeof(doubles) / sizeof(double); ++i) {
+    ifj17_emitter_init(&out);
+    ifj17_emit_float_literal(&out, doubles[i]);
+    ifj17_emitter_copy(&out, buf, sizeof(buf));
+    snprintf(expected, sizeof(expected), "float@%g", doubles[i]);
+    assert(strcmp(expected, buf) == 0);
+    ifj17_emitter_free(&out);
+  }
+
+  // escapes resolved, \ddd clamped, bytes past 0x7f kept
+  const char *str = "a #\\n\\x4a\\\"\\300\xc3\xa9";
+  ifj17_emitter_init(&out);
+  ifj17_emit_string_literal(&out, str, strlen(str));
+  ifj17_emitter_copy(&out, buf, sizeof(buf));
+  assert(strcmp("string@a\\032\\035\\010J\"\xff\xc3\xa9", buf) == 0);
+  ifj17_emitter_free(&out);
+
+  // growth and truncated copies
+  ifj17_emitter_init(&out);
+  for (int i = 0; i < IFJ17_EMITTER_SIZE; ++i) {
+    ifj17_emit_str(&out, "ADD ");
+  }
+  assert(out.len == 4 * IFJ17_EMITTER_SIZE && !out.failed);
+  assert(ifj17_emitter_copy(&out, buf, 5) == out.len);
+  assert(strcmp("ADD ", buf) == 0);
+  ifj17_emitter_free(&out);
 }
 
 /*
@@ -346,6 +818,7 @@ static void unit_test_string() {
  */
 
 static void _test_parser(const char *base_path) {
+  ifj17_state_t state;
   ifj17_lexer_t lexer;
   ifj17_parser_t parser;
   ifj17_block_node_t *root;
@@ -364,8 +837,9 @@ static void _test_parser(const char *base_path) {
   char *expected = file_read(out_path);
   assert(expected != NULL);
 
+  ifj17_state_init(&state);
   ifj17_lexer_init(&lexer, source, source_path);
-  ifj17_parser_init(&parser, &lexer);
+  ifj17_parser_init(&parser, &lexer, &state);
 
   if (!(root = ifj17_parse(&parser))) {
     ifj17_report_error(&parser);
@@ -377,6 +851,8 @@ static void _test_parser(const char *base_path) {
   ifj17_set_prettyprint_func(bprintf);
   ifj17_prettyprint((ifj17_node_t *)root);
 
+  ifj17_state_free(&state);
+
   // DEBUG
   // printf("%s\n", print_buf);
   // printf("%s\n", expected);
@@ -392,6 +868,7 @@ static void _test_parser(const char *base_path) {
 // Test code generator
 
 static void _test_codegen(const char *base_path) {
+  ifj17_state_t state;
   ifj17_lexer_t lexer;
   ifj17_parser_t parser;
   ifj17_block_node_t *root;
@@ -410,23 +887,28 @@ static void _test_codegen(const char *base_path) {
   char *expected = file_read(out_path);
   assert(expected != NULL);
 
+  ifj17_state_init(&state);
   ifj17_lexer_init(&lexer, source, source_path);
-  ifj17_parser_init(&parser, &lexer);
+  ifj17_parser_init(&parser, &lexer, &state);
 
   if (!(root = ifj17_parse(&parser))) {
     ifj17_report_error(&parser);
     exit(1);
   }
 
-  char buf[1024] = {0};
+  ifj17_semantic_t sem;
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+
+  char buf[4096] = {0};
   print_buf = buf;
-  ifj17_vm_t *vm = ifj17_gen((ifj17_node_t *)root);
+  ifj17_codegen_ctx_t context;
+  ifj17_codegen_ctx_init(&context);
+  assert(ifj17_codegen(&context, (ifj17_node_t *)root));
+  assert(ifj17_emitter_copy(&context.out, buf, sizeof(buf)) < sizeof(buf));
+  ifj17_codegen_ctx_free(&context);
 
-  // ifj17_object_t *obj = ifj17_eval(vm);
-  //
-  // ifj17_object_inspect(obj);
-  // ifj17_object_free(obj);
-  ifj17_vm_free(vm);
+  ifj17_state_free(&state);
 
   // DEBUG
   // printf("%s\n", print_buf);
@@ -440,6 +922,870 @@ static void _test_codegen(const char *base_path) {
   assert(strcmp(expected, print_buf) == 0);
 }
 
+/*
+ * Test code generation leaves no state behind, so a
+ * second run over the same tree prints the same code.
+ */
+
+static void unit_test_codegen_reentrant() {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  char first[4096] = {0}, second[4096] = {0};
+
+  char *source = file_read("test/acceptance/conditions/if-elseif-else2x.ifj17");
+  assert(source != NULL);
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer, source, "reentrant");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+
+  ifj17_semantic_t sem;
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+
+  ifj17_codegen_ctx_t context;
+  ifj17_codegen_ctx_init(&context);
+  assert(ifj17_codegen(&context, (ifj17_node_t *)root));
+  ifj17_emitter_copy(&context.out, first, sizeof(first));
+  ifj17_codegen_ctx_free(&context);
+
+  ifj17_codegen_ctx_init(&context);
+  assert(ifj17_codegen(&context, (ifj17_node_t *)root));
+  ifj17_emitter_copy(&context.out, second, sizeof(second));
+  ifj17_codegen_ctx_free(&context);
+
+  assert(*first && !strcmp(first, second));
+  ifj17_state_free(&state);
+  free(source);
+}
+
+/*
+ * Test functions generated on worker threads come out in
+ * source order, byte-identical to generating them serially.
+ */
+
+static void unit_test_codegen_parallel() {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  ifj17_codegen_ctx_t serial, parallel;
+  char *source = malloc(64 * 1024), *p = source;
+
+  for (int i = 0; i < 100; ++i) {
+    p += sprintf(p, "function f%d (n as integer) as integer\n"
+                    "if n = %d then\nreturn 1\nend if\n"
+                    "do while n = 1\nn = n + 1\nloop\n"
+                    "end function\n",
+                 i, i);
+  }
+  strcpy(p, "scope\ndim a as integer\nif a = 1 then\na = 2\nend if\nend scope\n");
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer, source, "parallel");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+
+  ifj17_semantic_t sem;
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+
+  ifj17_codegen_ctx_init(&serial);
+  assert(ifj17_codegen(&serial, (ifj17_node_t *)root));
+  ifj17_codegen_ctx_init(&parallel);
+  parallel.jobs = 8;
+  assert(ifj17_codegen(&parallel, (ifj17_node_t *)root));
+
+  assert(serial.out.len == parallel.out.len);
+  assert(!memcmp(serial.out.buf, parallel.out.buf, serial.out.len));
+
+  // labels live in their function's namespace
+  ifj17_emit_str(&serial.out, "\0");
+  char *f0 = strstr(serial.out.buf, "LABEL f0\n");
+  char *f99 = strstr(serial.out.buf, "LABEL f99\n");
+  assert(f0 && f99 && f0 < f99);
+  assert(strstr(f0, "JUMPIFNEQ f0$ELSE_1 TF@n int@0\n"));
+  assert(strstr(f99, "LABEL f99$LOOP_2\n"));
+  assert(strstr(f99, "LABEL Scope\n"));
+  assert(strstr(f99, "LABEL END_IF_0\n"));
+
+  ifj17_codegen_ctx_free(&serial);
+  ifj17_codegen_ctx_free(&parallel);
+  ifj17_state_free(&state);
+  free(source);
+}
+
+/*
+ * Test lowering splits code into basic blocks at labels and
+ * jumps, computing conversions into typed temporaries.
+ */
+
+static void unit_test_ir() {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+  ifj17_emitter_t out;
+  ifj17_ir_t ir;
+  char buf[1024];
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer,
+                   "function f (n as integer) as double\n"
+                   "do while n < 3\nn = n + 1\nloop\nreturn n\nend function\n"
+                   "scope\ndim d as double\nd = f(1) * 2\nend scope\n",
+                   "ir");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+  assert(ifj17_lower(&ir, (ifj17_node_t *)root));
+
+  assert(kv_size(ir.funcs) == 2);
+  ifj17_ir_func_t *f = kv_A(ir.funcs, 0);
+  assert(f->nparams == 1 && f->datatype == IFJ17_DATATYPE_DOUBLE);
+  assert(kv_size(f->blocks) == 3 && kv_size(f->code) == 6);
+  assert(kv_A(f->blocks, 0).label == 0 && kv_A(f->blocks, 1).label == -1);
+  assert(kv_size(f->temps) == 2);
+  assert(kv_A(f->temps, 0) == IFJ17_DATATYPE_BOOLEAN);
+  assert(kv_A(f->temps, 1) == IFJ17_DATATYPE_DOUBLE);
+
+  ifj17_emitter_init(&out);
+  ifj17_ir_dump(&ir, &out);
+  ifj17_emitter_copy(&out, buf, sizeof(buf));
+  assert(!strcmp(buf, "function f\n"
+                      "  param n integer\n"
+                      "LOOP_0:\n"
+                      "  %0 = LT n, 3\n"
+                      "  JUMPIFEQ END_LOOP_1 %0, false\n"
+                      "-:\n"
+                      "  n = ADD n, 1\n"
+                      "  JUMP LOOP_0\n"
+                      "END_LOOP_1:\n"
+                      "  %1 = INT2FLOAT n\n"
+                      "  RETURN %1\n"
+                      "\n"
+                      "scope\n"
+                      "  local d double\n"
+                      "-:\n"
+                      "  d = MOVE 0\n"
+                      "  ARG 1\n"
+                      "  %0 = CALL f\n"
+                      "  d = MUL %0, 2\n"));
+
+  ifj17_emitter_free(&out);
+  ifj17_ir_free(&ir);
+  ifj17_state_free(&state);
+}
+
+/*
+ * Test folding evaluates constant expressions by the IFJ17
+ * rules and propagates constant-initialized variables.
+ */
+
+static void unit_test_fold() {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+  ifj17_emitter_t out;
+  ifj17_ir_t ir;
+  char buf[1024];
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer,
+                   "scope\ndim k as integer = 7 \\ 2 + 2 * 3\n"
+                   "dim x as double = 1 / 4\ndim s as string = !\"ab\" + !\"c\"\n"
+                   "dim n as integer\ninput n\n"
+                   "if k = 9 then\nprint s; x + k; n \\ 0;\nend if\n"
+                   "if s = !\"c\" then\nprint 1 / 3;\nend if\nend scope\n",
+                   "fold");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+  assert(ifj17_lower(&ir, (ifj17_node_t *)root));
+  assert(ifj17_fold(kv_A(ir.funcs, 0)));
+
+  // division by zero and inexact quotients are left to run time
+  ifj17_emitter_init(&out);
+  ifj17_ir_dump(&ir, &out);
+  ifj17_emitter_copy(&out, buf, sizeof(buf));
+  assert(!strcmp(buf, "scope\n"
+                      "  local k integer\n"
+                      "  local x double\n"
+                      "  local s string\n"
+                      "  local n integer\n"
+                      "-:\n"
+                      "  n = MOVE 0\n"
+                      "  WRITE !\"? \"\n"
+                      "  n = READ integer\n"
+                      "-:\n"
+                      "  WRITE !\"abc\"\n"
+                      "  WRITE 9.25\n"
+                      "  %5 = INT2FLOAT n\n"
+                      "  %6 = DIV %5, 0\n"
+                      "  %7 = FLOAT2INT %6\n"
+                      "  WRITE %7\n"
+                      "  JUMP END_IF_0\n"
+                      "ELSE_1:\n"
+                      "END_IF_0:\n"
+                      "  JUMP ELSE_3\n"
+                      "-:\n"
+                      "  %8 = DIV 1, 3\n"
+                      "  WRITE %8\n"
+                      "  JUMP END_IF_2\n"
+                      "ELSE_3:\n"
+                      "END_IF_2:\n"));
+
+  ifj17_emitter_free(&out);
+  ifj17_ir_free(&ir);
+  ifj17_state_free(&state);
+}
+
+/*
+ * Test a local assigned a constant in a branch is not
+ * propagated past it, the IR being that of
+ * "if c > 1 then / dim x as integer = 5 / print x; / else /
+ * print c; / end if / print x;" with names per function.
+ */
+
+static void unit_test_fold_branch() {
+  ifj17_state_t state;
+  ifj17_emitter_t out;
+  ifj17_ir_func_t func;
+  ifj17_ir_operand_t none = ifj17_ir_none();
+  char buf[512];
+
+  ifj17_state_init(&state);
+  ifj17_ir_func_init(&func, NULL);
+  ifj17_ir_local_t locals[] = {
+      {ifj17_string_intern(&state, "c", 1), IFJ17_DATATYPE_INTEGER},
+      {ifj17_string_intern(&state, "x", 1), IFJ17_DATATYPE_INTEGER}};
+  kv_push(ifj17_ir_local_t, func.locals, locals[0]);
+  kv_push(ifj17_ir_local_t, func.locals, locals[1]);
+
+  ifj17_ir_operand_t c =
+      ifj17_ir_operand(IFJ17_IR_LOCAL, IFJ17_DATATYPE_INTEGER, index, 0);
+  ifj17_ir_operand_t x =
+      ifj17_ir_operand(IFJ17_IR_LOCAL, IFJ17_DATATYPE_INTEGER, index, 1);
+  ifj17_ir_operand_t type =
+      ifj17_ir_operand(IFJ17_IR_TYPE, IFJ17_DATATYPE_INTEGER, index, 0);
+  ifj17_ir_operand_t test = ifj17_ir_temp(&func, IFJ17_DATATYPE_BOOLEAN);
+  int end = ifj17_ir_label(&func, "END_IF"), other = ifj17_ir_label(&func, "ELSE");
+
+  ifj17_ir_emit(&func, IFJ17_IR_MOVE, c, ifj17_ir_int(0), none);
+  ifj17_ir_emit(&func, IFJ17_IR_READ, c, type, none);
+  ifj17_ir_emit(&func, IFJ17_IR_GT, test, c, ifj17_ir_int(1));
+  ifj17_ir_emit(&func, IFJ17_IR_JUMPIFEQ, ifj17_ir_label_operand(other), test,
+                ifj17_ir_bool(0));
+  ifj17_ir_emit(&func, IFJ17_IR_MOVE, x, ifj17_ir_int(5), none);
+  ifj17_ir_emit(&func, IFJ17_IR_WRITE, none, x, none);
+  ifj17_ir_emit(&func, IFJ17_IR_JUMP, ifj17_ir_label_operand(end), none, none);
+  ifj17_ir_place(&func, other);
+  ifj17_ir_emit(&func, IFJ17_IR_WRITE, none, c, none);
+  ifj17_ir_place(&func, end);
+  ifj17_ir_emit(&func, IFJ17_IR_WRITE, none, x, none);
+  assert(!func.failed && ifj17_fold(&func));
+
+  // the else path reaches the last print without x
+  ifj17_emitter_init(&out);
+  ifj17_ir_dump_func(&func, &out);
+  ifj17_emitter_copy(&out, buf, sizeof(buf));
+  assert(!strcmp(buf, "scope\n"
+                      "  local c integer\n"
+                      "  local x integer\n"
+                      "-:\n"
+                      "  c = MOVE 0\n"
+                      "  c = READ integer\n"
+                      "  %0 = GT c, 1\n"
+                      "  JUMPIFEQ ELSE_1 %0, false\n"
+                      "-:\n"
+                      "  x = MOVE 5\n"
+                      "  WRITE 5\n"
+                      "  JUMP END_IF_0\n"
+                      "ELSE_1:\n"
+                      "  WRITE c\n"
+                      "END_IF_0:\n"
+                      "  WRITE x\n"));
+
+  ifj17_emitter_free(&out);
+  ifj17_ir_func_free(&func);
+  ifj17_state_free(&state);
+}
+
+static void unit_test_peephole() {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+  ifj17_emitter_t out;
+  ifj17_ir_t ir;
+  ifj17_ir_func_t *func;
+  int hits[IFJ17_PEEPHOLE_RULES] = {0};
+  char buf[1024];
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer,
+                   "scope\ndim x as integer\ninput x\n"
+                   "if x = 1 then\nprint x;\nend if\nend scope\n",
+                   "peephole");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+  assert(ifj17_lower(&ir, (ifj17_node_t *)root));
+  func = kv_A(ir.funcs, 0);
+
+  // x = x + 1 through a temporary, then x = x through another
+  ifj17_ir_operand_t x = kv_A(func->code, 0).dst;
+  ifj17_ir_operand_t sum = ifj17_ir_temp(func, IFJ17_DATATYPE_INTEGER);
+  ifj17_ir_operand_t copy = ifj17_ir_temp(func, IFJ17_DATATYPE_INTEGER);
+  ifj17_ir_operand_t unused = ifj17_ir_temp(func, IFJ17_DATATYPE_INTEGER);
+  ifj17_ir_emit(func, IFJ17_IR_ADD, sum, x, ifj17_ir_int(1));
+  ifj17_ir_emit(func, IFJ17_IR_MOVE, x, sum, ifj17_ir_none());
+  ifj17_ir_emit(func, IFJ17_IR_MOVE, copy, x, ifj17_ir_none());
+  ifj17_ir_emit(func, IFJ17_IR_MOVE, x, copy, ifj17_ir_none());
+  ifj17_ir_emit(func, IFJ17_IR_WRITE, ifj17_ir_none(), x, ifj17_ir_none());
+  (void)unused;
+
+  assert(ifj17_peephole(func, hits));
+  assert(2 == hits[IFJ17_PEEPHOLE_COPY]);
+  assert(1 == hits[IFJ17_PEEPHOLE_SELF_MOVE]);
+  assert(1 == hits[IFJ17_PEEPHOLE_JUMP_NEXT]);
+  assert(3 == hits[IFJ17_PEEPHOLE_UNUSED_TEMP]);
+  assert(0 == kv_size(func->temps));
+
+  ifj17_emitter_init(&out);
+  ifj17_ir_dump(&ir, &out);
+  ifj17_emitter_copy(&out, buf, sizeof(buf));
+  assert(!strcmp(buf, "scope\n"
+                      "  local x integer\n"
+                      "-:\n"
+                      "  x = MOVE 0\n"
+                      "  WRITE !\"? \"\n"
+                      "  x = READ integer\n"
+                      "  JUMPIFNEQ ELSE_1 x, 1\n"
+                      "-:\n"
+                      "  WRITE x\n"
+                      "ELSE_1:\n"
+                      "END_IF_0:\n"
+                      "  x = ADD x, 1\n"
+                      "  WRITE x\n"));
+
+  ifj17_emitter_free(&out);
+  ifj17_ir_free(&ir);
+  ifj17_state_free(&state);
+}
+
+/*
+ * Run IFJcode17 `code` reading `input`, its output copied into
+ * `buf` of `size` bytes. Return the interpreter error.
+ */
+
+static int run_vm(const char *code, const char *input, char *buf, size_t size) {
+  ifj17_vm_t vm;
+  ifj17_vm_init(&vm);
+  assert((vm.in = tmpfile()) && (vm.out = tmpfile()));
+  fputs(input, vm.in);
+  rewind(vm.in);
+
+  if (ifj17_vm_load(&vm, code, strlen(code))) {
+    ifj17_eval(&vm);
+  }
+
+  rewind(vm.out);
+  buf[fread(buf, 1, size - 1, vm.out)] = 0;
+  fclose(vm.in);
+  fclose(vm.out);
+  ifj17_vm_free(&vm);
+  return vm.error;
+}
+
+static void unit_test_vm() {
+  char buf[256];
+
+  // frames, the data stack and calls
+  assert(0 == run_vm(".IFJcode17\n"
+                     "JUMP main # skip the function\n"
+                     "LABEL twice\nCREATEFRAME\nDEFVAR TF@n\nPOPS TF@n\n"
+                     "ADD TF@n TF@n TF@n\nPUSHS TF@n\nRETURN\n"
+                     "LABEL main\nDEFVAR GF@x\nREAD GF@x int\n"
+                     "CREATEFRAME\nDEFVAR TF@x\nMOVE TF@x int@1\nPUSHFRAME\n"
+                     "PUSHS GF@x\nCALL twice\nPOPS GF@x\nWRITE GF@x\n"
+                     "WRITE LF@x\nPOPFRAME\nWRITE TF@x\n",
+                     "21\n", buf, sizeof(buf)));
+  assert(!strcmp(buf, "4211"));
+
+  // typed values, conversions and strings
+  assert(0 == run_vm(".ifjcode17\n"
+                     "DEFVAR GF@s\nDEFVAR GF@n\nDEFVAR GF@t\n"
+                     "CONCAT GF@s string@a\\032b string@\\035c\nWRITE GF@s\n"
+                     "STRLEN GF@n GF@s\nWRITE GF@n\nSTRI2INT GF@n GF@s int@4\n"
+                     "INT2CHAR GF@t GF@n\nSETCHAR GF@s int@0 GF@t\nWRITE GF@s\n"
+                     "FLOAT2R2EINT GF@n float@2.5\nWRITE GF@n\n"
+                     "FLOAT2R2OINT GF@n float@2.5\nWRITE GF@n\n"
+                     "INT2FLOAT GF@t int@7\nDIV GF@t GF@t float@2\nWRITE GF@t\n"
+                     "TYPE GF@s GF@t\nWRITE GF@s\nLT GF@t string@ab string@b\n"
+                     "NOT GF@t GF@t\nWRITE GF@t\nREAD GF@t bool\nWRITE GF@t\n"
+                     "READ GF@n int\nWRITE GF@n\n",
+                     "TRUE\nx1\n", buf, sizeof(buf)));
+  assert(!strcmp(buf, "a b#c5c b#c233.5floatfalsetrue0"));
+}
+
+static void unit_test_vm_errors() {
+  char buf[64];
+
+  assert(IFJ17_VM_SYNTAX == run_vm("WRITE int@1\n", "", buf, sizeof(buf)));
+  assert(IFJ17_VM_SYNTAX == run_vm(".IFJcode17\nMOVE int@1 int@1\n", "", buf, 64));
+  assert(IFJ17_VM_SYNTAX == run_vm(".IFJcode17\nWRITE string@a\\01\n", "", buf, 64));
+  assert(IFJ17_VM_SEMANTIC == run_vm(".IFJcode17\nJUMP nowhere\n", "", buf, 64));
+  assert(IFJ17_VM_SEMANTIC ==
+         run_vm(".IFJcode17\nDEFVAR GF@a\nDEFVAR GF@a\n", "", buf, 64));
+  assert(IFJ17_VM_TYPE == run_vm(".IFJcode17\nDEFVAR GF@a\n"
+                                 "ADD GF@a int@1 float@1\n",
+                                 "", buf, 64));
+  assert(IFJ17_VM_UNDEFINED == run_vm(".IFJcode17\nWRITE GF@a\n", "", buf, 64));
+  assert(IFJ17_VM_FRAME == run_vm(".IFJcode17\nPUSHFRAME\n", "", buf, 64));
+  assert(IFJ17_VM_MISSING ==
+         run_vm(".IFJcode17\nDEFVAR GF@a\nWRITE GF@a\n", "", buf, 64));
+  assert(IFJ17_VM_MISSING == run_vm(".IFJcode17\nRETURN\n", "", buf, 64));
+  assert(IFJ17_VM_ZERO == run_vm(".IFJcode17\nDEFVAR GF@a\n"
+                                 "DIV GF@a float@1 float@0\n",
+                                 "", buf, 64));
+  assert(IFJ17_VM_STRING == run_vm(".IFJcode17\nDEFVAR GF@a\n"
+                                   "GETCHAR GF@a string@ab int@2\n",
+                                   "", buf, 64));
+
+  // output up to the error stays
+  assert(IFJ17_VM_ZERO == run_vm(".IFJcode17\nDEFVAR GF@a\nWRITE int@1\n"
+                                 "DIV GF@a float@1 float@0\nWRITE int@2\n",
+                                 "", buf, sizeof(buf)));
+  assert(!strcmp(buf, "1"));
+}
+
+static void unit_test_vm_resolve() {
+  const char *code = ".IFJcode17\nDEFVAR GF@i\nMOVE GF@i int@3\nCREATEFRAME\n"
+                     "DEFVAR TF@x\nPUSHFRAME\nLABEL loop\nSUB GF@i GF@i int@1\n"
+                     "MOVE LF@x GF@i\nWRITE LF@x\nJUMPIFNEQ loop GF@i int@0\n"
+                     "CREATEFRAME\nDEFVAR TF@y\nDEFVAR TF@x\n";
+
+  for (int resolve = 1; resolve >= 0; --resolve) {
+    ifj17_vm_t vm;
+    char buf[16];
+    ifj17_vm_init(&vm);
+    vm.resolve = resolve;
+    vm.fuse = 0;
+    assert(vm.out = tmpfile());
+    assert(ifj17_vm_load(&vm, code, strlen(code)));
+
+    // labels by instruction, variables by slot
+    assert(IFJ17_OP_LABEL == kv_A(vm.code, 5).op);
+    assert(5 == kv_A(vm.code, 9).args[0].index);
+    assert(0 == kv_A(vm.code, 1).args[0].index);
+    assert(IFJ17_VM_LF == kv_A(vm.code, 7).args[0].frame);
+    assert(0 == kv_A(vm.code, 7).args[0].index);
+    assert(1 == kv_A(vm.code, 11).args[0].index);
+    assert(0 == kv_A(vm.code, 12).args[0].index);
+
+    assert(ifj17_eval(&vm));
+    assert(23 == vm.steps);
+    rewind(vm.out);
+    buf[fread(buf, 1, sizeof(buf) - 1, vm.out)] = 0;
+    assert(!strcmp(buf, "210"));
+    fclose(vm.out);
+    ifj17_vm_free(&vm);
+  }
+}
+
+static void unit_test_vm_profile() {
+  const char *code = ".IFJcode17\nDEFVAR GF@i\nMOVE GF@i int@2\nLABEL l\n"
+                     "SUB GF@i GF@i int@1\nJUMPIFNEQ l GF@i int@0\n";
+  ifj17_vm_profile_t profile = {{0}};
+  ifj17_vm_t vm;
+
+  ifj17_vm_init(&vm);
+  vm.profile = &profile;
+  vm.fuse = 0;
+  assert(ifj17_vm_load(&vm, code, strlen(code)));
+  assert(ifj17_eval(&vm));
+  ifj17_vm_free(&vm);
+
+  // DEFVAR MOVE LABEL SUB JUMPIFNEQ LABEL SUB JUMPIFNEQ
+  assert(1 == profile.count[IFJ17_OP_DEFVAR]);
+  assert(2 == profile.count[IFJ17_OP_LABEL]);
+  assert(2 == profile.count[IFJ17_OP_JUMPIFNEQ]);
+
+  // the shared branch misses on every change of opcode
+  assert(0 == profile.misses[IFJ17_VM_SWITCH][IFJ17_OP_DEFVAR]);
+  assert(1 == profile.misses[IFJ17_VM_SWITCH][IFJ17_OP_MOVE]);
+  assert(2 == profile.misses[IFJ17_VM_SWITCH][IFJ17_OP_SUB]);
+  assert(2 == profile.misses[IFJ17_VM_SWITCH][IFJ17_OP_JUMPIFNEQ]);
+
+  // a branch per handler misses once its successor repeats
+  assert(1 == profile.misses[IFJ17_VM_THREADED][IFJ17_OP_MOVE]);
+  assert(2 == profile.misses[IFJ17_VM_THREADED][IFJ17_OP_LABEL]);
+  assert(1 == profile.misses[IFJ17_VM_THREADED][IFJ17_OP_SUB]);
+  assert(1 == profile.misses[IFJ17_VM_THREADED][IFJ17_OP_JUMPIFNEQ]);
+}
+
+static void unit_test_vm_fuse() {
+  const char *code = ".IFJcode17\nDEFVAR GF@i\nDEFVAR GF@c\nMOVE GF@i int@3\n"
+                     "LABEL loop\nLT GF@c int@0 GF@i\nJUMPIFEQ end GF@c bool@false\n"
+                     "SUB GF@i GF@i int@1\nWRITE GF@i\nJUMP loop\nLABEL end\n";
+  const char *redefined = ".IFJcode17\nDEFVAR GF@a\nDEFVAR GF@a\n";
+  long steps[2];
+
+  for (int fuse = 0; fuse < 2; ++fuse) {
+    ifj17_vm_t vm;
+    char buf[16];
+    ifj17_vm_init(&vm);
+    vm.fuse = fuse;
+    assert(vm.out = tmpfile());
+    assert(ifj17_vm_load(&vm, code, strlen(code)));
+    assert(ifj17_eval(&vm));
+    rewind(vm.out);
+    buf[fread(buf, 1, sizeof(buf) - 1, vm.out)] = 0;
+    assert(!strcmp(buf, "210"));
+    steps[fuse] = vm.steps;
+
+    if (fuse) {
+      // labels dropped, pairs fused, jumps past the labels
+      assert(8 == kv_size(vm.code));
+      assert(IFJ17_OP_DEFVAR_DEFVAR == kv_A(vm.code, 0).op);
+      assert(IFJ17_OP_DEFVAR == kv_A(vm.code, 1).op);
+      assert(IFJ17_OP_MOVE == kv_A(vm.code, 2).op);
+      assert(IFJ17_OP_LT_JUMPIFEQ == kv_A(vm.code, 3).op);
+      assert(8 == kv_A(vm.code, 4).args[0].index);
+      assert(3 == kv_A(vm.code, 7).args[0].index);
+    }
+    fclose(vm.out);
+    ifj17_vm_free(&vm);
+  }
+  assert(25 == steps[0] && 15 == steps[1]);
+
+  // errors in the second instruction of a pair are its own
+  ifj17_vm_t vm;
+  ifj17_vm_init(&vm);
+  assert(ifj17_vm_load(&vm, redefined, strlen(redefined)));
+  assert(IFJ17_OP_DEFVAR_DEFVAR == kv_A(vm.code, 0).op);
+  assert(!ifj17_eval(&vm));
+  assert(IFJ17_VM_SEMANTIC == vm.error && 3 == vm.lineno);
+  ifj17_vm_free(&vm);
+}
+
+static void unit_test_vm_strings() {
+  // a string built up, the strings held across the heap
+  // compactions by a variable, the data stack and TF
+  const char *code = ".IFJcode17\nDEFVAR GF@s\nDEFVAR GF@t\nDEFVAR GF@i\n"
+                     "DEFVAR GF@c\nCONCAT GF@t string@x string@y\nPUSHS GF@t\n"
+                     "CREATEFRAME\nDEFVAR TF@u\nGETCHAR TF@u GF@t int@1\n"
+                     "MOVE GF@s string@\nMOVE GF@i int@0\nLABEL loop\n"
+                     "CONCAT GF@s GF@s string@a\nADD GF@i GF@i int@1\n"
+                     "LT GF@c GF@i int@20000\nJUMPIFEQ loop GF@c bool@true\n"
+                     "STRLEN GF@i GF@s\nWRITE GF@i\nPOPS GF@s\n"
+                     "EQ GF@c GF@s string@xy\nWRITE GF@c\nWRITE GF@t\nWRITE TF@u\n";
+  ifj17_vm_t vm;
+  char buf[32];
+
+  ifj17_vm_init(&vm);
+  assert(vm.out = tmpfile());
+  assert(ifj17_vm_load(&vm, code, strlen(code)));
+  assert(ifj17_eval(&vm));
+  rewind(vm.out);
+  buf[fread(buf, 1, sizeof(buf) - 1, vm.out)] = 0;
+  assert(!strcmp(buf, "20000truexyy"));
+
+  // the prefixes dropped, the heap at most 4 times twice the
+  // live strings and the one built
+  assert(vm.compactions > 1);
+  assert(vm.heap_size <= 4 * 2 * 2 * (sizeof(ifj17_string_t) + 20008));
+  fclose(vm.out);
+  ifj17_vm_free(&vm);
+}
+
+static void unit_test_vm_run() {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+  ifj17_codegen_ctx_t context;
+  char buf[256], *code;
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer,
+                   "function fact (n as integer) as integer\n"
+                   "if n < 2 then\nreturn 1\nend if\n"
+                   "return n * fact(n - 1)\nend function\n"
+                   "scope\ndim i as integer\ndim s as string = !\"# \\\\\"\n"
+                   "input i\ndo while i > 0\nprint fact(i); s;\ni = i - 1\nloop\n"
+                   "print 7 \\ 2; 2.5 + 1;\nend scope\n",
+                   "run");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+
+  ifj17_codegen_ctx_init(&context);
+  assert(ifj17_codegen(&context, (ifj17_node_t *)root));
+  assert(code = malloc(context.out.len + 1));
+  ifj17_emitter_copy(&context.out, code, context.out.len + 1);
+  assert(0 == run_vm(code, "4\n", buf, sizeof(buf)));
+  assert(!strcmp(buf, "? 24# \\6# \\2# \\1# \\33.5"));
+
+  free(code);
+  ifj17_codegen_ctx_free(&context);
+  ifj17_state_free(&state);
+}
+
+/*
+ * Test locals shadowing others of their function in an if
+ * or loop body get frame variables of their own.
+ */
+
+static void unit_test_codegen_shadowed() {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+  ifj17_codegen_ctx_t context;
+  char buf[64], *code;
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer,
+                   "function f (x as integer) as integer\n"
+                   "if x > 0 then\ndim x as integer = 10\nreturn x\nend if\n"
+                   "return x\nend function\n"
+                   "scope\ndim c as integer = 2\ndim x as integer = 7\n"
+                   "if c > 1 then\ndim x as string = !\"s\"\nprint x;\nend if\n"
+                   "do while c > 0\ndim x as double = 1.5\nc = c - 1\nprint x;\n"
+                   "loop\nprint x; f(1); f(0);\nend scope\n",
+                   "shadowed");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+
+  ifj17_codegen_ctx_init(&context);
+  assert(ifj17_codegen(&context, (ifj17_node_t *)root));
+  assert(code = malloc(context.out.len + 1));
+  ifj17_emitter_copy(&context.out, code, context.out.len + 1);
+  assert(strstr(code, "DEFVAR TF@x\nPOPS TF@x\nDEFVAR TF@x$1\n"));
+  assert(strstr(code, "DEFVAR GF@x\nDEFVAR GF@x$2\nDEFVAR GF@x$3\n"));
+  assert(0 == run_vm(code, "", buf, sizeof(buf)));
+  assert(!strcmp(buf, "s1.51.57100"));
+
+  free(code);
+  ifj17_codegen_ctx_free(&context);
+  ifj17_state_free(&state);
+}
+
+/*
+ * Analyze `source`, returning the error status.
+ */
+
+static int analyze(const char *source) {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer, source, "semantic");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+  ifj17_semantic_init(&sem, &state);
+  ifj17_analyze(&sem, (ifj17_node_t *)root);
+  ifj17_state_free(&state);
+  return sem.error;
+}
+
+/*
+ * Test expressions are typed from the declarations.
+ */
+
+static void unit_test_infer() {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+  ifj17_datatype expected[] = {IFJ17_DATATYPE_INTEGER, IFJ17_DATATYPE_DOUBLE,
+                               IFJ17_DATATYPE_STRING, IFJ17_DATATYPE_DOUBLE,
+                               IFJ17_DATATYPE_INTEGER};
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer,
+                   "function f (n as integer) as integer\nreturn n\nend function\n"
+                   "scope\ndim a as integer\ndim d as double\ndim s as string\n"
+                   "a = a + 1\nd = a * d\ns = s + s\nd = a / 2\na = f(a)\n"
+                   "end scope\n",
+                   "infer");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+
+  ifj17_scope_node_t *scope = (ifj17_scope_node_t *)ifj17_node_vec_at(root->stmts, 1);
+  for (int i = 0; i < 5; ++i) {
+    ifj17_binary_op_node_t *assign =
+        (ifj17_binary_op_node_t *)ifj17_node_vec_at(scope->block->stmts, i + 3);
+    assert(assign->right->datatype == expected[i]);
+  }
+
+  ifj17_state_free(&state);
+}
+
+/*
+ * Test names resolve to dense slots, per function and scope.
+ */
+
+static void unit_test_resolve() {
+  ifj17_state_t state;
+  ifj17_lexer_t lexer;
+  ifj17_parser_t parser;
+  ifj17_block_node_t *root;
+  ifj17_semantic_t sem;
+
+  ifj17_state_init(&state);
+  ifj17_lexer_init(&lexer,
+                   "function f (a as integer, b as double) as double\n"
+                   "dim c as double\nc = b\nreturn a\nend function\n"
+                   "scope\ndim x, y as integer\ny = f(x, 1.5)\nend scope\n",
+                   "resolve");
+  ifj17_parser_init(&parser, &lexer, &state);
+  assert(root = ifj17_parse(&parser));
+  ifj17_semantic_init(&sem, &state);
+  assert(ifj17_analyze(&sem, (ifj17_node_t *)root));
+
+  ifj17_function_node_t *f =
+      (ifj17_function_node_t *)ifj17_node_vec_at(root->stmts, 0);
+  ifj17_binary_op_node_t *assign =
+      (ifj17_binary_op_node_t *)ifj17_node_vec_at(f->block->stmts, 1);
+  assert(f->nslots == 3);
+  assert(((ifj17_id_node_t *)assign->left)->slot == 2);
+  assert(((ifj17_id_node_t *)assign->right)->slot == 1);
+
+  ifj17_scope_node_t *scope =
+      (ifj17_scope_node_t *)ifj17_node_vec_at(root->stmts, 1);
+  assign = (ifj17_binary_op_node_t *)ifj17_node_vec_at(scope->block->stmts, 1);
+  ifj17_call_node_t *call = (ifj17_call_node_t *)assign->right;
+  assert(scope->nslots == 2);
+  assert(((ifj17_id_node_t *)assign->left)->slot == 1);
+  assert(((ifj17_id_node_t *)ifj17_node_vec_at(call->args->vec, 0))->slot == 0);
+  assert(call->base.datatype == IFJ17_DATATYPE_DOUBLE);
+
+  ifj17_state_free(&state);
+}
+
+/*
+ * Test semantic errors are reported with their status.
+ */
+
+static void unit_test_semantic_errors() {
+  assert(0 == analyze("scope\ndim a as integer\na = 1\nend scope\n"));
+
+  // undefined and redefined
+  assert(3 == analyze("scope\na = 1\nend scope\n"));
+  assert(3 == analyze("scope\ndim a as integer\ndim a as double\nend scope\n"));
+  assert(3 == analyze("scope\ndim a as integer\na = f()\nend scope\n"));
+  assert(3 == analyze("function f () as integer\nreturn 1\nend function\n"
+                      "function f () as integer\nreturn 2\nend function\n"));
+  assert(3 == analyze("declare function f () as integer\n"));
+  assert(3 == analyze("declare function f (a as integer) as integer\n"
+                      "function f (a as double) as integer\n"
+                      "return 1\nend function\n"));
+  assert(3 == analyze("function f () as integer\nreturn 1\nend function\n"
+                      "scope\ndim f as integer\nend scope\n"));
+  assert(3 == analyze("function f (a as integer) as integer\n"
+                      "return b\nend function\n"
+                      "scope\ndim b as integer\nend scope\n"));
+
+  // if and loop bodies scope their variables
+  assert(3 == analyze("scope\ndim c as integer\ninput c\nif c > 1 then\n"
+                      "dim x as integer = 5\nprint x;\nelse\nprint c;\n"
+                      "end if\nprint x;\nend scope\n"));
+  assert(3 == analyze("scope\ndim a as integer\ndo while a < 1\n"
+                      "dim b as integer\na = 1\nloop\nb = 2\nend scope\n"));
+  assert(0 == analyze("scope\ndim x as integer\nif x = 0 then\n"
+                      "dim x as string\nelseif x = 1 then\ndim x as double\n"
+                      "else\ndim x as integer\nend if\nend scope\n"));
+
+  // types
+  assert(4 == analyze("scope\ndim a as integer\na = !\"one\"\nend scope\n"));
+  assert(4 == analyze("scope\ndim s as string\ns = s - 1\nend scope\n"));
+  assert(4 == analyze("scope\ndim s as string\nif s = 1 then\nend if\nend scope\n"));
+  assert(4 == analyze("function f (a as integer) as integer\n"
+                      "return a\nend function\n"
+                      "scope\ndim a as integer\na = f(!\"x\")\nend scope\n"));
+  assert(4 == analyze("function f (a as integer) as integer\n"
+                      "return a\nend function\n"
+                      "scope\ndim a as integer\na = f(1, 2)\nend scope\n"));
+  assert(4 == analyze("function f () as string\nreturn 1\nend function\n"));
+
+  // other
+  assert(6 == analyze("scope\nreturn 1\nend scope\n"));
+
+  // numbers convert, declarations allow calls before definitions
+  assert(0 == analyze("declare function f (a as double) as integer\n"
+                      "scope\ndim d as double = 1\nd = f(2)\nend scope\n"
+                      "function f (a as double) as integer\n"
+                      "return a\nend function\n"));
+}
+
+/*
+ * Test inner scopes shadow outer symbols until they are left.
+ */
+
+static void unit_test_symtab() {
+  ifj17_state_t state;
+  ifj17_symtab_t symtab;
+  ifj17_scope_t outer, inner;
+  char name[16];
+
+  ifj17_state_init(&state);
+  assert(ifj17_symtab_init(&symtab, &state.arena));
+  ifj17_string_t *a = ifj17_identifier(&state, "a", 1);
+
+  ifj17_symtab_push(&symtab, &outer);
+  ifj17_symbol_t *sym = ifj17_symtab_define(&symtab, a, IFJ17_SYMBOL_VARIABLE, NULL);
+  assert(sym && 0 == sym->depth);
+
+  ifj17_symtab_push(&symtab, &inner);
+  ifj17_symbol_t *shadow =
+      ifj17_symtab_define(&symtab, a, IFJ17_SYMBOL_VARIABLE, NULL);
+  assert(shadow->shadowed == sym && 1 == shadow->depth);
+  assert(ifj17_symtab_lookup(&symtab, a) == shadow);
+
+  // grow while shadowed
+  for (int i = 0; i < 1000; ++i) {
+    int len = sprintf(name, "v%d", i);
+    ifj17_symtab_define(&symtab, ifj17_identifier(&state, name, len),
+                        IFJ17_SYMBOL_VARIABLE, NULL);
+  }
+  assert(symtab.nbuckets >= 1024);
+  assert(ifj17_symtab_lookup(&symtab, ifj17_identifier(&state, "v999", 4)));
+
+  ifj17_symtab_pop(&symtab);
+  assert(ifj17_symtab_lookup(&symtab, a) == sym);
+  assert(!ifj17_symtab_lookup(&symtab, ifj17_identifier(&state, "v999", 4)));
+
+  ifj17_symtab_pop(&symtab);
+  assert(!ifj17_symtab_lookup(&symtab, a));
+
+  ifj17_symtab_free(&symtab);
+  ifj17_state_free(&state);
+}
+
 // NOTE: UNIT TESTS
 
 // PARSER
@@ -567,6 +1913,10 @@ static void unit_test_simple_string() {
   _test_parser("test/unit/parser/string/simple-string");
 }
 
+static void unit_test_long_literal() {
+  _test_parser("test/unit/parser/string/long-literal");
+}
+
 static void unit_test_long_string() {
   _test_parser("test/unit/parser/string/long-string");
 }
@@ -651,6 +2001,12 @@ static void acceptance_test_types_control_jump_if() {
   _test_codegen("test/acceptance/types_control/jump_if");
 }
 
+// STRINGS
+
+static void acceptance_test_string_escapes() {
+  _test_codegen("test/acceptance/strings/escapes");
+}
+
 // LOOPS
 
 static void acceptance_test_do_while_whithout_body() {
@@ -678,6 +2034,10 @@ static void unit_test_built_in_print_multiple_of_random_types() {
   _test_parser("test/unit/parser/built-in/print/multiple-of-random-types");
 }
 
+static void unit_test_built_in_print_multiple_lines() {
+  _test_parser("test/unit/parser/built-in/print/multiple-lines");
+}
+
 static void unit_test_built_in_print_single_int() {
   _test_parser("test/unit/parser/built-in/print/single-int");
 }
@@ -778,6 +2138,7 @@ int main(int argc, const char **argv) {
 
   suite("value");
   unit_test(value_is);
+  unit_test(value);
 
   suite("array");
   unit_test(array_length);
@@ -795,7 +2156,21 @@ int main(int argc, const char **argv) {
   suite("string");
   unit_test(string);
 
+  suite("arena");
+  unit_test(arena);
+
+  suite("emitter");
+  unit_test(emitter);
+
+  suite("lexer");
+  unit_test(keywords);
+  unit_test(string_escapes);
+  unit_test(simd_differential);
+  unit_test(lex_batch);
+  unit_test(pipeline);
+
   suite("parser");
+  unit_test(recovery);
 
   // NOTE:
   // Comment tests unit_test(comments_only_comments);
@@ -843,6 +2218,7 @@ int main(int argc, const char **argv) {
   unit_test(escape_quote);
   unit_test(escape_sequence);
   // unit_test(long_string);
+  unit_test(long_literal);
   unit_test(simple_string);
   unit_test(escape_line_break);
   // unit_test(new_line);
@@ -862,6 +2238,31 @@ int main(int argc, const char **argv) {
   unit_test(built_in_print_multiple_of_string);
   unit_test(built_in_print_multiple_of_variable);
   unit_test(built_in_print_multiple_of_random_types);
+  unit_test(built_in_print_multiple_lines);
+
+  suite("codegen");
+  unit_test(codegen_reentrant);
+  unit_test(codegen_parallel);
+  unit_test(codegen_shadowed);
+  unit_test(ir);
+  unit_test(fold);
+  unit_test(fold_branch);
+  unit_test(peephole);
+
+  suite("vm");
+  unit_test(vm);
+  unit_test(vm_errors);
+  unit_test(vm_resolve);
+  unit_test(vm_profile);
+  unit_test(vm_fuse);
+  unit_test(vm_strings);
+  unit_test(vm_run);
+
+  suite("semantic");
+  unit_test(infer);
+  unit_test(resolve);
+  unit_test(semantic_errors);
+  unit_test(symtab);
 
   type("INTEGRATION TESTS");
 
@@ -883,6 +2284,9 @@ int main(int argc, const char **argv) {
   // acceptance_test(types_control_relation);
   acceptance_test(types_control_jump_if);
 
+  suite("strings");
+  acceptance_test(string_escapes);
+
   suite("assignment");
   // acceptance_test(assignment_vars);
 